@@ -0,0 +1,385 @@
+// Copyright 2025 user
+// 性能基准：覆盖 loadAll/saveAll（文本与压缩格式）、导出、各项统计、
+// 检索各谓词组合、缓存命中的检索、排序和余额查询。
+//
+// 构建（需要安装 Google Benchmark，见顶层 CMakeLists.txt）：
+//   cmake -S . -B build -DCMAKE_BUILD_TYPE=Release
+//   cmake --build build --target bench_bookkeeping
+// 运行并输出 JSON，之后可用 Google Benchmark 自带的 tools/compare.py
+// 与基线结果对比：
+//   ./bench_bookkeeping --benchmark_format=json --benchmark_out=result.json
+// 账本规模默认 1万到1000万行，可用以下参数调整合成数据：
+//   --ledger_max_rows=N      最大行数（规模依次为 1万、10万、100万、1000万）
+//   --ledger_categories=N    分类个数
+//   --ledger_days=N          日期跨度（天）
+//   --ledger_remark_len=N    备注长度（字节）
+//   --ledger_seed=N          随机种子
+// 以埋点编译时（CMake 默认），加载和保存另外报告每行的 operator new 次数
+// allocs_per_row，用于观察复制和分配的变化。
+#include "../code/bookkeeping.h"
+#include <benchmark/benchmark.h>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include "../tools/synthetic_ledger.h"
+
+namespace {
+
+SyntheticLedgerOptions gOptions;
+int64_t gMaxRows = 10000000;
+
+struct CachedLedger {
+  std::vector<Category> categories;
+  std::vector<Transaction> transactions;
+  // 供 loadAll 使用的数据文件（文本格式、压缩格式），首次需要时生成
+  std::string dbFile[2];
+};
+
+// 同一规模的数据只生成一次
+CachedLedger& ledgerOfSize(int64_t rows) {
+  static std::map<int64_t, CachedLedger> cache;
+  auto it = cache.find(rows);
+  if (it == cache.end()) {
+    SyntheticLedgerOptions opts = gOptions;
+    opts.rows = static_cast<size_t>(rows);
+    it = cache.emplace(rows, CachedLedger()).first;
+    generateSyntheticLedger(opts, it->second.categories,
+                            it->second.transactions);
+  }
+  return it->second;
+}
+
+void clearLedger() {
+  Transaction::getRepository().clear();
+  std::vector<Category> cats = Category::getCategoryList();
+  for (size_t i = 0; i < cats.size(); ++i) {
+    Category::deleteCategory(cats[i].getId());
+  }
+}
+
+// 把合成数据装入全局仓库
+void installLedger(int64_t rows) {
+  CachedLedger& ledger = ledgerOfSize(rows);
+  clearLedger();
+  for (size_t i = 0; i < ledger.categories.size(); ++i) {
+    Category::addCategory(ledger.categories[i]);
+  }
+  Transaction::getRepository() = ledger.transactions;
+}
+
+const std::string& dbFileOfSize(int64_t rows, bool compressed) {
+  CachedLedger& ledger = ledgerOfSize(rows);
+  std::string& file = ledger.dbFile[compressed];
+  if (file.empty()) {
+    file = "bench_ledger_" + std::to_string(rows) +
+           (compressed ? ".zdb" : ".db");
+    installLedger(rows);
+    DataPersistence::setTestFilePath(file);
+    DataPersistence::setCompression(compressed);
+    DataPersistence::saveAll();
+    DataPersistence::setCompression(false);
+  }
+  return file;
+}
+
+// 本线程至今的分配次数；未启用埋点时恒为 0
+uint64_t allocationCount() {
+#ifdef BOOKKEEPING_METRICS
+  return Metrics::threadAllocations();
+#else
+  return 0;
+#endif
+}
+
+void reportAllocations(benchmark::State& state, uint64_t allocations) {
+#ifdef BOOKKEEPING_METRICS
+  state.counters["allocs_per_row"] =
+      static_cast<double>(allocations) /
+      static_cast<double>(state.iterations() * state.range(0));
+#else
+  static_cast<void>(state);
+  static_cast<void>(allocations);
+#endif
+}
+
+// range(1) 为 1 时读写分块压缩格式
+void BM_LoadAll(benchmark::State& state) {
+  const std::string& file = dbFileOfSize(state.range(0), state.range(1) != 0);
+  DataPersistence::setTestFilePath(file);
+  uint64_t allocations = 0;
+  for (auto _ : state) {
+    state.PauseTiming();
+    clearLedger();
+    state.ResumeTiming();
+    uint64_t before = allocationCount();
+    benchmark::DoNotOptimize(DataPersistence::loadAll());
+    allocations += allocationCount() - before;
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  reportAllocations(state, allocations);
+}
+
+void BM_SaveAll(benchmark::State& state) {
+  std::string file = "bench_save_" + std::to_string(state.range(0)) + ".db";
+  installLedger(state.range(0));
+  DataPersistence::setTestFilePath(file);
+  DataPersistence::setCompression(state.range(1) != 0);
+  uint64_t allocations = 0;
+  for (auto _ : state) {
+    uint64_t before = allocationCount();
+    benchmark::DoNotOptimize(DataPersistence::saveAll());
+    allocations += allocationCount() - before;
+  }
+  std::ifstream in(file, std::ios::binary | std::ios::ate);
+  state.SetBytesProcessed(state.iterations() *
+                          static_cast<int64_t>(in.tellg()));
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+  reportAllocations(state, allocations);
+  DataPersistence::setCompression(false);
+  std::remove(file.c_str());
+}
+
+// 导出：range(1) 为 0 CSV、1 JSON Lines，写到丢弃输出的流
+void BM_Export(benchmark::State& state) {
+  installLedger(state.range(0));
+  OutputFormat format =
+      state.range(1) == 0 ? OutputFormat::Csv : OutputFormat::JsonLines;
+  std::ofstream sink("/dev/null");
+  for (auto _ : state) {
+    ReportWriter::exportTransactions(sink, SearchQuery(), format);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// 统计报表：range(1) 选择报表类型
+enum StatReport {
+  kByType, kByMonth, kByCategory, kByAmount, kHomePage, kSketchByMonth
+};
+
+void BM_Statistic(benchmark::State& state) {
+  installLedger(state.range(0));
+  StatisticService stat(Transaction::list());
+  for (auto _ : state) {
+    switch (state.range(1)) {
+      case kByType:
+        benchmark::DoNotOptimize(stat.reportByType());
+        break;
+      case kByMonth:
+        benchmark::DoNotOptimize(stat.reportByTime(TimeGroup::Monthly, {}));
+        break;
+      case kByCategory:
+        benchmark::DoNotOptimize(stat.reportByCategory());
+        break;
+      case kByAmount:
+        benchmark::DoNotOptimize(stat.reportByAmountRange());
+        break;
+      case kSketchByMonth: {
+        // 同一趟扫描附带分位数和去重计数，单线程以便与 kByMonth 对比
+        StatisticService sketched(Transaction::list());
+        sketched.setSketches(true, 1);
+        benchmark::DoNotOptimize(
+            sketched.reportByTime(TimeGroup::Monthly, {}));
+        break;
+      }
+      default: {
+        double ti, te, bal;
+        stat.calculateHomePage(ti, te, bal);
+        benchmark::DoNotOptimize(bal);
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// 检索：range(1) 为谓词掩码，1 日期 2 金额 4 分类 8 关键词
+void BM_Search(benchmark::State& state) {
+  installLedger(state.range(0));
+  int64_t mask = state.range(1);
+  std::vector<std::string> dateRange;
+  std::vector<double> amountRange;
+  std::string categoryId, keyword;
+  if (mask & 1) dateRange = {"2018-01-01", "2018-12-31"};
+  if (mask & 2) amountRange = {100.0, 500.0};
+  if (mask & 4) {
+    categoryId = ledgerOfSize(state.range(0)).categories[0].getId().str();
+  }
+  if (mask & 8) keyword = "外卖";
+  SearchService search(Transaction::list());
+  size_t matched = 0;
+  for (auto _ : state) {
+    std::vector<Transaction> result = search.searchTransaction(
+        dateRange, amountRange, categoryId, keyword);
+    matched = result.size();
+    benchmark::DoNotOptimize(result.data());
+  }
+  state.counters["matched"] = static_cast<double>(matched);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// 缓存命中的检索：条件同 BM_Search 的全部谓词，首次之后均命中 QueryCache
+void BM_CachedSearch(benchmark::State& state) {
+  installLedger(state.range(0));
+  QueryCache::clear();
+  SearchQuery query;
+  query.dateRange = {"2018-01-01", "2018-12-31"};
+  query.amountRange = {100.0, 500.0};
+  query.keyword = "外卖";
+  size_t matched = QueryCache::search(query)->size();
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(QueryCache::search(query).get());
+  }
+  state.counters["matched"] = static_cast<double>(matched);
+  state.counters["hits"] = static_cast<double>(QueryCache::hits());
+}
+
+// 排序：range(1) 为 0 按金额、1 按时间
+void BM_Sort(benchmark::State& state) {
+  installLedger(state.range(0));
+  SortField field = state.range(1) == 0 ? SortField::Amount : SortField::Time;
+  for (auto _ : state) {
+    std::vector<Transaction> sorted = UIService::sortTransactionList(
+        Transaction::list(), field, SortDirection::Asc);
+    benchmark::DoNotOptimize(sorted.data());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// 余额查询：range(1) 为 0 时查截至某日的余额，1 查两日之间的净流入，
+// 2 为逐行扫描求同一余额的参照。查询日期每次迭代轮换
+void BM_Balance(benchmark::State& state) {
+  installLedger(state.range(0));
+  const char* dates[] = {"2016-03-31", "2018-07-15", "2020-12-31",
+                         "2023-01-01"};
+  BalanceIndex::balanceAt("");  // 首次查询建索引，不计入
+  size_t i = 0;
+  for (auto _ : state) {
+    const std::string date = dates[i++ % 4];
+    if (state.range(1) == 0) {
+      benchmark::DoNotOptimize(BalanceIndex::balanceAt(date));
+    } else if (state.range(1) == 1) {
+      benchmark::DoNotOptimize(BalanceIndex::netFlow(dates[0], date));
+    } else {
+      const std::vector<Transaction>& txs = Transaction::list();
+      double balance = 0.0;
+      for (size_t j = 0; j < txs.size(); ++j) {
+        if (txs[j].getTime() <= date) balance += txs[j].signedAmount();
+      }
+      benchmark::DoNotOptimize(balance);
+    }
+  }
+}
+
+// 排行：range(1) 为 0 取支出最大的 10 笔交易，1 取支出最多的 10 个分类，
+// 2 取支出最多的 10 个备注关键词。对比 BM_Sort 的整表排序
+void BM_Ranking(benchmark::State& state) {
+  installLedger(state.range(0));
+  StatisticService stat(Transaction::list());
+  for (auto _ : state) {
+    if (state.range(1) == 0) {
+      std::vector<Transaction> top =
+          stat.topTransactions(10, TransactionType::Expense);
+      benchmark::DoNotOptimize(top.data());
+    } else if (state.range(1) == 1) {
+      benchmark::DoNotOptimize(stat.topCategories(10).rows.data());
+    } else {
+      benchmark::DoNotOptimize(stat.topTerms(10).rows.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+
+// 预算状态：每个分类一项月度预算。range(1) 为 0 时查增量维护的预算状态，
+// 1 为按分类统计当月支出的参照
+void BM_Budget(benchmark::State& state) {
+  installLedger(state.range(0));
+  std::vector<Category> categories = Category::getCategoryList();
+  for (size_t i = 0; i < categories.size(); ++i) {
+    BudgetBook::setBudget({categories[i].getId(), TimeGroup::Monthly, 1000});
+  }
+  BudgetBook::status("2020-06-15");  // 首次查询建索引，不计入
+  StatisticService stat(Transaction::list());
+  for (auto _ : state) {
+    if (state.range(1) == 0) {
+      benchmark::DoNotOptimize(BudgetBook::status("2020-06-15").data());
+    } else {
+      benchmark::DoNotOptimize(
+          stat.reportByCategory({"2020-06-01", "2020-06-30"}).rows.data());
+    }
+  }
+  BudgetBook::clear();
+}
+
+bool parseFlag(const char* arg, const char* name, int64_t& value) {
+  size_t len = std::strlen(name);
+  if (std::strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+  value = std::atoll(arg + len + 1);
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  benchmark::Initialize(&argc, argv);
+  for (int i = 1; i < argc; ++i) {
+    int64_t v = 0;
+    if (parseFlag(argv[i], "--ledger_max_rows", v)) {
+      gMaxRows = v;
+    } else if (parseFlag(argv[i], "--ledger_categories", v)) {
+      gOptions.categories = static_cast<size_t>(v);
+    } else if (parseFlag(argv[i], "--ledger_days", v)) {
+      gOptions.dateSpanDays = static_cast<int>(v);
+    } else if (parseFlag(argv[i], "--ledger_remark_len", v)) {
+      gOptions.remarkLength = static_cast<size_t>(v);
+    } else if (parseFlag(argv[i], "--ledger_seed", v)) {
+      gOptions.seed = static_cast<uint64_t>(v);
+    } else {
+      std::fprintf(stderr, "未知参数: %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  std::vector<int64_t> sizes;
+  for (int64_t rows = 10000; rows <= gMaxRows; rows *= 10) sizes.push_back(rows);
+  if (sizes.empty()) return 1;
+
+  benchmark::RegisterBenchmark("BM_LoadAll", BM_LoadAll)
+      ->ArgsProduct({sizes, {0, 1}})
+      ->ArgNames({"rows", "compressed"})->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_SaveAll", BM_SaveAll)
+      ->ArgsProduct({sizes, {0, 1}})
+      ->ArgNames({"rows", "compressed"})->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_Export", BM_Export)
+      ->ArgsProduct({sizes, {0, 1}})
+      ->ArgNames({"rows", "jsonl"})->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_Statistic", BM_Statistic)
+      ->ArgsProduct({sizes, {kByType, kByMonth, kByCategory, kByAmount,
+                             kHomePage, kSketchByMonth}})
+      ->ArgNames({"rows", "report"})->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_Search", BM_Search)
+      ->ArgsProduct({sizes, benchmark::CreateDenseRange(0, 15, 1)})
+      ->ArgNames({"rows", "predicates"})->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_CachedSearch", BM_CachedSearch)
+      ->ArgsProduct({sizes})->Unit(benchmark::kNanosecond);
+  benchmark::RegisterBenchmark("BM_Sort", BM_Sort)
+      ->ArgsProduct({sizes, {0, 1}})
+      ->ArgNames({"rows", "byTime"})->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_Balance", BM_Balance)
+      ->ArgsProduct({sizes, {0, 1, 2}})
+      ->ArgNames({"rows", "query"})->Unit(benchmark::kMicrosecond);
+  benchmark::RegisterBenchmark("BM_Ranking", BM_Ranking)
+      ->ArgsProduct({sizes, {0, 1, 2}})
+      ->ArgNames({"rows", "kind"})->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark("BM_Budget", BM_Budget)
+      ->ArgsProduct({sizes, {0, 1}})
+      ->ArgNames({"rows", "scan"})->Unit(benchmark::kMicrosecond);
+
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+
+  for (int64_t rows : sizes) {
+    std::string file = "bench_ledger_" + std::to_string(rows);
+    std::remove((file + ".db").c_str());
+    std::remove((file + ".zdb").c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,4813 @@
+// Copyright 2025 user
+#include "bookkeeping.h"
+
+#include <cmath>
+#include <new>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+thread_local int LedgerLock::readDepth = 0;
+thread_local int LedgerLock::writeDepth = 0;
+
+#ifdef BOOKKEEPING_METRICS
+namespace {
+
+const char* const kOpNames[Metrics::OpCount] = {
+    "load_all", "save_all", "search", "report_by_type", "report_by_time",
+    "report_by_category", "report_by_amount_range", "home_page", "sort",
+    "add_transaction", "add_transactions", "delete_transaction",
+    "update_transaction", "add_category", "delete_category", "compact",
+    "import_csv", "balance_query", "ranking", "budget_query",
+};
+
+// 耗时直方图各桶的上界（秒），另有一个 +Inf 桶
+const double kLatencyBounds[] = {1e-6, 1e-5, 1e-4, 1e-3, 1e-2, 1e-1, 1, 10};
+const size_t kBucketCount =
+    sizeof(kLatencyBounds) / sizeof(kLatencyBounds[0]) + 1;
+
+// 静态存储期的原子量零初始化，无需构造顺序保证
+struct OpStats {
+  std::atomic<uint64_t> calls;
+  std::atomic<uint64_t> nanos;
+  std::atomic<uint64_t> rowsScanned;
+  std::atomic<uint64_t> rowsMatched;
+  std::atomic<uint64_t> bytesWritten;
+  std::atomic<uint64_t> allocations;
+  std::atomic<uint64_t> buckets[kBucketCount];  // 各桶独立计数，输出时累加
+};
+
+OpStats gOpStats[Metrics::OpCount];
+
+void writeCounter(std::ostream& out, const char* name, const char* help,
+                  std::atomic<uint64_t> OpStats::*field) {
+  out << "# HELP " << name << ' ' << help << '\n'
+      << "# TYPE " << name << " counter\n";
+  for (size_t i = 0; i < Metrics::OpCount; ++i) {
+    out << name << "{op=\"" << kOpNames[i] << "\"} "
+        << (gOpStats[i].*field).load() << '\n';
+  }
+}
+
+}  // namespace
+
+Metrics::Scope::Scope(Op o)
+    : op(o), start(std::chrono::steady_clock::now()),
+      allocationsAtStart(threadAllocations()) {}
+
+Metrics::Scope::~Scope() {
+  uint64_t nanos = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start).count());
+  double seconds = static_cast<double>(nanos) * 1e-9;
+  size_t bucket = 0;
+  while (bucket + 1 < kBucketCount && seconds > kLatencyBounds[bucket]) {
+    ++bucket;
+  }
+  OpStats& stats = gOpStats[op];
+  stats.calls.fetch_add(1, std::memory_order_relaxed);
+  stats.nanos.fetch_add(nanos, std::memory_order_relaxed);
+  stats.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+  stats.rowsScanned.fetch_add(rowsScanned, std::memory_order_relaxed);
+  stats.rowsMatched.fetch_add(rowsMatched, std::memory_order_relaxed);
+  stats.bytesWritten.fetch_add(bytesWritten, std::memory_order_relaxed);
+  stats.allocations.fetch_add(threadAllocations() - allocationsAtStart,
+                              std::memory_order_relaxed);
+}
+
+uint64_t& Metrics::threadAllocations() {
+  static thread_local uint64_t count = 0;
+  return count;
+}
+
+uint64_t Metrics::calls(Op op) { return gOpStats[op].calls.load(); }
+
+void Metrics::reset() {
+  for (size_t i = 0; i < OpCount; ++i) {
+    OpStats& stats = gOpStats[i];
+    stats.calls = 0;
+    stats.nanos = 0;
+    stats.rowsScanned = 0;
+    stats.rowsMatched = 0;
+    stats.bytesWritten = 0;
+    stats.allocations = 0;
+    for (size_t b = 0; b < kBucketCount; ++b) stats.buckets[b] = 0;
+  }
+}
+
+void Metrics::write(std::ostream& out) {
+  const char* name = "bookkeeping_operation_duration_seconds";
+  out << "# HELP " << name << " 操作耗时（含等待账本锁的时间）\n"
+      << "# TYPE " << name << " histogram\n";
+  char bound[32];
+  for (size_t i = 0; i < OpCount; ++i) {
+    const OpStats& stats = gOpStats[i];
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b < kBucketCount; ++b) {
+      cumulative += stats.buckets[b].load();
+      if (b + 1 < kBucketCount) {
+        std::snprintf(bound, sizeof(bound), "%g", kLatencyBounds[b]);
+      } else {
+        std::snprintf(bound, sizeof(bound), "+Inf");
+      }
+      out << name << "_bucket{op=\"" << kOpNames[i] << "\",le=\"" << bound
+          << "\"} " << cumulative << '\n';
+    }
+    std::snprintf(bound, sizeof(bound), "%.9f",
+                  static_cast<double>(stats.nanos.load()) * 1e-9);
+    out << name << "_sum{op=\"" << kOpNames[i] << "\"} " << bound << '\n'
+        << name << "_count{op=\"" << kOpNames[i] << "\"} "
+        << stats.calls.load() << '\n';
+  }
+  writeCounter(out, "bookkeeping_rows_scanned_total", "扫描的行数",
+               &OpStats::rowsScanned);
+  writeCounter(out, "bookkeeping_rows_matched_total",
+               "命中（返回、计入或修改）的行数", &OpStats::rowsMatched);
+  writeCounter(out, "bookkeeping_bytes_written_total", "写出的字节数",
+               &OpStats::bytesWritten);
+  writeCounter(out, "bookkeeping_allocations_total",
+               "操作期间本线程的 operator new 次数", &OpStats::allocations);
+  QueryCache::write(out);
+}
+
+// 替换全局 operator new 以统计分配次数，只在启用埋点时编译。
+// 普通、nothrow 与数组形式的 new/delete 须成套替换：标准库（如
+// std::stable_sort 的临时缓冲区）用 nothrow 版分配、普通版释放，只替换
+// 其中一部分时，ASan 会把默认实现与这里的 malloc/free 报为不匹配。
+// 对齐版本（align_val_t）未替换，由默认实现自行配对
+namespace {
+
+void* countedAlloc(std::size_t size) {
+  ++Metrics::threadAllocations();
+  if (size == 0) size = 1;
+  while (true) {
+    void* p = std::malloc(size);
+    if (p) return p;
+    std::new_handler handler = std::get_new_handler();
+    if (!handler) throw std::bad_alloc();
+    handler();
+  }
+}
+
+void* countedAllocNothrow(std::size_t size) noexcept {
+  try {
+    return countedAlloc(size);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+}  // namespace
+
+void* operator new(std::size_t size) { return countedAlloc(size); }
+void* operator new[](std::size_t size) { return countedAlloc(size); }
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAllocNothrow(size);
+}
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+  return countedAllocNothrow(size);
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+void operator delete[](void* p, std::size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept {
+  std::free(p);
+}
+#else
+void Metrics::write(std::ostream& out) {
+  out << "# 未启用埋点，请以 BOOKKEEPING_METRICS 重新编译\n";
+  QueryCache::write(out);
+}
+#endif
+
+std::mutex LedgerSnapshot::cacheMutex;
+std::shared_ptr<const LedgerSnapshot::Data> LedgerSnapshot::cache;
+
+LedgerSnapshot LedgerSnapshot::current() {
+  {
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    if (cache && cache->version == LedgerLock::version()) {
+      return LedgerSnapshot(cache);
+    }
+  }
+  // 先取读锁再取缓存锁，避免与持有写锁的线程交叉等待
+  LedgerLock::ReadGuard guard;
+  std::lock_guard<std::mutex> lock(cacheMutex);
+  uint64_t version = LedgerLock::version();
+  if (!cache || cache->version != version) {
+    std::shared_ptr<Data> fresh = std::make_shared<Data>();
+    fresh->version = version;
+    // 快照只复制未删除的行，基于快照的查询无需再检查删除标记
+    const std::vector<Transaction>& rows = Transaction::list();
+    if (Transaction::deletedCount() == 0) {
+      fresh->transactions = rows;
+    } else {
+      fresh->transactions.reserve(Transaction::liveCount());
+      for (size_t i = 0; i < rows.size(); ++i) {
+        if (!Transaction::isDeleted(i)) fresh->transactions.push_back(rows[i]);
+      }
+    }
+    fresh->categories = Category::getCategoryList();
+    cache = std::move(fresh);
+  }
+  return LedgerSnapshot(cache);
+}
+
+AmountHistogram::AmountHistogram(std::vector<double> edges) {
+  edges.erase(std::remove_if(edges.begin(), edges.end(),
+                             [](double e) { return !std::isfinite(e); }),
+              edges.end());
+  std::sort(edges.begin(), edges.end());
+  edges.erase(std::unique(edges.begin(), edges.end()), edges.end());
+  this->edges = std::move(edges);
+}
+
+AmountHistogram AmountHistogram::linear(double min, double max,
+                                        size_t buckets) {
+  std::vector<double> edges;
+  if (buckets == 0 || !(min < max)) return AmountHistogram(edges);
+  for (size_t i = 0; i <= buckets; ++i) {
+    edges.push_back(i == buckets ? max : min + (max - min) * i / buckets);
+  }
+  return AmountHistogram(std::move(edges));
+}
+
+AmountHistogram AmountHistogram::logScale(double min, double max,
+                                          size_t buckets) {
+  std::vector<double> edges;
+  if (buckets == 0 || !(min > 0.0) || !(min < max)) {
+    return AmountHistogram(edges);
+  }
+  double ratio = std::log(max / min);
+  for (size_t i = 0; i <= buckets; ++i) {
+    edges.push_back(i == buckets ? max
+                                 : min * std::exp(ratio * i / buckets));
+  }
+  return AmountHistogram(std::move(edges));
+}
+
+AmountHistogram AmountHistogram::quantiles(std::vector<double> amounts,
+                                           size_t buckets) {
+  std::vector<double> edges;
+  if (buckets == 0 || amounts.empty()) return AmountHistogram(edges);
+  std::sort(amounts.begin(), amounts.end());
+  // 第 k 个边界取第 k*n/buckets 个金额，使每个桶的笔数大致相等
+  for (size_t k = 1; k < buckets; ++k) {
+    edges.push_back(amounts[k * amounts.size() / buckets]);
+  }
+  return AmountHistogram(std::move(edges));
+}
+
+bool AmountHistogram::parse(const std::string& spec, AmountHistogram& out) {
+  std::vector<std::string> parts = DataPersistence::split(
+      spec, spec.find(':') != std::string::npos ? ':' : ',');
+  std::vector<double> values;
+  size_t first = parts[0] == "linear" || parts[0] == "log" ? 1 : 0;
+  for (size_t i = first; i < parts.size(); ++i) {
+    char* end = nullptr;
+    double value = std::strtod(parts[i].c_str(), &end);
+    if (parts[i].empty() || *end != '\0' || !std::isfinite(value)) {
+      return false;
+    }
+    values.push_back(value);
+  }
+  if (first == 0) {
+    if (spec.find(':') != std::string::npos) return false;
+    out = AmountHistogram(std::move(values));
+    return true;
+  }
+  if (values.size() != 3 || values[2] < 1 || values[2] > 10000 ||
+      values[2] != std::floor(values[2]) || !(values[0] < values[1]) ||
+      (parts[0] == "log" && !(values[0] > 0.0))) {
+    return false;
+  }
+  size_t buckets = static_cast<size_t>(values[2]);
+  out = parts[0] == "linear" ? linear(values[0], values[1], buckets)
+                             : logScale(values[0], values[1], buckets);
+  return true;
+}
+
+namespace {
+
+// 整数边界不带小数，其余保留两位
+std::string formatEdge(double edge) {
+  char buf[64];
+  bool whole = edge == std::floor(edge) && std::fabs(edge) < 1e15;
+  std::snprintf(buf, sizeof(buf), whole ? "%.0f" : "%.2f", edge);
+  return buf;
+}
+
+}  // namespace
+
+std::string AmountHistogram::label(size_t bucket) const {
+  if (edges.empty()) return "全部";
+  if (bucket == 0) return "小于" + formatEdge(edges[0]);
+  if (bucket >= edges.size()) return formatEdge(edges.back()) + "及以上";
+  // 两端都是整数且宽度不小于 1 时按整数闭区间显示，如 100-499
+  double low = edges[bucket - 1], high = edges[bucket];
+  bool whole = low == std::floor(low) && high == std::floor(high) &&
+               high - low >= 1.0 && std::fabs(high) < 1e15;
+  return formatEdge(low) + "-" + formatEdge(whole ? high - 1 : high);
+}
+
+void QuantileSketch::merge(const QuantileSketch& other) {
+  buffer.insert(buffer.end(), other.centroids.begin(), other.centroids.end());
+  buffer.insert(buffer.end(), other.buffer.begin(), other.buffer.end());
+  weight += other.weight;
+  min = std::min(min, other.min);
+  max = std::max(max, other.max);
+  if (buffer.size() >= 5 * compression) flush();
+}
+
+void QuantileSketch::flush() {
+  if (buffer.empty()) return;
+  buffer.insert(buffer.end(), centroids.begin(), centroids.end());
+  std::sort(buffer.begin(), buffer.end(),
+            [](const Centroid& a, const Centroid& b) { return a.mean < b.mean; });
+  // k1 尺度：分位点 q 处质心最多覆盖 2π·sqrt(q(1-q))/compression 的权重，
+  // 两端的质心趋于单点，质心总数约为 compression/2
+  const double scale = 2 * 3.14159265358979323846 / compression;
+  centroids.clear();
+  Centroid current = buffer[0];
+  double before = 0.0;  // current 之前的总权重
+  for (size_t i = 1; i < buffer.size(); ++i) {
+    double proposed = current.weight + buffer[i].weight;
+    double q0 = before / weight, q2 = (before + proposed) / weight;
+    double limit = weight * scale *
+                   std::sqrt(std::min(q0 * (1 - q0), q2 * (1 - q2)));
+    if (proposed <= limit) {
+      current.mean += (buffer[i].mean - current.mean) * buffer[i].weight /
+                      proposed;
+      current.weight = proposed;
+    } else {
+      before += current.weight;
+      centroids.push_back(current);
+      current = buffer[i];
+    }
+  }
+  centroids.push_back(current);
+  std::vector<Centroid>().swap(buffer);
+}
+
+double QuantileSketch::quantile(double q) const {
+  if (weight == 0.0) return 0.0;
+  if (!buffer.empty()) {
+    QuantileSketch flushed(*this);
+    flushed.flush();
+    return flushed.quantile(q);
+  }
+  q = std::min(std::max(q, 0.0), 1.0);
+  if (centroids.size() == 1) return centroids[0].mean;
+  // 每个质心的均值视为位于其权重的中点，相邻中点之间线性插值；
+  // 第一个和最后一个质心的外侧插值到最小值、最大值
+  double target = q * weight;
+  const Centroid& first = centroids.front();
+  if (target < first.weight / 2) {
+    return min + (first.mean - min) * target / (first.weight / 2);
+  }
+  double position = first.weight / 2;
+  for (size_t i = 0; i + 1 < centroids.size(); ++i) {
+    double gap = (centroids[i].weight + centroids[i + 1].weight) / 2;
+    if (position + gap > target) {
+      return centroids[i].mean + (centroids[i + 1].mean - centroids[i].mean) *
+                                     (target - position) / gap;
+    }
+    position += gap;
+  }
+  const Centroid& last = centroids.back();
+  double tail = std::min((target - position) / (last.weight / 2), 1.0);
+  return last.mean + (max - last.mean) * tail;
+}
+
+namespace {
+
+// 每次处理 8 字节的乘法散列，最后经 splitmix64 混合，使各位都足够均匀，
+// 供 HyperLogLog 使用
+uint64_t hash64(std::string_view data) {
+  auto mix = [](uint64_t h) {
+    h ^= h >> 30;
+    h *= 0xbf58476d1ce4e5b9ull;
+    h ^= h >> 27;
+    h *= 0x94d049bb133111ebull;
+    return h ^ (h >> 31);
+  };
+  uint64_t h = 0x9e3779b97f4a7c15ull ^ data.size();
+  size_t i = 0;
+  for (; i + 8 <= data.size(); i += 8) {
+    uint64_t word;
+    std::memcpy(&word, data.data() + i, 8);
+    h = (h ^ (word * 0xff51afd7ed558ccdull)) * 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 29;
+  }
+  uint64_t tail = 0;
+  for (size_t shift = 0; i < data.size(); ++i, shift += 8) {
+    tail |= static_cast<uint64_t>(static_cast<unsigned char>(data[i])) << shift;
+  }
+  return mix(h ^ (tail * 0xff51afd7ed558ccdull));
+}
+
+// 关键词分隔符的字节数，不是分隔符时为 0。分隔符为 ASCII 空白、标点
+// 和常见的全角标点（　、。（）！，：；？）
+size_t separatorWidth(std::string_view text, size_t i) {
+  unsigned char c = static_cast<unsigned char>(text[i]);
+  if (c < 0x80) {
+    return c <= ' ' || (c >= '!' && c <= '/') || (c >= ':' && c <= '@') ||
+           (c >= '[' && c <= '`') || c >= '{';
+  }
+  if (i + 2 >= text.size()) return 0;
+  unsigned char c1 = static_cast<unsigned char>(text[i + 1]);
+  unsigned char c2 = static_cast<unsigned char>(text[i + 2]);
+  if (c == 0xE3 && c1 == 0x80 && c2 <= 0x82) return 3;  // U+3000~U+3002
+  if (c == 0xEF && c1 == 0xBC) {
+    switch (c2) {
+      case 0x81: case 0x88: case 0x89: case 0x8C: case 0x9A: case 0x9B:
+      case 0x9F:
+        return 3;
+      default:
+        break;
+    }
+  }
+  return 0;
+}
+
+// 备注按分隔符切分为关键词
+template <typename Fn>
+void forEachKeyword(std::string_view text, Fn fn) {
+  size_t start = 0;
+  for (size_t i = 0; i < text.size();) {
+    size_t width = separatorWidth(text, i);
+    if (width == 0) {
+      ++i;
+      continue;
+    }
+    if (i > start) fn(text.substr(start, i - start));
+    i += width;
+    start = i;
+  }
+  if (start < text.size()) fn(text.substr(start));
+}
+
+}  // namespace
+
+void DistinctSketch::add(std::string_view item) {
+  if (registers.empty()) registers.assign(size_t(1) << PRECISION, 0);
+  uint64_t h = hash64(item);
+  size_t index = static_cast<size_t>(h >> (64 - PRECISION));
+  // 其余位中第一个 1 的位置（从 1 起）
+  uint64_t rest = h << PRECISION;
+  uint8_t rank = 1;
+  while (rank <= 64 - PRECISION && !(rest & (1ull << 63))) {
+    rest <<= 1;
+    ++rank;
+  }
+  registers[index] = std::max(registers[index], rank);
+}
+
+void DistinctSketch::merge(const DistinctSketch& other) {
+  if (other.registers.empty()) return;
+  if (registers.empty()) {
+    registers = other.registers;
+    return;
+  }
+  for (size_t i = 0; i < registers.size(); ++i) {
+    registers[i] = std::max(registers[i], other.registers[i]);
+  }
+}
+
+double DistinctSketch::estimate() const {
+  if (registers.empty()) return 0.0;
+  double m = static_cast<double>(registers.size());
+  double sum = 0.0;
+  size_t zeros = 0;
+  for (size_t i = 0; i < registers.size(); ++i) {
+    sum += std::ldexp(1.0, -registers[i]);
+    if (registers[i] == 0) ++zeros;
+  }
+  double estimate = 0.7213 / (1 + 1.079 / m) * m * m / sum;
+  // 基数较小时改用线性计数
+  if (estimate <= 2.5 * m && zeros > 0) {
+    estimate = m * std::log(m / static_cast<double>(zeros));
+  }
+  return estimate;
+}
+
+void GroupSketch::add(const Transaction& tx) {
+  if (tx.getType() == TransactionType::Expense) expenses.add(tx.getAmount());
+  std::string_view text = tx.getRemarks();
+  if (text.empty()) return;
+  remarks.add(text);
+  forEachKeyword(text, [this](std::string_view word) { keywords.add(word); });
+}
+
+void GroupSketch::merge(const GroupSketch& other) {
+  expenses.merge(other.expenses);
+  remarks.merge(other.remarks);
+  keywords.merge(other.keywords);
+}
+
+void StatisticService::mergeReport(StatisticReport& into,
+                                   const StatisticReport& part) {
+  std::unordered_map<std::string_view, size_t> index;
+  for (size_t i = 0; i < into.rows.size(); ++i) {
+    index.emplace(into.rows[i].key, i);
+  }
+  into.totalIncome += part.totalIncome;
+  into.totalExpense += part.totalExpense;
+  bool sketches = !part.sketches.empty();
+  for (size_t i = 0; i < part.rows.size(); ++i) {
+    const StatisticRow& from = part.rows[i];
+    auto it = index.find(from.key);
+    if (it == index.end()) {
+      into.rows.push_back(from);
+      if (sketches) into.sketches.push_back(part.sketches[i]);
+      continue;
+    }
+    StatisticRow& row = into.rows[it->second];
+    row.income += from.income;
+    row.expense += from.expense;
+    row.incomeCount += from.incomeCount;
+    row.expenseCount += from.expenseCount;
+    if (sketches) into.sketches[it->second].merge(part.sketches[i]);
+  }
+}
+
+StatisticReport StatisticService::topCategories(
+    size_t n, const std::vector<std::string>& range) const {
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  StatisticReport all = reportByCategory(range);
+  METRICS_SCOPE(m, Ranking);
+  // 分类数远小于行数，先按分类汇总，再从汇总结果中选前 n 名
+  auto greater = [&all](size_t a, size_t b) {
+    return all.rows[a].expense > all.rows[b].expense ||
+           (all.rows[a].expense == all.rows[b].expense && a < b);
+  };
+  TopN<size_t, decltype(greater)> top(n, greater, all.rows.size());
+  for (size_t i = 0; i < all.rows.size(); ++i) {
+    if (all.rows[i].expenseCount > 0) top.push(i);
+  }
+  StatisticReport report;
+  report.totalIncome = all.totalIncome;
+  report.totalExpense = all.totalExpense;
+  std::vector<size_t> order = top.take();
+  for (size_t i = 0; i < order.size(); ++i) {
+    report.rows.push_back(std::move(all.rows[order[i]]));
+  }
+  METRICS_ADD(m, scanned, all.rows.size());
+  METRICS_ADD(m, matched, report.rows.size());
+  return report;
+}
+
+std::vector<Transaction> StatisticService::topTransactions(
+    size_t n, TransactionType type,
+    const std::vector<std::string>& range) const {
+  METRICS_SCOPE(m, Ranking);
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  METRICS_ADD(m, scanned, transactions.size());
+  // 堆中只存行号，结果确定后才复制交易
+  auto greater = [this](size_t a, size_t b) {
+    double x = transactions[a].getAmount(), y = transactions[b].getAmount();
+    return x > y || (x == y && a < b);
+  };
+  TopN<size_t, decltype(greater)> top(n, greater, transactions.size());
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    if (Transaction::isDeleted(deleted, i)) continue;
+    const Transaction& tx = transactions[i];
+    if (tx.getType() != type || !inDateRange(tx.getTime(), range)) continue;
+    top.push(i);
+  }
+  std::vector<size_t> order = top.take();
+  std::vector<Transaction> result;
+  result.reserve(order.size());
+  for (size_t i = 0; i < order.size(); ++i) {
+    result.push_back(transactions[order[i]]);
+  }
+  METRICS_ADD(m, matched, result.size());
+  return result;
+}
+
+StatisticReport StatisticService::topTerms(
+    size_t n, const std::vector<std::string>& range) const {
+  METRICS_SCOPE(m, Ranking);
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  METRICS_ADD(m, scanned, transactions.size());
+  // 关键词直接指向备注文本，持有读锁（或快照）期间有效
+  std::unordered_map<std::string_view, StatisticRow> totals;
+  std::vector<std::string_view> words;
+  StatisticReport report;
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    if (Transaction::isDeleted(deleted, i)) continue;
+    const Transaction& tx = transactions[i];
+    if (!inDateRange(tx.getTime(), range)) continue;
+    if (tx.getType() == TransactionType::Income) {
+      report.totalIncome += tx.getAmount();
+      continue;
+    }
+    report.totalExpense += tx.getAmount();
+    words.clear();
+    forEachKeyword(tx.getRemarks(),
+                   [&words](std::string_view word) { words.push_back(word); });
+    std::sort(words.begin(), words.end());
+    words.erase(std::unique(words.begin(), words.end()), words.end());
+    for (size_t w = 0; w < words.size(); ++w) {
+      StatisticRow& row = totals[words[w]];
+      row.expense += tx.getAmount();
+      ++row.expenseCount;
+    }
+  }
+
+  typedef std::unordered_map<std::string_view, StatisticRow>::const_iterator
+      Entry;
+  auto greater = [](Entry a, Entry b) {
+    return a->second.expense > b->second.expense ||
+           (a->second.expense == b->second.expense && a->first < b->first);
+  };
+  TopN<Entry, decltype(greater)> top(n, greater, totals.size());
+  for (Entry it = totals.begin(); it != totals.end(); ++it) top.push(it);
+  std::vector<Entry> order = top.take();
+  for (size_t i = 0; i < order.size(); ++i) {
+    report.rows.push_back(order[i]->second);
+    report.rows.back().key = std::string(order[i]->first);
+  }
+  METRICS_ADD(m, matched, report.rows.size());
+  return report;
+}
+
+StatisticReport StatisticService::reportByType(
+    const std::vector<std::string>& range) const {
+  METRICS_SCOPE(m, ReportByType);
+  // 埋点计数也要读取仓库大小，整个报表都在读锁内完成（group 内层加锁为空操作）
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  StatisticReport report = group([](const Transaction& tx) {
+    return std::string(tx.getType() == TransactionType::Income ?
+                       "收入" : "支出");
+  }, range);
+  METRICS_ADD(m, scanned, transactions.size());
+  METRICS_ADD(m, matched, countedRows(report));
+  return report;
+}
+
+StatisticReport StatisticService::reportByTime(
+    TimeGroup timeGroup, const std::vector<std::string>& range) const {
+  METRICS_SCOPE(m, ReportByTime);
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  StatisticReport report = group([timeGroup](const Transaction& tx) {
+    return getTimeKey(tx.getTime(), timeGroup);
+  }, range);
+  METRICS_ADD(m, scanned, transactions.size());
+  METRICS_ADD(m, matched, countedRows(report));
+  return report;
+}
+
+StatisticReport StatisticService::reportByCategory(
+    const std::vector<std::string>& range) const {
+  METRICS_SCOPE(m, ReportByCategory);
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  std::unordered_map<LedgerId, std::string> names;
+  auto addName = [&names](const Category& c) {
+    names.emplace(c.getId(), c.getName());
+  };
+  if (pinned.valid()) {
+    const std::vector<Category>& cats = pinned.categories();
+    for (size_t i = 0; i < cats.size(); ++i) addName(cats[i]);
+  } else {
+    Category::forEachCategory(addName);
+  }
+  StatisticReport report = group([&names](const Transaction& tx) {
+    auto name = names.find(tx.getCategoryId());
+    return name != names.end() ? name->second : tx.getCategoryId().str();
+  }, range);
+  METRICS_ADD(m, scanned, transactions.size());
+  METRICS_ADD(m, matched, countedRows(report));
+  return report;
+}
+
+StatisticReport StatisticService::reportByAmountRange(
+    const std::vector<std::string>& range) const {
+  return reportByHistogram(AmountHistogram::defaults(), range);
+}
+
+StatisticReport StatisticService::reportByHistogram(
+    const AmountHistogram& buckets,
+    const std::vector<std::string>& range) const {
+  METRICS_SCOPE(m, ReportByAmountRange);
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  // 按桶下标直接累加，[0] 为收入、[1] 为支出
+  std::vector<double> sums[2];
+  std::vector<int> counts[2];
+  for (int t = 0; t < 2; ++t) {
+    sums[t].assign(buckets.bucketCount(), 0.0);
+    counts[t].assign(buckets.bucketCount(), 0);
+  }
+  std::vector<GroupSketch> sketches(withSketches ? buckets.bucketCount() : 0);
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    if (Transaction::isDeleted(deleted, i)) continue;
+    const Transaction& tx = transactions[i];
+    if (!inDateRange(tx.getTime(), range)) continue;
+    int t = tx.getType() == TransactionType::Income ? 0 : 1;
+    size_t bucket = buckets.bucketOf(tx.getAmount());
+    sums[t][bucket] += tx.getAmount();
+    ++counts[t][bucket];
+    if (withSketches) sketches[bucket].add(tx);
+  }
+
+  StatisticReport report;
+  for (size_t b = 0; b < buckets.bucketCount(); ++b) {
+    report.totalIncome += sums[0][b];
+    report.totalExpense += sums[1][b];
+    if (counts[0][b] == 0 && counts[1][b] == 0) continue;
+    report.rows.push_back(StatisticRow());
+    StatisticRow& row = report.rows.back();
+    row.key = buckets.label(b);
+    row.income = sums[0][b];
+    row.expense = sums[1][b];
+    row.incomeCount = counts[0][b];
+    row.expenseCount = counts[1][b];
+    if (withSketches) {
+      sketches[b].expenses.flush();
+      report.sketches.push_back(std::move(sketches[b]));
+    }
+  }
+  METRICS_ADD(m, scanned, transactions.size());
+  METRICS_ADD(m, matched, countedRows(report));
+  return report;
+}
+
+AmountHistogram StatisticService::quantileHistogram(
+    size_t buckets, const std::vector<std::string>& range) const {
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  std::vector<double> amounts;
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    if (Transaction::isDeleted(deleted, i)) continue;
+    if (!inDateRange(transactions[i].getTime(), range)) continue;
+    amounts.push_back(transactions[i].getAmount());
+  }
+  return AmountHistogram::quantiles(std::move(amounts), buckets);
+}
+
+void StatisticService::calculateHomePage(double& totalIncome,
+                                         double& totalExpense,
+                                         double& balance) {
+  METRICS_SCOPE(m, HomePage);
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  METRICS_ADD(m, scanned, transactions.size());
+  totalIncome = totalExpense = 0.0;
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    if (Transaction::isDeleted(deleted, i)) continue;
+    if (transactions[i].getType() == TransactionType::Income) {
+      totalIncome += transactions[i].getAmount();
+    } else {
+      totalExpense += transactions[i].getAmount();
+    }
+  }
+  balance = totalIncome - totalExpense;
+}
+
+std::vector<Transaction> SearchService::searchTransaction(
+    const std::vector<std::string>& dateRange,
+    const std::vector<double>& amountRange, const std::string& categoryId,
+    const std::string& keyword) const {
+  METRICS_SCOPE(m, Search);
+  LedgerLock::ReadGuard guard(!pinned.valid());
+  METRICS_ADD(m, scanned, transactions.size());
+  const SearchFilter filter(dateRange, amountRange, categoryId, keyword);
+  std::vector<Transaction> result;
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    if (Transaction::isDeleted(deleted, i)) continue;
+    if (filter(transactions[i])) result.push_back(transactions[i]);
+  }
+  METRICS_ADD(m, matched, result.size());
+  return result;
+}
+
+std::vector<Transaction> UIService::sortTransactionList(
+    std::vector<Transaction> list, SortField field, SortDirection direction) {
+  METRICS_SCOPE(m, Sort);
+  METRICS_ADD(m, scanned, list.size());
+  bool asc = direction == SortDirection::Asc;
+  if (field == SortField::Amount) {
+    std::stable_sort(list.begin(), list.end(),
+                     [asc](const Transaction& a, const Transaction& b) {
+                       return asc ? a.getAmount() < b.getAmount() :
+                                    a.getAmount() > b.getAmount();
+                     });
+  } else {
+    std::stable_sort(list.begin(), list.end(),
+                     [asc](const Transaction& a, const Transaction& b) {
+                       return asc ? a.getTime() < b.getTime() :
+                                    a.getTime() > b.getTime();
+                     });
+  }
+  return list;
+}
+
+StatisticReport StatisticService::report(
+    StatisticDimension dimension, const std::vector<std::string>& range,
+    const AmountHistogram* buckets) const {
+  switch (dimension) {
+    case StatisticDimension::Type:
+      return reportByType(range);
+    case StatisticDimension::Day:
+      return reportByTime(TimeGroup::Daily, range);
+    case StatisticDimension::Month:
+      return reportByTime(TimeGroup::Monthly, range);
+    case StatisticDimension::Year:
+      return reportByTime(TimeGroup::Yearly, range);
+    case StatisticDimension::Category:
+      return reportByCategory(range);
+    default:
+      return buckets ? reportByHistogram(*buckets, range)
+                     : reportByAmountRange(range);
+  }
+}
+
+std::mutex QueryCache::mutex;
+QueryCache::EntryList QueryCache::entries;
+std::unordered_map<std::string, QueryCache::EntryList::iterator>
+    QueryCache::index;
+uint64_t QueryCache::cachedVersion = 0;
+size_t QueryCache::bytesUsed = 0;
+size_t QueryCache::bytesBudget = QueryCache::DEFAULT_BUDGET;
+std::atomic<uint64_t> QueryCache::hitCount(0);
+std::atomic<uint64_t> QueryCache::missCount(0);
+
+QueryCache::TransactionList QueryCache::search(const SearchQuery& query) {
+  // 规范化：空日期范围与两端都为空等价，未排序时忽略排序方向。
+  // 字段之间用 '\0' 分隔，避免不同字段拼接后产生相同的键
+  std::string key = "search";
+  key += '\0';
+  if (query.dateRange.size() == 2) {
+    key += query.dateRange[0] + '\0' + query.dateRange[1];
+  } else {
+    key += '\0';
+  }
+  key += '\0';
+  if (query.amountRange.size() == 2) {
+    char buf[64];
+    std::snprintf(buf, sizeof(buf), "%.17g,%.17g", query.amountRange[0],
+                  query.amountRange[1]);
+    key += buf;
+  }
+  key += '\0' + query.categoryId + '\0' + query.keyword + '\0';
+  if (query.sorted) {
+    key += query.sortField == SortField::Amount ? 'a' : 't';
+    key += query.direction == SortDirection::Asc ? '+' : '-';
+  }
+
+  // 持有写锁时仓库可能已改而版本号未变，此时绕过缓存
+  bool cacheable = !LedgerLock::writeHeld();
+  std::shared_ptr<const void> hit = cacheable ? lookup(key) : nullptr;
+  if (hit) return std::static_pointer_cast<const std::vector<Transaction>>(hit);
+
+  // 未命中：在读锁内读取版本号并计算，保证结果与版本号对应
+  LedgerLock::ReadGuard guard;
+  uint64_t version = LedgerLock::version();
+  SearchService searchService(Transaction::list());
+  std::vector<Transaction> found = searchService.searchTransaction(
+      query.dateRange, query.amountRange, query.categoryId, query.keyword);
+  if (query.sorted) {
+    found = UIService::sortTransactionList(std::move(found), query.sortField,
+                                           query.direction);
+  }
+  std::shared_ptr<const std::vector<Transaction>> result =
+      std::make_shared<const std::vector<Transaction>>(std::move(found));
+  if (cacheable) store(key, version, result, key.size() + footprint(*result));
+  return result;
+}
+
+QueryCache::Report QueryCache::statistic(
+    StatisticDimension dimension, const std::vector<std::string>& range,
+    const AmountHistogram* buckets) {
+  std::string key = "stats";
+  key += '\0';
+  key += static_cast<char>('0' + static_cast<int>(dimension));
+  key += '\0';
+  if (range.size() == 2) key += range[0] + '\0' + range[1];
+  // 自定义桶划分按边界的原始字节区分，放在末尾不会与日期范围混淆
+  if (buckets && dimension == StatisticDimension::AmountRange) {
+    key += '\0';
+    const std::vector<double>& edges = buckets->getEdges();
+    key.append(reinterpret_cast<const char*>(edges.data()),
+               edges.size() * sizeof(double));
+  } else {
+    buckets = nullptr;
+  }
+
+  bool cacheable = !LedgerLock::writeHeld();
+  std::shared_ptr<const void> hit = cacheable ? lookup(key) : nullptr;
+  if (hit) return std::static_pointer_cast<const StatisticReport>(hit);
+
+  LedgerLock::ReadGuard guard;
+  uint64_t version = LedgerLock::version();
+  StatisticService stat(Transaction::list());
+  std::shared_ptr<const StatisticReport> result =
+      std::make_shared<const StatisticReport>(
+          stat.report(dimension, range, buckets));
+  if (cacheable) store(key, version, result, key.size() + footprint(*result));
+  return result;
+}
+
+std::shared_ptr<const void> QueryCache::lookup(const std::string& key) {
+  uint64_t version = LedgerLock::version();
+  std::lock_guard<std::mutex> lock(mutex);
+  dropStale(version);
+  auto it = index.find(key);
+  if (it == index.end()) {
+    ++missCount;
+    return nullptr;
+  }
+  ++hitCount;
+  entries.splice(entries.begin(), entries, it->second);
+  return it->second->value;
+}
+
+void QueryCache::store(const std::string& key, uint64_t version,
+                       std::shared_ptr<const void> value, size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  dropStale(version);
+  // 计算期间版本已前进（结果过期）或单条超过预算时不缓存
+  if (version != cachedVersion || bytes > bytesBudget) return;
+  auto it = index.find(key);
+  if (it != index.end()) {
+    // 其他线程已缓存同一结果
+    entries.splice(entries.begin(), entries, it->second);
+    return;
+  }
+  entries.push_front(Entry{key, std::move(value), bytes});
+  index.emplace(key, entries.begin());
+  bytesUsed += bytes;
+  evictToBudget();
+}
+
+void QueryCache::dropStale(uint64_t version) {
+  if (version <= cachedVersion) return;
+  entries.clear();
+  index.clear();
+  bytesUsed = 0;
+  cachedVersion = version;
+}
+
+void QueryCache::evictToBudget() {
+  while (bytesUsed > bytesBudget && !entries.empty()) {
+    bytesUsed -= entries.back().bytes;
+    index.erase(entries.back().key);
+    entries.pop_back();
+  }
+}
+
+void QueryCache::setBudget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  bytesBudget = bytes;
+  evictToBudget();
+}
+
+size_t QueryCache::budget() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return bytesBudget;
+}
+
+size_t QueryCache::memoryUsage() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return bytesUsed;
+}
+
+size_t QueryCache::size() {
+  std::lock_guard<std::mutex> lock(mutex);
+  return entries.size();
+}
+
+uint64_t QueryCache::hits() { return hitCount.load(); }
+uint64_t QueryCache::misses() { return missCount.load(); }
+
+void QueryCache::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+  entries.clear();
+  index.clear();
+  bytesUsed = 0;
+  hitCount = 0;
+  missCount = 0;
+}
+
+void QueryCache::write(std::ostream& out) {
+  out << "# HELP bookkeeping_query_cache_hits_total 查询缓存命中次数\n"
+      << "# TYPE bookkeeping_query_cache_hits_total counter\n"
+      << "bookkeeping_query_cache_hits_total " << hits() << '\n'
+      << "# HELP bookkeeping_query_cache_misses_total 查询缓存未命中次数\n"
+      << "# TYPE bookkeeping_query_cache_misses_total counter\n"
+      << "bookkeeping_query_cache_misses_total " << misses() << '\n'
+      << "# HELP bookkeeping_query_cache_bytes 查询缓存估算占用的内存\n"
+      << "# TYPE bookkeeping_query_cache_bytes gauge\n"
+      << "bookkeeping_query_cache_bytes " << memoryUsage() << '\n'
+      << "# HELP bookkeeping_query_cache_entries 查询缓存的条目数\n"
+      << "# TYPE bookkeeping_query_cache_entries gauge\n"
+      << "bookkeeping_query_cache_entries " << size() << '\n';
+}
+
+size_t QueryCache::footprint(const std::string& str) {
+  // 超出短字符串缓冲区的部分才单独占用堆内存
+  return str.capacity() >= sizeof(std::string) ? str.capacity() + 1 : 0;
+}
+
+size_t QueryCache::footprint(const std::vector<Transaction>& list) {
+  size_t bytes = sizeof(list) + list.capacity() * sizeof(Transaction);
+  for (size_t i = 0; i < list.size(); ++i) {
+    // ID 内联存放，不占额外堆内存
+    // 载入的备注存放在 RemarkArena 中，不计入
+    bytes += footprint(list[i].getTime()) +
+             footprint(list[i].getRemarkStorage().ownedText());
+  }
+  return bytes;
+}
+
+size_t QueryCache::footprint(const StatisticReport& report) {
+  size_t bytes = sizeof(report) + report.rows.capacity() * sizeof(StatisticRow);
+  for (size_t i = 0; i < report.rows.size(); ++i) {
+    bytes += footprint(report.rows[i].key);
+  }
+  return bytes;
+}
+
+void ReportWriter::writeTransactions(std::ostream& out,
+                                     const std::vector<Transaction>& list,
+                                     OutputFormat format) {
+  writeRows(out, list, nullptr, format);
+}
+
+void ReportWriter::exportTransactions(std::ostream& out,
+                                      const SearchQuery& query,
+                                      OutputFormat format) {
+  const SearchFilter filter(query);
+  writeRows(out, Transaction::list(), &filter, format);
+}
+
+void ReportWriter::writeRows(std::ostream& out,
+                             const std::vector<Transaction>& list,
+                             const SearchFilter* filter, OutputFormat format) {
+  LedgerLock::ReadGuard guard;
+  // 分类名先建成哈希表，避免逐行线性查找；读锁已持有，键值直接引用仓库
+  std::unordered_map<LedgerId, const std::string*> names;
+  Category::forEachCategory([&names](const Category& c) {
+    names.emplace(c.getId(), &c.getName());
+  });
+
+  std::string buffer;
+  buffer.reserve(BUFFER_SIZE);
+  if (format == OutputFormat::Csv) {
+    buffer += "id,amount,date,category_id,category_name,type,remarks\n";
+  } else if (format == OutputFormat::Json) {
+    buffer += '[';
+  }
+  const std::vector<uint64_t>* deleted = Transaction::deletedMask(list);
+  bool first = true;
+  for (size_t i = 0; i < list.size(); ++i) {
+    if (Transaction::isDeleted(deleted, i)) continue;
+    const Transaction& tx = list[i];
+    if (filter != nullptr && !(*filter)(tx)) continue;
+    auto name = names.find(tx.getCategoryId());
+    std::string_view categoryName = name != names.end() ?
+        std::string_view(*name->second) : tx.getCategoryId().view();
+    const char* type =
+        tx.getType() == TransactionType::Income ? "income" : "expense";
+    if (format == OutputFormat::Csv) {
+      appendCsvField(buffer, tx.getId().view());
+      buffer += ',';
+      appendAmount(buffer, tx.getAmount());
+      buffer += ',';
+      buffer += tx.getTime();
+      buffer += ',';
+      appendCsvField(buffer, tx.getCategoryId().view());
+      buffer += ',';
+      appendCsvField(buffer, categoryName);
+      buffer += ',';
+      buffer += type;
+      buffer += ',';
+      appendCsvField(buffer, tx.getRemarks());
+      buffer += '\n';
+    } else {
+      if (format == OutputFormat::Json) buffer += first ? "\n" : ",\n";
+      buffer += "{\"id\":";
+      appendJsonString(buffer, tx.getId().view());
+      buffer += ",\"amount\":";
+      appendAmount(buffer, tx.getAmount());
+      buffer += ",\"date\":";
+      appendJsonString(buffer, tx.getTime());
+      buffer += ",\"category_id\":";
+      appendJsonString(buffer, tx.getCategoryId().view());
+      buffer += ",\"category_name\":";
+      appendJsonString(buffer, categoryName);
+      buffer += ",\"type\":\"";
+      buffer += type;
+      buffer += "\",\"remarks\":";
+      appendJsonString(buffer, tx.getRemarks());
+      buffer += '}';
+      if (format == OutputFormat::JsonLines) buffer += '\n';
+      first = false;
+    }
+    // 超过阈值整块写出；缓冲区最多再多出一行的长度
+    if (buffer.size() >= BUFFER_SIZE) {
+      out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+      buffer.clear();
+    }
+  }
+  if (format == OutputFormat::Json) buffer += "\n]\n";
+  out.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+}
+
+namespace {
+
+// 带 sketch 的统计在每行末尾追加的近似列
+const char* const kSketchColumns[] = {"expense_p50", "expense_p90",
+                                      "expense_p99", "distinct_remarks",
+                                      "distinct_keywords"};
+
+void writeSketchColumns(std::ostream& out, const GroupSketch& sketch,
+                        bool json) {
+  std::string values[] = {
+      ReportWriter::formatAmount(sketch.expenses.quantile(0.5)),
+      ReportWriter::formatAmount(sketch.expenses.quantile(0.9)),
+      ReportWriter::formatAmount(sketch.expenses.quantile(0.99)),
+      std::to_string(std::llround(sketch.remarks.estimate())),
+      std::to_string(std::llround(sketch.keywords.estimate()))};
+  for (size_t i = 0; i < 5; ++i) {
+    if (json) {
+      out << ",\"" << kSketchColumns[i] << "\":" << values[i];
+    } else {
+      out << ',' << values[i];
+    }
+  }
+}
+
+}  // namespace
+
+void ReportWriter::writeReport(std::ostream& out, const StatisticReport& report,
+                               OutputFormat format) {
+  bool sketched = !report.sketches.empty();
+  if (format == OutputFormat::Csv) {
+    out << "key,income,expense,balance,income_count,expense_count";
+    for (size_t i = 0; sketched && i < 5; ++i) out << ',' << kSketchColumns[i];
+    out << '\n';
+    for (size_t i = 0; i < report.rows.size(); ++i) {
+      const StatisticRow& row = report.rows[i];
+      out << csvField(row.key) << ',' << formatAmount(row.income) << ','
+          << formatAmount(row.expense) << ','
+          << formatAmount(row.income - row.expense) << ','
+          << row.incomeCount << ',' << row.expenseCount;
+      if (sketched) writeSketchColumns(out, report.sketches[i], false);
+      out << '\n';
+    }
+    return;
+  }
+  if (format == OutputFormat::JsonLines) {
+    // 每个分组一行，汇总可由各行相加得到
+    for (size_t i = 0; i < report.rows.size(); ++i) {
+      const StatisticRow& row = report.rows[i];
+      out << "{\"key\":" << jsonString(row.key)
+          << ",\"income\":" << formatAmount(row.income)
+          << ",\"expense\":" << formatAmount(row.expense)
+          << ",\"balance\":" << formatAmount(row.income - row.expense)
+          << ",\"income_count\":" << row.incomeCount
+          << ",\"expense_count\":" << row.expenseCount;
+      if (sketched) writeSketchColumns(out, report.sketches[i], true);
+      out << "}\n";
+    }
+    return;
+  }
+  out << "{\"total_income\":" << formatAmount(report.totalIncome)
+      << ",\"total_expense\":" << formatAmount(report.totalExpense)
+      << ",\"balance\":"
+      << formatAmount(report.totalIncome - report.totalExpense)
+      << ",\"rows\":[";
+  for (size_t i = 0; i < report.rows.size(); ++i) {
+    const StatisticRow& row = report.rows[i];
+    out << (i == 0 ? "\n" : ",\n")
+        << "{\"key\":" << jsonString(row.key)
+        << ",\"income\":" << formatAmount(row.income)
+        << ",\"expense\":" << formatAmount(row.expense)
+        << ",\"balance\":" << formatAmount(row.income - row.expense)
+        << ",\"income_count\":" << row.incomeCount
+        << ",\"expense_count\":" << row.expenseCount;
+    if (sketched) writeSketchColumns(out, report.sketches[i], true);
+    out << '}';
+  }
+  out << "\n]}\n";
+}
+
+void ReportWriter::writeBalanceSeries(std::ostream& out,
+                                      const std::vector<BalancePoint>& points,
+                                      OutputFormat format) {
+  if (format == OutputFormat::Csv) out << "key,balance\n";
+  if (format == OutputFormat::Json) out << '[';
+  for (size_t i = 0; i < points.size(); ++i) {
+    if (format == OutputFormat::Csv) {
+      out << csvField(points[i].period) << ','
+          << formatAmount(points[i].balance) << '\n';
+      continue;
+    }
+    if (format == OutputFormat::Json) out << (i == 0 ? "\n" : ",\n");
+    out << "{\"key\":" << jsonString(points[i].period)
+        << ",\"balance\":" << formatAmount(points[i].balance) << '}';
+    if (format == OutputFormat::JsonLines) out << '\n';
+  }
+  if (format == OutputFormat::Json) out << "\n]\n";
+}
+
+void ReportWriter::writeBudgetStatus(std::ostream& out,
+                                     const std::vector<BudgetStatus>& statuses,
+                                     OutputFormat format) {
+  const char* periods[] = {"day", "month", "year"};
+  if (format == OutputFormat::Csv) {
+    out << "category,period,key,limit,spent,remaining,over_limit\n";
+  }
+  if (format == OutputFormat::Json) out << '[';
+  for (size_t i = 0; i < statuses.size(); ++i) {
+    const BudgetStatus& s = statuses[i];
+    const char* period = periods[static_cast<int>(s.budget.period)];
+    if (format == OutputFormat::Csv) {
+      out << csvField(s.budget.categoryId.view()) << ',' << period << ','
+          << csvField(s.periodKey) << ',' << formatAmount(s.budget.limit)
+          << ',' << formatAmount(s.spent) << ','
+          << formatAmount(s.remaining()) << ',' << (s.overLimit() ? 1 : 0)
+          << '\n';
+      continue;
+    }
+    if (format == OutputFormat::Json) out << (i == 0 ? "\n" : ",\n");
+    out << "{\"category\":" << jsonString(s.budget.categoryId.view())
+        << ",\"period\":\"" << period << "\",\"key\":"
+        << jsonString(s.periodKey)
+        << ",\"limit\":" << formatAmount(s.budget.limit)
+        << ",\"spent\":" << formatAmount(s.spent)
+        << ",\"remaining\":" << formatAmount(s.remaining())
+        << ",\"over_limit\":" << (s.overLimit() ? "true" : "false") << '}';
+    if (format == OutputFormat::JsonLines) out << '\n';
+  }
+  if (format == OutputFormat::Json) out << "\n]\n";
+}
+
+void ReportWriter::writeTemplates(
+    std::ostream& out, const std::vector<RecurringTemplate>& templates,
+    OutputFormat format) {
+  const char* periods[] = {"day", "month", "year"};
+  if (format == OutputFormat::Csv) {
+    out << "id,amount,category,type,every,next,remarks\n";
+  }
+  if (format == OutputFormat::Json) out << '[';
+  for (size_t i = 0; i < templates.size(); ++i) {
+    const RecurringTemplate& t = templates[i];
+    const char* type = t.type == TransactionType::Income ? "income" : "expense";
+    const char* every = periods[static_cast<int>(t.every)];
+    if (format == OutputFormat::Csv) {
+      out << csvField(t.id.view()) << ',' << formatAmount(t.amount) << ','
+          << csvField(t.categoryId.view()) << ',' << type << ',' << every
+          << ',' << t.next << ',' << csvField(t.remarks) << '\n';
+      continue;
+    }
+    if (format == OutputFormat::Json) out << (i == 0 ? "\n" : ",\n");
+    out << "{\"id\":" << jsonString(t.id.view())
+        << ",\"amount\":" << formatAmount(t.amount)
+        << ",\"category\":" << jsonString(t.categoryId.view())
+        << ",\"type\":\"" << type << "\",\"every\":\"" << every
+        << "\",\"next\":" << jsonString(t.next)
+        << ",\"remarks\":" << jsonString(t.remarks) << '}';
+    if (format == OutputFormat::JsonLines) out << '\n';
+  }
+  if (format == OutputFormat::Json) out << "\n]\n";
+}
+
+std::unordered_set<std::string> DirtyTracker::months;
+std::string DirtyTracker::last;
+bool DirtyTracker::all = false;
+bool DirtyTracker::paused = false;
+
+std::vector<std::unique_ptr<char[]>> RemarkArena::blocks;
+size_t RemarkArena::used = 0;
+size_t RemarkArena::blockSize = 0;
+size_t RemarkArena::allocated = 0;
+
+std::vector<Category> Category::categories;
+std::vector<Transaction> Transaction::repository;
+std::vector<uint64_t> Transaction::deadBits;
+size_t Transaction::deadRows = 0;
+std::unordered_map<LedgerId, size_t> Transaction::rowIndex;
+bool Transaction::rowIndexValid = false;
+
+const char IdAllocator::PREFIX[IdAllocator::KindCount] = {'T', 'c'};
+const int64_t IdAllocator::FIRST[IdAllocator::KindCount] = {1000, 100};
+std::atomic<int64_t> IdAllocator::counters[IdAllocator::KindCount] = {
+    {1000}, {100}};
+
+const char DataPersistence::DB_FILE[] = "bookkeeping.db";
+
+// 测试时使用的临时文件路径（若为空则按原行为）
+std::string DataPersistence::testFilePath = "";
+
+StorageLayout DataPersistence::storageLayout = StorageLayout::Single;
+bool DataPersistence::compression = false;
+std::map<std::string, DataPersistence::Partition> DataPersistence::partitions;
+std::vector<std::string> DataPersistence::obsoleteFiles;
+
+bool DataPersistence::saveAll() {
+  METRICS_SCOPE(m, SaveAll);
+#ifdef UNIT_TEST
+  // 在单元测试模式下，若未设置测试文件路径则跳过实际写入
+  if (testFilePath.empty()) return true;
+#endif
+  size_t bytes = 0;
+  // 分区布局可能要先载入冷分区；清除脏标记也须与写出在同一把写锁下，
+  // 否则其间的修改会丢掉标记，下次保存时漏写该分区
+  LedgerLock::WriteGuard guard;
+  bool ok = storageLayout == StorageLayout::Single ? saveSingle(bytes)
+                                                   : savePartitioned(bytes);
+  if (ok) {
+    for (size_t i = 0; i < obsoleteFiles.size(); ++i) {
+      const std::string& file = obsoleteFiles[i];
+      std::string key = file.substr(std::min(file.size(), dbPath().size() + 1));
+      if (partitions.count(key) == 0) std::remove(file.c_str());
+    }
+    obsoleteFiles.clear();
+    DirtyTracker::clear();
+  }
+  METRICS_ADD(m, scanned, Transaction::list().size());
+  METRICS_ADD(m, bytes, bytes);
+  return ok;
+}
+
+void DataPersistence::writeHeader(std::ostream& out) {
+  // 数据文件头：ID 分配器的高水位。旧版本程序读取时会忽略这一段
+  out << "[HEADER]\n"
+      << "next_transaction_id" << DELIMITER
+      << IdAllocator::highWater(IdAllocator::TransactionIds) << '\n'
+      << "next_category_id" << DELIMITER
+      << IdAllocator::highWater(IdAllocator::CategoryIds) << '\n';
+  if (storageLayout != StorageLayout::Single) {
+    out << "layout" << DELIMITER
+        << (storageLayout == StorageLayout::Yearly ? "year" : "month") << '\n';
+  }
+  if (compression) out << "compression" << DELIMITER << "block\n";
+
+  out << "[CATEGORIES]\n";
+  Category::forEachCategory([&out](const Category& c) {
+    out << c.getId() << DELIMITER << escapeString(c.getName()) << '\n';
+  });
+
+  // 预算与周期交易模板跟在分类之后，载入时引用的分类都已存在
+  const char* periods[] = {"day", "month", "year"};
+  std::streamsize precision =
+      out.precision(std::numeric_limits<double>::digits10);
+  std::vector<Budget> budgets = BudgetBook::budgets();
+  if (!budgets.empty()) out << "[BUDGETS]\n";
+  for (size_t i = 0; i < budgets.size(); ++i) {
+    out << budgets[i].categoryId << DELIMITER
+        << periods[static_cast<int>(budgets[i].period)] << DELIMITER
+        << budgets[i].limit << '\n';
+  }
+  std::vector<RecurringTemplate> templates = RecurringService::templates();
+  if (!templates.empty()) out << "[RECURRING]\n";
+  for (size_t i = 0; i < templates.size(); ++i) {
+    const RecurringTemplate& t = templates[i];
+    out << t.id << DELIMITER << t.amount << DELIMITER << t.categoryId
+        << DELIMITER << static_cast<int>(t.type) << DELIMITER
+        << periods[static_cast<int>(t.every)] << DELIMITER << t.next
+        << DELIMITER << t.day << DELIMITER << escapeString(t.remarks) << '\n';
+  }
+  out.precision(precision);
+}
+
+void DataPersistence::writeTransaction(std::ostream& out,
+                                       const Transaction& tx) {
+  out << tx.getId() << DELIMITER << tx.getAmount() << DELIMITER
+      << tx.getTime() << DELIMITER << tx.getCategoryId() << DELIMITER
+      << static_cast<int>(tx.getType()) << DELIMITER;
+  // 多数备注不含需转义的字符，直接写出，省去一次临时字符串
+  std::string_view remarks = tx.getRemarks();
+  if (remarks.find_first_of("|\n\\") == std::string::npos) {
+    out << remarks << '\n';
+  } else {
+    out << escapeString(remarks) << '\n';
+  }
+}
+
+void DataPersistence::writeTransactions(std::ostream& out,
+                                        const std::vector<size_t>* rows) {
+  const std::vector<Transaction>& txs = Transaction::list();
+  size_t count = rows != nullptr ? rows->size() : txs.size();
+  if (!compression) {
+    out << "[TRANSACTIONS]\n";
+    for (size_t i = 0; i < count; ++i) {
+      size_t row = rows != nullptr ? (*rows)[i] : i;
+      if (!Transaction::isDeleted(row)) writeTransaction(out, txs[row]);
+    }
+    return;
+  }
+  out << BlockCodec::SECTION << '\n';
+  BlockCodec::Writer writer(out);
+  for (size_t i = 0; i < count; ++i) {
+    size_t row = rows != nullptr ? (*rows)[i] : i;
+    if (!Transaction::isDeleted(row)) writer.add(txs[row]);
+  }
+  writer.finish();
+}
+
+bool DataPersistence::saveSingle(size_t& bytes) {
+  std::ofstream file(dbPath(), writeMode());
+  if (!file.is_open()) return false;
+  // 默认 6 位有效数字会截断大金额（如 1234567.5），这里保留 15 位
+  file.precision(std::numeric_limits<double>::digits10);
+  writeHeader(file);
+  writeTransactions(file, nullptr);
+  bytes = static_cast<size_t>(file.tellp());
+  file.close();
+  return true;
+}
+
+namespace {
+
+// 先写临时文件再改名，写到一半失败时原文件不受影响
+bool replaceFile(const std::string& tmp, const std::string& path) {
+#if defined(_WIN32) || defined(_WIN64)
+  std::remove(path.c_str());
+#endif
+  return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+}  // namespace
+
+bool DataPersistence::savePartitioned(size_t& bytes) {
+  const std::vector<Transaction>& txs = Transaction::list();
+  // 需要重写的分区及其行号。全部有改动时为已载入的分区和内存中各行
+  // 所属的分区；冷分区中没有内存中的行，保持原样
+  std::map<std::string, std::vector<size_t>> rowsOf;
+  if (DirtyTracker::allDirty()) {
+    for (auto it = partitions.begin(); it != partitions.end(); ++it) {
+      if (it->second.loaded) rowsOf[it->first];
+    }
+    for (size_t i = 0; i < txs.size(); ++i) {
+      if (!Transaction::isDeleted(i)) {
+        rowsOf[partitionKey(txs[i].getTime(), storageLayout)];
+      }
+    }
+  } else {
+    const std::unordered_set<std::string>& months =
+        DirtyTracker::dirtyMonths();
+    for (auto it = months.begin(); it != months.end(); ++it) {
+      rowsOf[partitionKey(*it, storageLayout)];
+    }
+  }
+  for (auto it = rowsOf.begin(); it != rowsOf.end(); ++it) {
+    auto p = partitions.find(it->first);
+    if (p != partitions.end() && !p->second.loaded &&
+        !loadPartition(it->first)) {
+      return false;
+    }
+  }
+
+  if (!rowsOf.empty()) {
+    for (size_t i = 0; i < txs.size(); ++i) {
+      if (Transaction::isDeleted(i)) continue;
+      auto it = rowsOf.find(partitionKey(txs[i].getTime(), storageLayout));
+      if (it != rowsOf.end()) it->second.push_back(i);
+    }
+  }
+  for (auto it = rowsOf.begin(); it != rowsOf.end(); ++it) {
+    const std::string path = partitionPath(it->first);
+    if (it->second.empty()) {
+      std::remove(path.c_str());
+      partitions.erase(it->first);
+      continue;
+    }
+    const std::string tmp = path + ".tmp";
+    std::ofstream file(tmp, writeMode());
+    if (!file.is_open()) return false;
+    file.precision(std::numeric_limits<double>::digits10);
+    writeTransactions(file, &it->second);
+    bytes += static_cast<size_t>(file.tellp());
+    file.close();
+    if (!file || !replaceFile(tmp, path)) return false;
+    partitions[it->first] = Partition{it->second.size(), true};
+  }
+
+  const std::string manifest = dbPath(), tmp = manifest + ".tmp";
+  std::ofstream file(tmp, std::ios::trunc);
+  if (!file.is_open()) return false;
+  writeHeader(file);
+  file << "[PARTITIONS]\n";
+  for (auto it = partitions.begin(); it != partitions.end(); ++it) {
+    file << it->first << DELIMITER << it->second.rows << '\n';
+  }
+  bytes += static_cast<size_t>(file.tellp());
+  file.close();
+  return file && replaceFile(tmp, manifest);
+}
+
+bool DataPersistence::loadAll() {
+  return loadManifest() && loadRange("", "");
+}
+
+bool DataPersistence::loadManifest() {
+  METRICS_SCOPE(m, LoadAll);
+  std::ifstream file(dbPath());
+  if (!file.is_open()) return false;
+
+  LedgerLock::WriteGuard guard;
+  // 仓库为空时没有未保存的改动，载入后与磁盘一致
+  if (Transaction::list().empty()) DirtyTracker::clear();
+  DirtyTracker::Pause pause;
+  std::vector<Transaction>& repo = Transaction::getRepository();
+  partitions.clear();
+  // 文件头中有 layout、compression 时改写
+  storageLayout = StorageLayout::Single;
+  compression = false;
+  std::string line, section;
+  while (std::getline(file, line)) {
+    METRICS_ADD(m, scanned, 1);
+    if (line.empty()) {
+      continue;
+    }
+    if (line == BlockCodec::SECTION) {
+      // 压缩块总在文件末尾
+      size_t loaded = 0;
+      bool ok = loadBlocks(dbPath(), file.tellg(), loaded);
+      METRICS_ADD(m, matched, loaded);
+      return ok;
+    }
+    if (line[0] == '[') {
+      section = line;
+      continue;
+    }
+    if (section == "[HEADER]") {
+      loadHeader(line);
+    } else if (section == "[CATEGORIES]") {
+      loadCategory(line);
+    } else if (section == "[BUDGETS]") {
+      loadBudget(line);
+    } else if (section == "[RECURRING]") {
+      loadRecurring(line);
+    } else if (section == "[TRANSACTIONS]") {
+      if (loadTransaction(repo, line)) METRICS_ADD(m, matched, 1);
+    } else if (section == "[PARTITIONS]") {
+      std::vector<std::string> parts = split(line, DELIMITER);
+      if (parts.size() >= 2) {
+        partitions[parts[0]] =
+            Partition{std::strtoull(parts[1].c_str(), nullptr, 10), false};
+      }
+    }
+  }
+  file.close();
+  return true;
+}
+
+bool DataPersistence::loadRange(const std::string& from,
+                                const std::string& to) {
+  std::vector<std::string> keys;
+  {
+    LedgerLock::ReadGuard guard;
+    for (auto it = partitions.begin(); it != partitions.end(); ++it) {
+      if (!it->second.loaded && overlaps(it->first, from, to)) {
+        keys.push_back(it->first);
+      }
+    }
+  }
+  if (keys.empty()) return true;
+  LedgerLock::WriteGuard guard;
+  bool ok = true;
+  for (size_t i = 0; i < keys.size(); ++i) {
+    auto it = partitions.find(keys[i]);
+    if (it != partitions.end() && !it->second.loaded) {
+      ok = loadPartition(keys[i]) && ok;
+    }
+  }
+  return ok;
+}
+
+bool DataPersistence::loadPartition(const std::string& key) {
+  METRICS_SCOPE(m, LoadAll);
+  std::ifstream file(partitionPath(key));
+  if (!file.is_open()) return false;
+  DirtyTracker::Pause pause;
+  std::vector<Transaction>& repo = Transaction::getRepository();
+  std::string line;
+  while (std::getline(file, line)) {
+    METRICS_ADD(m, scanned, 1);
+    if (line == BlockCodec::SECTION) {
+      size_t loaded = 0;
+      if (!loadBlocks(partitionPath(key), file.tellg(), loaded)) return false;
+      METRICS_ADD(m, matched, loaded);
+      break;
+    }
+    if (line.empty() || line[0] == '[') continue;
+    if (loadTransaction(repo, line)) METRICS_ADD(m, matched, 1);
+  }
+  partitions[key].loaded = true;
+  return true;
+}
+
+bool DataPersistence::loadBlocks(const std::string& path, std::streampos pos,
+                                 size_t& loaded) {
+  // 以二进制方式重新打开，文本方式下压缩数据中的字节可能被改写
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open() || !file.seekg(pos)) return false;
+  BlockCodec::Reader reader(file);
+  std::vector<Transaction> rows;
+  std::vector<Transaction>& repo = Transaction::getRepository();
+  while (reader.next(rows)) {
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (!Transaction::validateTransaction(rows[i])) continue;
+      IdAllocator::observe(IdAllocator::TransactionIds, rows[i].getId());
+      repo.push_back(std::move(rows[i]));
+      ++loaded;
+    }
+    rows.clear();
+  }
+  return reader.ok();
+}
+
+bool DataPersistence::overlaps(const std::string& key,
+                               const std::string& from,
+                               const std::string& to) {
+  if (key == "undated") return true;
+  size_t len = key.size();
+  if (!from.empty() && key < from.substr(0, len)) return false;
+  if (!to.empty() && key > to.substr(0, len)) return false;
+  return true;
+}
+
+void DataPersistence::setLayout(StorageLayout layout) {
+  LedgerLock::WriteGuard guard;
+  if (layout == storageLayout) return;
+  loadRange("", "");
+  for (auto it = partitions.begin(); it != partitions.end(); ++it) {
+    obsoleteFiles.push_back(partitionPath(it->first));
+  }
+  partitions.clear();
+  storageLayout = layout;
+  DirtyTracker::markAll();
+}
+
+void DataPersistence::setCompression(bool enabled) {
+  LedgerLock::WriteGuard guard;
+  if (enabled == compression) return;
+  loadRange("", "");
+  compression = enabled;
+  DirtyTracker::markAll();
+}
+
+size_t DataPersistence::loadedPartitionCount() {
+  LedgerLock::ReadGuard guard;
+  size_t count = 0;
+  for (auto it = partitions.begin(); it != partitions.end(); ++it) {
+    if (it->second.loaded) ++count;
+  }
+  return count;
+}
+
+std::string DataPersistence::partitionKey(std::string_view date,
+                                          StorageLayout layout) {
+  size_t len = layout == StorageLayout::Monthly ? 7 : 4;
+  bool valid = date.size() >= len;
+  for (size_t i = 0; i < len && valid; ++i) {
+    valid = i == 4 ? date[i] == '-' :
+                     std::isdigit(static_cast<unsigned char>(date[i])) != 0;
+  }
+  return valid ? std::string(date.substr(0, len)) : std::string("undated");
+}
+
+// 未知的键忽略，供以后扩展文件头
+void DataPersistence::loadHeader(const std::string& line) {
+  std::vector<std::string> parts = split(line, DELIMITER);
+  if (parts.size() < 2) return;
+  if (parts[0] == "layout") {
+    if (parts[1] == "year") storageLayout = StorageLayout::Yearly;
+    if (parts[1] == "month") storageLayout = StorageLayout::Monthly;
+    return;
+  }
+  if (parts[0] == "compression") {
+    compression = parts[1] == "block";
+    return;
+  }
+  int64_t next = 0;
+  const char* end = parts[1].data() + parts[1].size();
+  if (std::from_chars(parts[1].data(), end, next).ptr != end) return;
+  if (parts[0] == "next_transaction_id") {
+    IdAllocator::raise(IdAllocator::TransactionIds, next);
+  } else if (parts[0] == "next_category_id") {
+    IdAllocator::raise(IdAllocator::CategoryIds, next);
+  }
+}
+
+// 解析出的字段直接移动进仓库中的新元素，每个字段只分配一次
+void DataPersistence::loadCategory(const std::string& line) {
+  std::vector<std::string> parts = split(line, DELIMITER);
+  if (parts.size() >= 2) {
+    Category::emplaceCategory(std::move(parts[0]),
+                              unescapeString(std::move(parts[1])));
+  }
+}
+
+namespace {
+
+bool parsePeriod(const std::string& name, TimeGroup& period) {
+  const char* names[] = {"day", "month", "year"};
+  for (int i = 0; i < 3; ++i) {
+    if (name != names[i]) continue;
+    period = static_cast<TimeGroup>(i);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+// 分类不存在或字段不合法的行忽略
+void DataPersistence::loadBudget(const std::string& line) {
+  std::vector<std::string> parts = split(line, DELIMITER);
+  Budget budget{LedgerId(), TimeGroup::Monthly, 0.0};
+  if (parts.size() >= 3 && parsePeriod(parts[1], budget.period)) {
+    budget.categoryId = parts[0];
+    budget.limit = std::strtod(parts[2].c_str(), nullptr);
+    BudgetBook::setBudget(budget);
+  }
+}
+
+void DataPersistence::loadRecurring(const std::string& line) {
+  std::vector<std::string> parts = split(line, DELIMITER);
+  RecurringTemplate tmpl;
+  if (parts.size() >= 8 && parsePeriod(parts[4], tmpl.every)) {
+    tmpl.id = parts[0];
+    tmpl.amount = std::strtod(parts[1].c_str(), nullptr);
+    tmpl.categoryId = parts[2];
+    tmpl.type = parts[3] == "0" ? TransactionType::Income
+                                : TransactionType::Expense;
+    tmpl.next = std::move(parts[5]);
+    tmpl.day = std::atoi(parts[6].c_str());
+    tmpl.remarks = unescapeString(std::move(parts[7]));
+    RecurringService::addTemplate(std::move(tmpl));
+  }
+}
+
+// 各字段直接取自行内的视图，不逐字段分配；校验通过后备注才反转义存入
+// RemarkArena，被拒绝的行不在其中留下文本
+bool DataPersistence::loadTransaction(std::vector<Transaction>& repo,
+                                      const std::string& line) {
+  std::string_view rest = line, fields[6];
+  size_t count = 0;
+  while (count < 6 && rest.data() != nullptr) {
+    fields[count++] = nextField(rest, DELIMITER);
+  }
+  if (count != 6) return false;
+  // 加载不做 ID 查重（文件由 saveAll 写出），不必经过 emplaceTransaction
+  Transaction tx(fields[0], std::stod(std::string(fields[1])),
+                 std::string(fields[2]), fields[3],
+                 static_cast<TransactionType>(
+                     std::stoi(std::string(fields[4]))),
+                 Remarks());
+  if (!Transaction::validateTransaction(tx)) return false;
+  tx.setRemarks(Remarks::pooled(RemarkArena::store(fields[5])));
+  // 没有文件头的旧数据文件靠这里恢复高水位
+  IdAllocator::observe(IdAllocator::TransactionIds, tx.getId());
+  repo.push_back(std::move(tx));
+  return true;
+}
+
+const char BlockCodec::SECTION[] = "[BLOCKS]";
+
+namespace {
+
+// 每行编码的第一个字节
+enum BlockFlags : uint8_t {
+  ID_LITERAL = 1,     // ID 原样存放，否则为与上一行序号之差
+  DATE_LITERAL = 2,   // 日期原样存放，否则为与上一行相差的天数
+  AMOUNT_RAW = 4,     // 金额存 8 字节的 double，否则为分
+  INCOME = 8,
+  TYPE_OTHER = 16,    // 类型既非收入也非支出，行末另存其取值
+  NEW_CATEGORY = 32,  // 分类不在块内字典中，原样存放并加入字典
+  NEW_REMARKS = 64,   // 备注同上
+};
+
+void putVarint(std::string& out, uint64_t value) {
+  while (value >= 0x80) {
+    out += static_cast<char>(value | 0x80);
+    value >>= 7;
+  }
+  out += static_cast<char>(value);
+}
+
+bool getVarint(std::string_view& in, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && !in.empty(); shift += 7) {
+    uint8_t byte = static_cast<uint8_t>(in[0]);
+    in.remove_prefix(1);
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (byte < 0x80) return true;
+  }
+  return false;
+}
+
+bool readVarint(std::istream& in, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    int byte = in.get();
+    if (byte == std::char_traits<char>::eof()) return false;
+    value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+    if (byte < 0x80) return true;
+  }
+  return false;
+}
+
+uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^
+         static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void putBytes(std::string& out, std::string_view bytes) {
+  putVarint(out, bytes.size());
+  out.append(bytes.data(), bytes.size());
+}
+
+bool getBytes(std::string_view& in, std::string_view& bytes) {
+  uint64_t size;
+  if (!getVarint(in, size) || size > in.size()) return false;
+  bytes = in.substr(0, size);
+  in.remove_prefix(size);
+  return true;
+}
+
+uint32_t fnv1a(std::string_view data) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < data.size(); ++i) {
+    hash = (hash ^ static_cast<uint8_t>(data[i])) * 16777619u;
+  }
+  return hash;
+}
+
+// "前缀+序号" 形式的 ID（如 T1024），序号不含前导零
+bool splitId(std::string_view id, std::string_view& prefix, int64_t& number) {
+  size_t i = id.size();
+  while (i > 0 && std::isdigit(static_cast<unsigned char>(id[i - 1]))) --i;
+  size_t digits = id.size() - i;
+  if (digits == 0 || digits > 18 || (digits > 1 && id[i] == '0')) return false;
+  prefix = id.substr(0, i);
+  number = 0;
+  for (; i < id.size(); ++i) number = number * 10 + (id[i] - '0');
+  return true;
+}
+
+// 公历日期与 1970-01-01 起的天数互相换算
+constexpr int64_t daysFromCivil(int64_t y, unsigned m, unsigned d) {
+  y -= m <= 2;
+  const int64_t era = (y >= 0 ? y : y - 399) / 400;
+  const unsigned yoe = static_cast<unsigned>(y - era * 400);
+  const unsigned doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+  const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+void civilFromDays(int64_t z, int64_t& y, unsigned& m, unsigned& d) {
+  z += 719468;
+  const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+  const unsigned doe = static_cast<unsigned>(z - era * 146097);
+  const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  const unsigned mp = (5 * doy + 2) / 153;
+  d = doy - (153 * mp + 2) / 5 + 1;
+  m = mp < 10 ? mp + 3 : mp - 9;
+  y = static_cast<int64_t>(yoe) + era * 400 + (m <= 2);
+}
+
+int digitsAt(std::string_view text, size_t pos, size_t count) {
+  int value = 0;
+  for (size_t i = 0; i < count; ++i) value = value * 10 + (text[pos + i] - '0');
+  return value;
+}
+
+// 天数格式化为 "YYYY-MM-DD"；年份超出四位数时返回 false
+bool formatDate(int64_t days, char (&text)[11]) {
+  int64_t y;
+  unsigned m, d;
+  civilFromDays(days, y, m, d);
+  if (y < 0 || y > 9999) return false;
+  std::memcpy(text, "0000-00-00", sizeof(text));
+  for (int i = 3; i >= 0; --i, y /= 10) text[i] += y % 10;
+  text[5] += m / 10;
+  text[6] += m % 10;
+  text[8] += d / 10;
+  text[9] += d % 10;
+  return true;
+}
+
+// 字节压缩的参数，与 LZ4 相同：最短匹配 4 字节，偏移 2 字节，最后 5 字节
+// 总是字面量，距末尾 12 字节以内不再开始匹配
+constexpr size_t MIN_MATCH = 4;
+constexpr size_t LAST_LITERALS = 5;
+constexpr size_t MATCH_LIMIT = 12;
+constexpr size_t MAX_OFFSET = 65535;
+constexpr int HASH_BITS = 14;
+
+uint32_t read32(const unsigned char* p) {
+  uint32_t value;
+  std::memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+void putLength(std::string& out, size_t length) {
+  for (; length >= 255; length -= 255) out += static_cast<char>(255);
+  out += static_cast<char>(length);
+}
+
+bool getLength(const unsigned char*& ip, const unsigned char* end,
+               size_t& length) {
+  unsigned char byte;
+  do {
+    if (ip == end) return false;
+    byte = *ip++;
+    length += byte;
+  } while (byte == 255);
+  return true;
+}
+
+// 写出一个序列：字面量，以及紧随其后的匹配（matchLength 为 0 表示没有）
+void putSequence(std::string& out, const unsigned char* literals,
+                 size_t literalLength, size_t offset, size_t matchLength) {
+  size_t extra = matchLength != 0 ? matchLength - MIN_MATCH : 0;
+  out += static_cast<char>((std::min<size_t>(literalLength, 15) << 4) |
+                           std::min<size_t>(extra, 15));
+  if (literalLength >= 15) putLength(out, literalLength - 15);
+  out.append(reinterpret_cast<const char*>(literals), literalLength);
+  if (matchLength == 0) return;
+  out += static_cast<char>(offset & 0xFF);
+  out += static_cast<char>(offset >> 8);
+  if (extra >= 15) putLength(out, extra - 15);
+}
+
+}  // namespace
+
+void BlockCodec::Writer::add(const Transaction& tx) {
+  size_t flagsAt = raw.size();
+  raw += '\0';
+  uint8_t flags = 0;
+
+  std::string_view id = tx.getId().view(), prefix;
+  int64_t number = 0;
+  bool numbered = splitId(id, prefix, number);
+  if (numbered && prefix == prevPrefix) {
+    putVarint(raw, zigzag(number - prevNumber));
+  } else {
+    flags |= ID_LITERAL;
+    putBytes(raw, id);
+  }
+  if (numbered) {
+    prevPrefix.assign(prefix.data(), prefix.size());
+    prevNumber = number;
+  }
+
+  const std::string& date = tx.getTime();
+  if (isValidDate(date)) {
+    int64_t day = daysFromCivil(digitsAt(date, 0, 4), digitsAt(date, 5, 2),
+                                digitsAt(date, 8, 2));
+    putVarint(raw, zigzag(day - prevDay));
+    prevDay = day;
+  } else {
+    flags |= DATE_LITERAL;
+    putBytes(raw, date);
+  }
+
+  // 除以 100 能还原为同一个 double 的金额按分存放
+  double amount = tx.getAmount();
+  if (amount >= 0 && amount < 1e15 &&
+      static_cast<double>(std::llround(amount * 100)) / 100 == amount) {
+    putVarint(raw, static_cast<uint64_t>(std::llround(amount * 100)));
+  } else {
+    flags |= AMOUNT_RAW;
+    uint64_t bits;
+    std::memcpy(&bits, &amount, sizeof(bits));
+    for (int i = 0; i < 8; ++i) raw += static_cast<char>(bits >> (8 * i));
+  }
+
+  if (tx.getType() == TransactionType::Income) {
+    flags |= INCOME;
+  } else if (tx.getType() != TransactionType::Expense) {
+    flags |= TYPE_OTHER;
+  }
+
+  auto category = categories.find(tx.getCategoryId());
+  if (category != categories.end()) {
+    putVarint(raw, category->second);
+  } else {
+    flags |= NEW_CATEGORY;
+    putBytes(raw, tx.getCategoryId().view());
+    categories.emplace(tx.getCategoryId(), categories.size());
+  }
+
+  // 字典条目存放在 raw 中，以偏移引用；哈希冲突的备注按新条目存放
+  std::string_view text = tx.getRemarks();
+  uint64_t hash = std::hash<std::string_view>()(text);
+  auto entry = remarkIndex.find(hash);
+  if (entry != remarkIndex.end() &&
+      std::string_view(raw).substr(remarks[entry->second].first,
+                                   remarks[entry->second].second) == text) {
+    putVarint(raw, entry->second);
+  } else {
+    flags |= NEW_REMARKS;
+    if (entry == remarkIndex.end()) remarkIndex.emplace(hash, remarks.size());
+    putVarint(raw, text.size());
+    remarks.emplace_back(raw.size(), text.size());
+    raw.append(text.data(), text.size());
+  }
+
+  if (flags & TYPE_OTHER) {
+    putVarint(raw, zigzag(static_cast<int64_t>(tx.getType())));
+  }
+  raw[flagsAt] = static_cast<char>(flags);
+  if (++rows == BLOCK_ROWS) flush();
+}
+
+void BlockCodec::Writer::flush() {
+  if (rows == 0) return;
+  std::string packed = compress(raw);
+  std::string header;
+  putVarint(header, rows);
+  putVarint(header, raw.size());
+  putVarint(header, packed.size());
+  uint32_t sum = fnv1a(raw);
+  for (int i = 0; i < 4; ++i) header += static_cast<char>(sum >> (8 * i));
+  out.write(header.data(), static_cast<std::streamsize>(header.size()));
+  out.write(packed.data(), static_cast<std::streamsize>(packed.size()));
+
+  raw.clear();
+  rows = 0;
+  prevPrefix.clear();
+  prevNumber = 0;
+  prevDay = 0;
+  categories.clear();
+  remarkIndex.clear();
+  remarks.clear();
+}
+
+void BlockCodec::Writer::finish() {
+  flush();
+  out.put('\0');
+}
+
+bool BlockCodec::Reader::next(std::vector<Transaction>& rows) {
+  if (!good) return false;
+  uint64_t count = 0, rawSize = 0, packedSize = 0;
+  good = readVarint(in, count);
+  if (!good || count == 0) return false;
+  char sum[4] = {};
+  // 长度明显不合理时按损坏处理，不按它分配内存
+  good = readVarint(in, rawSize) && readVarint(in, packedSize) &&
+         rawSize < (1u << 31) && packedSize < (1u << 31) &&
+         in.read(sum, 4);
+  if (good) {
+    packed.resize(packedSize);
+    good = in.read(&packed[0], static_cast<std::streamsize>(packedSize)) &&
+           decompress(packed, rawSize, raw);
+  }
+  uint32_t expected = 0;
+  for (int i = 0; i < 4; ++i) {
+    expected |= static_cast<uint32_t>(static_cast<uint8_t>(sum[i])) << (8 * i);
+  }
+  if (!good || fnv1a(raw) != expected) {
+    good = false;
+    return false;
+  }
+
+  size_t start = rows.size();
+  std::string_view data = raw;
+  std::string prefix;
+  int64_t number = 0, day = 0;
+  std::vector<LedgerId> categories;
+  std::vector<std::string_view> remarks;
+  for (uint64_t r = 0; r < count && good; ++r) {
+    if (data.empty()) {
+      good = false;
+      break;
+    }
+    uint8_t flags = static_cast<uint8_t>(data[0]);
+    data.remove_prefix(1);
+    uint64_t value = 0;
+    std::string_view bytes;
+
+    LedgerId id;
+    if (flags & ID_LITERAL) {
+      good = getBytes(data, bytes);
+      id = LedgerId(bytes);
+      std::string_view idPrefix;
+      if (good && splitId(bytes, idPrefix, number)) {
+        prefix.assign(idPrefix.data(), idPrefix.size());
+      }
+    } else {
+      good = getVarint(data, value);
+      number += unzigzag(value);
+      char text[48];
+      std::memcpy(text, prefix.data(), std::min<size_t>(prefix.size(), 20));
+      char* end = std::to_chars(text + std::min<size_t>(prefix.size(), 20),
+                                text + sizeof(text), number).ptr;
+      id = LedgerId(std::string_view(text, static_cast<size_t>(end - text)));
+    }
+
+    std::string date;
+    if (flags & DATE_LITERAL) {
+      good = good && getBytes(data, bytes);
+      date.assign(bytes.data(), bytes.size());
+    } else if (good && getVarint(data, value)) {
+      day += unzigzag(value);
+      char text[11];
+      good = formatDate(day, text);
+      date.assign(text, 10);
+    } else {
+      good = false;
+    }
+
+    double amount = 0;
+    if (flags & AMOUNT_RAW) {
+      good = good && data.size() >= 8;
+      if (good) {
+        uint64_t bits = 0;
+        for (int i = 0; i < 8; ++i) {
+          bits |= static_cast<uint64_t>(static_cast<uint8_t>(data[i]))
+                  << (8 * i);
+        }
+        std::memcpy(&amount, &bits, sizeof(amount));
+        data.remove_prefix(8);
+      }
+    } else {
+      good = good && getVarint(data, value);
+      amount = static_cast<double>(value) / 100;
+    }
+
+    if (flags & NEW_CATEGORY) {
+      good = good && getBytes(data, bytes);
+      categories.emplace_back(bytes);
+    } else {
+      good = good && getVarint(data, value) && value < categories.size();
+    }
+    LedgerId category = good ? (flags & NEW_CATEGORY ? categories.back() :
+                                                       categories[value])
+                             : LedgerId();
+
+    // 同一块内重复的备注只存入 RemarkArena 一次，各行共用
+    if (flags & NEW_REMARKS) {
+      good = good && getBytes(data, bytes);
+      remarks.push_back(good ? RemarkArena::copy(bytes) : std::string_view());
+    } else {
+      good = good && getVarint(data, value) && value < remarks.size();
+    }
+    std::string_view text =
+        good ? (flags & NEW_REMARKS ? remarks.back() : remarks[value])
+             : std::string_view();
+
+    TransactionType type = flags & INCOME ? TransactionType::Income
+                                          : TransactionType::Expense;
+    if (flags & TYPE_OTHER) {
+      good = good && getVarint(data, value);
+      type = static_cast<TransactionType>(unzigzag(value));
+    }
+    if (good) {
+      rows.emplace_back(id, amount, std::move(date), category, type,
+                        Remarks::pooled(text));
+    }
+  }
+  if (!good || !data.empty()) {
+    rows.resize(start);
+    good = false;
+    return false;
+  }
+  return true;
+}
+
+std::string BlockCodec::compress(std::string_view input) {
+  const unsigned char* src =
+      reinterpret_cast<const unsigned char*>(input.data());
+  const size_t size = input.size();
+  std::string out;
+  out.reserve(size + size / 255 + 16);
+  size_t anchor = 0;
+  if (size > MATCH_LIMIT) {
+    // 以 4 字节序列的哈希找最近一次出现的位置（存位置 + 1，0 表示没有）
+    std::vector<uint32_t> table(size_t(1) << HASH_BITS, 0);
+    const size_t limit = size - MATCH_LIMIT;
+    size_t i = 0;
+    while (i < limit) {
+      uint32_t sequence = read32(src + i);
+      uint32_t hash = (sequence * 2654435761u) >> (32 - HASH_BITS);
+      size_t candidate = table[hash];
+      table[hash] = static_cast<uint32_t>(i + 1);
+      if (candidate == 0 || i + 1 - candidate > MAX_OFFSET ||
+          read32(src + candidate - 1) != sequence) {
+        ++i;
+        continue;
+      }
+      size_t match = candidate - 1, length = MIN_MATCH;
+      while (i + length < size - LAST_LITERALS &&
+             src[match + length] == src[i + length]) {
+        ++length;
+      }
+      putSequence(out, src + anchor, i - anchor, i - match, length);
+      i += length;
+      anchor = i;
+    }
+  }
+  putSequence(out, src + anchor, size - anchor, 0, 0);
+  return out;
+}
+
+bool BlockCodec::decompress(std::string_view input, size_t size,
+                            std::string& output) {
+  output.resize(size);
+  const unsigned char* ip =
+      reinterpret_cast<const unsigned char*>(input.data());
+  const unsigned char* end = ip + input.size();
+  size_t op = 0;
+  while (ip < end) {
+    unsigned char token = *ip++;
+    size_t literals = token >> 4;
+    if (literals == 15 && !getLength(ip, end, literals)) return false;
+    if (literals > static_cast<size_t>(end - ip) || literals > size - op) {
+      return false;
+    }
+    std::memcpy(&output[op], ip, literals);
+    ip += literals;
+    op += literals;
+    if (ip == end) break;  // 最后一个序列只有字面量
+
+    if (end - ip < 2) return false;
+    size_t offset = ip[0] | (static_cast<size_t>(ip[1]) << 8);
+    ip += 2;
+    size_t length = token & 15;
+    if (length == 15 && !getLength(ip, end, length)) return false;
+    length += MIN_MATCH;
+    if (offset == 0 || offset > op || length > size - op) return false;
+    // 匹配可能与输出重叠（offset < length），逐字节复制
+    for (size_t k = 0; k < length; ++k) {
+      output[op + k] = output[op - offset + k];
+    }
+    op += length;
+  }
+  return op == size;
+}
+
+std::vector<double> BalanceIndex::amounts;
+std::vector<int64_t> BalanceIndex::counts;
+std::map<std::string, std::pair<double, int64_t>> BalanceIndex::undated;
+std::atomic<bool> BalanceIndex::valid(false);
+std::mutex BalanceIndex::buildMutex;
+
+namespace {
+
+// 树状数组下标 1 对应的日期，以及覆盖的天数
+constexpr int64_t kFirstDay = daysFromCivil(BalanceIndex::FIRST_YEAR, 1, 1);
+constexpr size_t kDayCount = static_cast<size_t>(
+    daysFromCivil(BalanceIndex::LAST_YEAR, 12, 31) - kFirstDay + 1);
+
+// 合法日期在树状数组中的下标，不合法时返回 0
+size_t dayIndex(std::string_view date) {
+  if (!isValidDate(std::string(date))) return 0;
+  return static_cast<size_t>(daysFromCivil(digitsAt(date, 0, 4),
+                                           digitsAt(date, 5, 2),
+                                           digitsAt(date, 8, 2)) -
+                             kFirstDay + 1);
+}
+
+size_t lowBit(size_t i) { return i & (~i + 1); }
+
+}  // namespace
+
+double BalanceIndex::balanceAt(const std::string& date) {
+  METRICS_SCOPE(m, BalanceQuery);
+  LedgerLock::ReadGuard guard;
+  METRICS_ADD(m, scanned, ensureBuilt());
+  if (date.empty()) return prefix(kDayCount) + undatedUpTo("", false, true);
+  return sumUpTo(date, true);
+}
+
+double BalanceIndex::netFlow(const std::string& from, const std::string& to) {
+  METRICS_SCOPE(m, BalanceQuery);
+  LedgerLock::ReadGuard guard;
+  METRICS_ADD(m, scanned, ensureBuilt());
+  double upper = to.empty() ? prefix(kDayCount) + undatedUpTo("", false, true)
+                            : sumUpTo(to, true);
+  return from.empty() ? upper : upper - sumUpTo(from, false);
+}
+
+std::vector<BalancePoint> BalanceIndex::series(const std::string& from,
+                                               const std::string& to,
+                                               TimeGroup group) {
+  METRICS_SCOPE(m, BalanceQuery);
+  LedgerLock::ReadGuard guard;
+  METRICS_ADD(m, scanned, ensureBuilt());
+  std::vector<BalancePoint> points;
+  int64_t total = countPrefix(kDayCount);
+  size_t first = from.empty() ? (total > 0 ? dayOfRank(1) : 0)
+                              : dayIndex(from);
+  size_t last = to.empty() ? (total > 0 ? dayOfRank(total) : 0)
+                           : dayIndex(to);
+  if (first == 0 || last == 0) return points;
+
+  // 逐个周期取周期末（不超过 last）的余额
+  for (size_t day = first; day <= last;) {
+    int64_t y;
+    unsigned mo, d;
+    civilFromDays(kFirstDay + static_cast<int64_t>(day) - 1, y, mo, d);
+    int64_t end = kFirstDay + static_cast<int64_t>(day) - 1;
+    if (group == TimeGroup::Monthly) {
+      end = daysFromCivil(mo == 12 ? y + 1 : y, mo == 12 ? 1 : mo + 1, 1) - 1;
+    } else if (group == TimeGroup::Yearly) {
+      end = daysFromCivil(y + 1, 1, 1) - 1;
+    }
+    size_t endDay = std::min(last, static_cast<size_t>(end - kFirstDay + 1));
+    char text[11];
+    formatDate(kFirstDay + static_cast<int64_t>(endDay) - 1, text);
+    std::string_view date(text, 10);
+    size_t keyLength = group == TimeGroup::Monthly ? 7 :
+                       group == TimeGroup::Yearly ? 4 : 10;
+    points.push_back({std::string(date.substr(0, keyLength)),
+                      prefix(endDay) + undatedUpTo(date, true, false)});
+    day = endDay + 1;
+  }
+  METRICS_ADD(m, matched, points.size());
+  return points;
+}
+
+size_t BalanceIndex::ensureBuilt() {
+  if (valid.load(std::memory_order_acquire)) return 0;
+  std::lock_guard<std::mutex> lock(buildMutex);
+  if (valid.load(std::memory_order_relaxed)) return 0;
+  amounts.assign(kDayCount + 1, 0.0);
+  counts.assign(kDayCount + 1, 0);
+  undated.clear();
+  const std::vector<Transaction>& txs = Transaction::list();
+  for (size_t i = 0; i < txs.size(); ++i) {
+    if (Transaction::isDeleted(i)) continue;
+    size_t day = dayIndex(txs[i].getTime());
+    if (day == 0) {
+      std::pair<double, int64_t>& entry = undated[txs[i].getTime()];
+      entry.first += txs[i].signedAmount();
+      ++entry.second;
+    } else {
+      amounts[day] += txs[i].signedAmount();
+      ++counts[day];
+    }
+  }
+  // 每一项累加到其父节点，O(天数) 建成树状数组
+  for (size_t i = 1; i < amounts.size(); ++i) {
+    size_t parent = i + lowBit(i);
+    if (parent < amounts.size()) {
+      amounts[parent] += amounts[i];
+      counts[parent] += counts[i];
+    }
+  }
+  valid.store(true, std::memory_order_release);
+  return txs.size();
+}
+
+void BalanceIndex::apply(std::string_view date, double delta, int64_t count) {
+  size_t day = dayIndex(date);
+  if (day == 0) {
+    auto it = undated.emplace(std::string(date),
+                              std::pair<double, int64_t>(0.0, 0)).first;
+    it->second.first += delta;
+    it->second.second += count;
+    if (it->second.second == 0) undated.erase(it);
+    return;
+  }
+  for (; day < amounts.size(); day += lowBit(day)) {
+    amounts[day] += delta;
+    counts[day] += count;
+  }
+}
+
+size_t BalanceIndex::daysUpTo(std::string_view date, bool inclusive) {
+  size_t day = dayIndex(date);
+  if (day != 0) return inclusive ? day : day - 1;
+  // 不是合法日期（如 "2024-02"）：二分查找满足条件的最后一天
+  size_t low = 0, high = kDayCount;
+  while (low < high) {
+    size_t mid = (low + high + 1) / 2;
+    char text[11];
+    formatDate(kFirstDay + static_cast<int64_t>(mid) - 1, text);
+    std::string_view current(text, 10);
+    if (inclusive ? current <= date : current < date) {
+      low = mid;
+    } else {
+      high = mid - 1;
+    }
+  }
+  return low;
+}
+
+double BalanceIndex::sumUpTo(std::string_view date, bool inclusive) {
+  return prefix(daysUpTo(date, inclusive)) +
+         undatedUpTo(date, inclusive, false);
+}
+
+double BalanceIndex::undatedUpTo(std::string_view date, bool inclusive,
+                                 bool all) {
+  double sum = 0.0;
+  for (auto it = undated.begin(); it != undated.end(); ++it) {
+    if (!all && (inclusive ? it->first > date : it->first >= date)) break;
+    sum += it->second.first;
+  }
+  return sum;
+}
+
+double BalanceIndex::prefix(size_t days) {
+  double sum = 0.0;
+  for (size_t i = days; i > 0; i -= lowBit(i)) sum += amounts[i];
+  return sum;
+}
+
+int64_t BalanceIndex::countPrefix(size_t days) {
+  int64_t sum = 0;
+  for (size_t i = days; i > 0; i -= lowBit(i)) sum += counts[i];
+  return sum;
+}
+
+size_t BalanceIndex::dayOfRank(int64_t rank) {
+  size_t pos = 0, step = 1;
+  while (step * 2 < counts.size()) step *= 2;
+  for (; step > 0; step /= 2) {
+    if (pos + step < counts.size() && counts[pos + step] < rank) {
+      pos += step;
+      rank -= counts[pos];
+    }
+  }
+  return pos + 1;
+}
+
+std::vector<BudgetBook::Entry> BudgetBook::entries;
+std::atomic<bool> BudgetBook::valid(false);
+std::mutex BudgetBook::buildMutex;
+
+bool BudgetBook::setBudget(const Budget& budget) {
+  if (!(budget.limit > 0.0) ||
+      budget.limit == std::numeric_limits<double>::infinity()) {
+    return false;
+  }
+  LedgerLock::WriteGuard guard;
+  if (!Category::categoryExists(budget.categoryId)) return false;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (entries[i].budget.categoryId == budget.categoryId &&
+        entries[i].budget.period == budget.period) {
+      entries[i].budget.limit = budget.limit;  // 消耗不变，不必重建
+      return true;
+    }
+  }
+  entries.push_back(Entry{budget, {}});
+  invalidate();
+  return true;
+}
+
+bool BudgetBook::removeBudget(const LedgerId& categoryId, TimeGroup period) {
+  LedgerLock::WriteGuard guard;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (entries[i].budget.categoryId == categoryId &&
+        entries[i].budget.period == period) {
+      entries.erase(entries.begin() + static_cast<std::ptrdiff_t>(i));
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<Budget> BudgetBook::budgets() {
+  LedgerLock::ReadGuard guard;
+  std::vector<Budget> result;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    result.push_back(entries[i].budget);
+  }
+  return result;
+}
+
+void BudgetBook::clear() {
+  LedgerLock::WriteGuard guard;
+  entries.clear();
+  invalidate();
+}
+
+std::vector<BudgetStatus> BudgetBook::status(const std::string& date) {
+  METRICS_SCOPE(m, BudgetQuery);
+  LedgerLock::ReadGuard guard;
+  METRICS_ADD(m, scanned, ensureBuilt());
+  std::vector<BudgetStatus> result;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    result.push_back(statusOf(entries[i], date));
+  }
+  METRICS_ADD(m, matched, result.size());
+  return result;
+}
+
+std::vector<BudgetStatus> BudgetBook::alerts(const std::string& date) {
+  METRICS_SCOPE(m, BudgetQuery);
+  LedgerLock::ReadGuard guard;
+  METRICS_ADD(m, scanned, ensureBuilt());
+  std::vector<BudgetStatus> result;
+  for (size_t i = 0; i < entries.size(); ++i) {
+    BudgetStatus status = statusOf(entries[i], date);
+    if (status.overLimit()) result.push_back(std::move(status));
+  }
+  METRICS_ADD(m, matched, result.size());
+  return result;
+}
+
+size_t BudgetBook::ensureBuilt() {
+  if (valid.load(std::memory_order_acquire)) return 0;
+  std::lock_guard<std::mutex> lock(buildMutex);
+  if (valid.load(std::memory_order_relaxed)) return 0;
+  for (size_t i = 0; i < entries.size(); ++i) entries[i].spent.clear();
+  const std::vector<Transaction>& txs = Transaction::list();
+  size_t scanned = 0;
+  if (!entries.empty()) {
+    for (size_t i = 0; i < txs.size(); ++i) {
+      if (Transaction::isDeleted(i) ||
+          txs[i].getType() != TransactionType::Expense) {
+        continue;
+      }
+      apply(txs[i].getCategoryId(), txs[i].getTime(), txs[i].getAmount());
+    }
+    scanned = txs.size();
+  }
+  valid.store(true, std::memory_order_release);
+  return scanned;
+}
+
+void BudgetBook::apply(const LedgerId& categoryId, std::string_view date,
+                       double amount) {
+  // 预算通常只有几项，逐项比较分类比按分类建索引更省
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (entries[i].budget.categoryId != categoryId) continue;
+    entries[i].spent[std::string(periodKey(date, entries[i].budget.period))] +=
+        amount;
+  }
+}
+
+BudgetStatus BudgetBook::statusOf(const Entry& entry, std::string_view date) {
+  std::string key(periodKey(date, entry.budget.period));
+  auto it = entry.spent.find(key);
+  double spent = it != entry.spent.end() ? it->second : 0.0;
+  return BudgetStatus{entry.budget, std::move(key), spent};
+}
+
+std::vector<RecurringTemplate> RecurringService::list;
+
+bool RecurringService::addTemplate(RecurringTemplate tmpl) {
+  if (!(tmpl.amount >= 0.0) || !isValidDate(tmpl.next)) return false;
+  LedgerLock::WriteGuard guard;
+  if (!Category::categoryExists(tmpl.categoryId)) return false;
+  if (tmpl.id.empty()) {
+    int64_t next = 1;
+    for (size_t i = 0; i < list.size(); ++i) {
+      std::string_view id = list[i].id.view();
+      int64_t number = 0;
+      if (id.size() > 1 && id[0] == 'R' &&
+          std::from_chars(id.data() + 1, id.data() + id.size(), number).ptr ==
+              id.data() + id.size()) {
+        next = std::max(next, number + 1);
+      }
+    }
+    tmpl.id = "R" + std::to_string(next);
+  }
+  if (!tmpl.id.valid()) return false;
+  for (size_t i = 0; i < list.size(); ++i) {
+    if (list[i].id == tmpl.id) return false;
+  }
+  if (tmpl.day < 1 || tmpl.day > 31) tmpl.day = digitsAt(tmpl.next, 8, 2);
+  list.push_back(std::move(tmpl));
+  return true;
+}
+
+bool RecurringService::removeTemplate(const LedgerId& id) {
+  LedgerLock::WriteGuard guard;
+  for (size_t i = 0; i < list.size(); ++i) {
+    if (list[i].id == id) {
+      list.erase(list.begin() + static_cast<std::ptrdiff_t>(i));
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<RecurringTemplate> RecurringService::templates() {
+  LedgerLock::ReadGuard guard;
+  return list;
+}
+
+void RecurringService::clear() {
+  LedgerLock::WriteGuard guard;
+  list.clear();
+}
+
+size_t RecurringService::post(const std::string& until) {
+  if (!isValidDate(until)) return 0;
+  LedgerLock::WriteGuard guard;
+  std::vector<Transaction> batch;
+  for (size_t i = 0; i < list.size(); ++i) {
+    RecurringTemplate& tmpl = list[i];
+    while (isValidDate(tmpl.next) && tmpl.next <= until) {
+      batch.emplace_back(IdAllocator::next(IdAllocator::TransactionIds),
+                         tmpl.amount, tmpl.next, tmpl.categoryId, tmpl.type,
+                         tmpl.remarks);
+      tmpl.next = advance(tmpl.next, tmpl.every, tmpl.day);
+    }
+  }
+  if (batch.empty()) return 0;
+  // 分类已被删除的记录不补记，模板照常推进
+  std::vector<ImportError> errors;
+  size_t added = Transaction::addTransactions(batch, errors);
+  DataPersistence::saveAll();
+  return added;
+}
+
+std::string RecurringService::advance(const std::string& date,
+                                      TimeGroup every, int day) {
+  int64_t y = digitsAt(date, 0, 4);
+  unsigned m = static_cast<unsigned>(digitsAt(date, 5, 2));
+  unsigned d = static_cast<unsigned>(digitsAt(date, 8, 2));
+  int64_t next = daysFromCivil(y, m, d);
+  if (every == TimeGroup::Daily) {
+    ++next;
+  } else {
+    if (every == TimeGroup::Monthly) {
+      y += m / 12;
+      m = m % 12 + 1;
+    } else {
+      ++y;
+    }
+    // 记账日超出该月天数时取月末
+    int64_t first = daysFromCivil(y, m, 1);
+    int64_t length = daysFromCivil(m == 12 ? y + 1 : y, m % 12 + 1, 1) - first;
+    next = first + std::min<int64_t>(day, length) - 1;
+  }
+  char text[11];
+  formatDate(next, text);
+  return std::string(text, 10);
+}
+
+char* RemarkArena::reserve(size_t size) {
+  if (blocks.empty() || blockSize - used < size) {
+    blockSize = std::max<size_t>(BLOCK_SIZE, size);
+    blocks.emplace_back(new char[blockSize]);
+    allocated += blockSize;
+    used = 0;
+  }
+  return blocks.back().get() + used;
+}
+
+std::string_view RemarkArena::copy(std::string_view text) {
+  if (text.empty()) return std::string_view();
+  char* begin = reserve(text.size());
+  std::memcpy(begin, text.data(), text.size());
+  used += text.size();
+  return std::string_view(begin, text.size());
+}
+
+std::string_view RemarkArena::store(std::string_view raw) {
+  if (raw.empty()) return std::string_view();
+  // 反转义只会变短，按原始长度预留即可
+  char* begin = reserve(raw.size());
+  char* out = begin;
+  for (size_t i = 0; i < raw.size(); ++i) {
+    if (raw[i] == '\\' && i + 1 < raw.size() &&
+        (raw[i + 1] == '|' || raw[i + 1] == 'n' || raw[i + 1] == '\\')) {
+      *out++ = raw[i + 1] == 'n' ? '\n' : raw[i + 1];
+      ++i;
+    } else {
+      *out++ = raw[i];
+    }
+  }
+  used += static_cast<size_t>(out - begin);
+  return std::string_view(begin, static_cast<size_t>(out - begin));
+}
+
+bool Transaction::addTransaction(const Transaction& t) {
+  return emplaceTransaction(t);
+}
+
+bool Transaction::addTransaction(Transaction&& t) {
+  return emplaceTransaction(std::move(t));
+}
+
+size_t Transaction::addTransactions(std::vector<Transaction>& batch,
+                                    std::vector<ImportError>& errors) {
+  METRICS_SCOPE(m, AddTransactions);
+  LedgerLock::WriteGuard guard;
+  METRICS_ADD(m, scanned, batch.size());
+  std::vector<char> accepted(batch.size(), 0);
+  size_t count = 0;
+  ensureRowIndex();
+  // 索引同样按倍数扩容，避免分块追加时每块都整体重新散列
+  size_t indexNeeded = rowIndex.size() + batch.size();
+  if (indexNeeded > rowIndex.bucket_count() * rowIndex.max_load_factor()) {
+    rowIndex.reserve(std::max(indexNeeded, rowIndex.size() * 2));
+  }
+  {
+    // 合格的行直接以追加后的行号登记到索引，登记失败即与仓库或本批次
+    // 之前的行重复，每行只做一次索引操作
+    std::unordered_set<LedgerId> categoryIds;
+    Category::forEachCategory([&categoryIds](const Category& c) {
+      categoryIds.insert(c.getId());
+    });
+
+    for (size_t i = 0; i < batch.size(); ++i) {
+      const Transaction& tx = batch[i];
+      if (!validateTransaction(tx)) {
+        errors.push_back({i, "ID 为空或过长，或金额为负"});
+      } else if (categoryIds.find(tx.categoryId) == categoryIds.end()) {
+        errors.push_back({i, "分类不存在: " + tx.categoryId.str()});
+      } else if (!rowIndex.emplace(tx.transactionId,
+                                   repository.size() + count).second) {
+        errors.push_back({i, "ID 重复: " + tx.transactionId.str()});
+      } else {
+        accepted[i] = 1;
+        ++count;
+      }
+    }
+  }
+
+  // 一次扩容后整体追加；按倍数扩容，分块多次追加时不会每块都整体搬移
+  size_t needed = repository.size() + count;
+  if (needed > repository.capacity()) {
+    repository.reserve(std::max(needed, repository.capacity() * 2));
+  }
+  for (size_t i = 0; i < batch.size(); ++i) {
+    if (!accepted[i]) continue;
+    IdAllocator::observe(IdAllocator::TransactionIds, batch[i].transactionId);
+    DirtyTracker::mark(batch[i].transactionTime);
+    indexRow(batch[i]);
+    repository.push_back(std::move(batch[i]));
+  }
+  METRICS_ADD(m, matched, count);
+  return count;
+}
+
+bool Transaction::deleteTransaction(const LedgerId& id) {
+  METRICS_SCOPE(m, DeleteTransaction);
+  LedgerLock::WriteGuard guard;
+  if (!markDeleted(id)) return false;
+  METRICS_ADD(m, matched, 1);
+  compactIfNeeded();
+  DataPersistence::saveAll();
+  return true;
+}
+
+size_t Transaction::deleteTransactions(const std::vector<LedgerId>& ids) {
+  METRICS_SCOPE(m, DeleteTransaction);
+  LedgerLock::WriteGuard guard;
+  size_t count = 0;
+  for (size_t i = 0; i < ids.size(); ++i) {
+    if (markDeleted(ids[i])) ++count;
+  }
+  METRICS_ADD(m, matched, count);
+  return finishBatch(count);
+}
+
+bool Transaction::markDeleted(const LedgerId& id) {
+  ensureRowIndex();
+  auto it = rowIndex.find(id);
+  if (it == rowIndex.end()) return false;
+  size_t row = it->second;
+  rowIndex.erase(it);
+  markDeletedRow(row);
+  return true;
+}
+
+void Transaction::markDeletedRow(size_t row) {
+  DirtyTracker::mark(repository[row].transactionTime);
+  unindexRow(repository[row]);
+  repository[row] = Transaction();  // 立即释放该行的字符串
+  if ((row >> 6) >= deadBits.size()) {
+    deadBits.resize((repository.size() + 63) >> 6, 0);
+  }
+  deadBits[row >> 6] |= uint64_t(1) << (row & 63);
+  ++deadRows;
+}
+
+size_t Transaction::finishBatch(size_t count) {
+  if (count == 0) return 0;
+  compactIfNeeded();
+  DataPersistence::saveAll();
+  return count;
+}
+
+void Transaction::compact() {
+  METRICS_SCOPE(m, Compact);
+  LedgerLock::WriteGuard guard;
+  METRICS_ADD(m, scanned, repository.size());
+  METRICS_ADD(m, matched, deadRows);
+  size_t kept = 0;
+  for (size_t i = 0; i < repository.size(); ++i) {
+    if (isDeleted(i)) continue;
+    if (kept != i) repository[kept] = std::move(repository[i]);
+    ++kept;
+  }
+  repository.erase(repository.begin() + static_cast<std::ptrdiff_t>(kept),
+                   repository.end());
+  deadBits.clear();
+  deadRows = 0;
+  rowIndexValid = false;
+}
+
+void Transaction::ensureRowIndex() {
+  if (rowIndexValid) return;
+  rowIndex.clear();
+  rowIndex.reserve(repository.size());
+  for (size_t i = 0; i < repository.size(); ++i) {
+    if (!isDeleted(i)) rowIndex.emplace(repository[i].transactionId, i);
+  }
+  rowIndexValid = true;
+}
+
+std::string generateTransactionId() {
+  return IdAllocator::next(IdAllocator::TransactionIds);
+}
+
+std::string generateCategoryId() {
+  return IdAllocator::next(IdAllocator::CategoryIds);
+}
+
+std::string readString(const std::string& prompt) {
+  std::cout << prompt;
+  std::string input;
+  std::getline(std::cin, input);
+  return input;
+}
+
+double readDouble(const std::string& prompt) {
+  while (true) {
+    std::string input = readString(prompt);
+    if (input.empty()) return -1.0;
+    std::stringstream ss(input);
+    double value;
+    if (ss >> value && ss.eof()) return value;
+    std::cout << "输入无效，请输入有效的数字！\n";
+  }
+}
+
+int readInt(const std::string& prompt) {
+  while (true) {
+    std::string input = readString(prompt);
+    if (input.empty()) return -1;
+    std::stringstream ss(input);
+    int value;
+    if (ss >> value && ss.eof()) return value;
+    std::cout << "输入无效，请输入有效的整数！\n";
+  }
+}
+
+bool isValidDate(const std::string& date) {
+  if (date.size() != 10 || date[4] != '-' || date[7] != '-') return false;
+  for (size_t i = 0; i < date.size(); ++i) {
+    if (i == 4 || i == 7) continue;
+    if (!std::isdigit(static_cast<unsigned char>(date[i]))) return false;
+  }
+  int year = std::stoi(date.substr(0, 4));
+  int month = std::stoi(date.substr(5, 2));
+  int day = std::stoi(date.substr(8, 2));
+  if (year < 1900 || year > 2100 || month < 1 || month > 12) return false;
+  int daysInMonth[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+  if ((year % 4 == 0 && year % 100 != 0) || (year % 400 == 0)) {
+    daysInMonth[1] = 29;
+  }
+  return day >= 1 && day <= daysInMonth[month - 1];
+}
+
+std::string currentDate() {
+  std::time_t now = std::time(nullptr);
+  std::tm local = {};
+#if defined(_WIN32) || defined(_WIN64)
+  localtime_s(&local, &now);
+#else
+  localtime_r(&now, &local);
+#endif
+  char text[11];
+  std::strftime(text, sizeof(text), "%Y-%m-%d", &local);
+  return text;
+}
+
+std::string readDate(const std::string& prompt, bool required) {
+  while (true) {
+    std::string date = readString(prompt);
+    if (!required && date.empty()) return date;
+    if (required && date.empty()) {
+      std::cout << "错误：日期不能为空！\n";
+      continue;
+    }
+    if (!isValidDate(date)) {
+      std::cout << "错误：日期格式无效或日期不存在！(YYYY-MM-DD)\n";
+      continue;
+    }
+    return date;
+  }
+}
+
+ImportResult ImportService::importBatch(std::vector<Transaction> batch) {
+  ImportResult result;
+  result.accepted = Transaction::addTransactions(batch, result.errors);
+  result.ok = result.accepted == 0 || DataPersistence::saveAll();
+  return result;
+}
+
+ImportResult ImportService::importFile(const std::string& path) {
+  ImportResult result;
+  std::ifstream file(path);
+  if (!file.is_open()) return result;
+
+  // 分类引用（名称或 ID）到分类 ID 的映射只构建一次，ID 优先于同名名称
+  std::unordered_map<std::string, LedgerId> categoryRefs;
+  Category::forEachCategory([&categoryRefs](const Category& c) {
+    categoryRefs.emplace(c.getName(), c.getId());
+  });
+  Category::forEachCategory([&categoryRefs](const Category& c) {
+    categoryRefs[c.getId().str()] = c.getId();
+  });
+
+  std::vector<Transaction> batch;
+  std::vector<size_t> lineOf;  // batch 下标 -> 文件行号
+  std::vector<size_t> unnamed;  // 需要分配 ID 的 batch 下标
+  std::string line;
+  size_t lineNo = 0;
+  while (std::getline(file, line)) {
+    ++lineNo;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+    Transaction tx;
+    std::string reason;
+    if (!parseLine(line, categoryRefs, tx, reason)) {
+      result.errors.push_back({lineNo, reason});
+      continue;
+    }
+    if (tx.getId().empty()) unnamed.push_back(batch.size());
+    batch.push_back(std::move(tx));
+    lineOf.push_back(lineNo);
+  }
+  file.close();
+
+  // 整个文件一次预留，未被接受的行留下的空号不影响唯一性
+  if (!unnamed.empty()) {
+    int64_t first =
+        IdAllocator::reserve(IdAllocator::TransactionIds, unnamed.size());
+    for (size_t i = 0; i < unnamed.size(); ++i) {
+      batch[unnamed[i]].setId(IdAllocator::format(
+          IdAllocator::TransactionIds, first + static_cast<int64_t>(i)));
+    }
+  }
+
+  std::vector<ImportError> batchErrors;
+  result.accepted = Transaction::addTransactions(batch, batchErrors);
+  for (size_t i = 0; i < batchErrors.size(); ++i) {
+    result.errors.push_back({lineOf[batchErrors[i].row],
+                             batchErrors[i].reason});
+  }
+  std::sort(result.errors.begin(), result.errors.end(),
+            [](const ImportError& a, const ImportError& b) {
+              return a.row < b.row;
+            });
+  result.ok = result.accepted == 0 || DataPersistence::saveAll();
+  return result;
+}
+
+bool ImportService::parseLine(
+    const std::string& line,
+    const std::unordered_map<std::string, LedgerId>& categoryRefs,
+    Transaction& tx, std::string& reason) {
+  std::vector<std::string> parts =
+      DataPersistence::split(line, DataPersistence::DELIMITER);
+  if (parts.size() < 5) {
+    reason = "字段数不足";
+    return false;
+  }
+  char* end = nullptr;
+  double amount = std::strtod(parts[1].c_str(), &end);
+  if (parts[1].empty() || *end != '\0') {
+    reason = "金额无效: " + parts[1];
+    return false;
+  }
+  if (!isValidDate(parts[2])) {
+    reason = "日期无效: " + parts[2];
+    return false;
+  }
+  if (parts[4] != "0" && parts[4] != "1") {
+    reason = "类型无效: " + parts[4];
+    return false;
+  }
+
+  tx.setId(parts[0]);
+  tx.setAmount(amount);
+  tx.setTime(std::move(parts[2]));
+  auto ref = categoryRefs.find(parts[3]);
+  if (ref != categoryRefs.end()) {
+    tx.setCategoryId(ref->second);
+  } else {
+    tx.setCategoryId(std::move(parts[3]));
+  }
+  tx.setType(parts[4] == "0" ? TransactionType::Income :
+             TransactionType::Expense);
+  if (parts.size() >= 6) {
+    tx.setRemarks(DataPersistence::unescapeString(std::move(parts[5])));
+  }
+  return true;
+}
+
+namespace {
+
+// 去掉首尾空白，CSV 中的列名和分类名常带多余空格
+std::string trim(std::string_view str) {
+  size_t b = str.find_first_not_of(" \t");
+  if (b == std::string_view::npos) return std::string();
+  size_t e = str.find_last_not_of(" \t");
+  return std::string(str.substr(b, e - b + 1));
+}
+
+}  // namespace
+
+ImportResult ImportService::importCsv(const std::string& path,
+                                      const CsvImportOptions& options) {
+  METRICS_SCOPE(m, ImportCsv);
+  ImportResult result;
+  std::ifstream file(path, std::ios::binary);
+  if (!file.is_open()) return result;
+  // 整个导入期间持有写锁：读者看不到导入了一半的数据，分类表和仓库
+  // 只由本线程修改，解析线程只读本地的分类映射
+  LedgerLock::WriteGuard guard;
+
+  std::unordered_map<std::string, LedgerId> categoryRefs;
+  Category::forEachCategory([&categoryRefs](const Category& c) {
+    categoryRefs.emplace(c.getName(), c.getId());
+  });
+  Category::forEachCategory([&categoryRefs](const Category& c) {
+    categoryRefs[c.getId().str()] = c.getId();
+  });
+
+  size_t threads = options.threads;
+  if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+  const size_t chunkSize = std::max<size_t>(options.chunkSize, 1);
+
+  CsvColumns columns = {};
+  bool haveHeader = false;
+  std::string buffer;
+  std::vector<CsvRecord> records;
+  size_t start = 0, pos = 0;     // 未完成记录的起点、扫描位置
+  size_t line = 1, recordLine = 1;
+  bool quoted = false, first = true;
+  std::vector<std::string> fields;
+  while (true) {
+    size_t old = buffer.size();
+    buffer.resize(old + chunkSize);
+    file.read(&buffer[old], static_cast<std::streamsize>(chunkSize));
+    buffer.resize(old + static_cast<size_t>(file.gcount()));
+    bool eof = !file;
+    if (first) {
+      if (buffer.compare(0, 3, "\xEF\xBB\xBF") == 0) start = pos = 3;
+      first = false;
+    }
+
+    // 切出完整的记录：引号内的换行属于字段内容
+    for (; pos < buffer.size(); ++pos) {
+      char c = buffer[pos];
+      if (c == '"') {
+        quoted = !quoted;
+      } else if (c == '\n') {
+        ++line;
+        if (!quoted) {
+          records.push_back({start, pos, recordLine});
+          start = pos + 1;
+          recordLine = line;
+        }
+      }
+    }
+    if (eof && start < buffer.size()) {
+      records.push_back({start, buffer.size(), recordLine});
+      start = buffer.size();
+    }
+
+    size_t next = 0;
+    if (!haveHeader) {
+      // 第一条非空记录为表头
+      for (; next < records.size() && !haveHeader; ++next) {
+        std::string_view text(buffer.data() + records[next].begin,
+                              records[next].end - records[next].begin);
+        if (!text.empty() && text.back() == '\r') text.remove_suffix(1);
+        if (text.empty()) continue;
+        splitCsv(text, options.delimiter, fields);
+        auto find = [&fields](const std::string& name) {
+          for (size_t i = 0; i < fields.size() && !name.empty(); ++i) {
+            if (trim(fields[i]) == name) return i;
+          }
+          return CsvColumns::NONE;
+        };
+        columns.id = find(options.idColumn);
+        columns.amount = find(options.amountColumn);
+        columns.date = find(options.dateColumn);
+        columns.category = find(options.categoryColumn);
+        columns.type = find(options.typeColumn);
+        columns.remarks = find(options.remarksColumn);
+        columns.count = fields.size();
+        const std::string* missing =
+            columns.amount == CsvColumns::NONE ? &options.amountColumn :
+            columns.date == CsvColumns::NONE ? &options.dateColumn :
+            columns.category == CsvColumns::NONE ? &options.categoryColumn :
+            nullptr;
+        if (missing != nullptr) {
+          result.errors.push_back({records[next].line,
+                                   "表头缺少列: " + *missing});
+          return result;
+        }
+        haveHeader = true;
+      }
+    }
+
+    if (next < records.size()) {
+      METRICS_ADD(m, scanned, records.size() - next);
+      // 记录平均分给各线程，每段至少 1024 条，本线程解析第一段
+      size_t count = records.size() - next;
+      size_t sliceCount = std::min(threads, std::max<size_t>(count / 1024, 1));
+      std::vector<CsvSlice> slices(sliceCount);
+      std::vector<std::thread> workers;
+      std::string_view text(buffer);
+      for (size_t i = 1; i < sliceCount; ++i) {
+        size_t b = next + count * i / sliceCount;
+        size_t e = next + count * (i + 1) / sliceCount;
+        workers.emplace_back([&, b, e, i]() {
+          parseCsvSlice(text, records, b, e, columns, options.delimiter,
+                        categoryRefs, slices[i]);
+        });
+      }
+      parseCsvSlice(text, records, next, next + count / sliceCount, columns,
+                    options.delimiter, categoryRefs, slices[0]);
+      for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+
+      // 按原顺序合并：新建缺失的分类，为留空的 ID 预留一段编号
+      std::vector<Transaction> batch;
+      std::vector<size_t> lineOf;
+      std::vector<size_t> unnamed;
+      for (size_t i = 0; i < slices.size(); ++i) {
+        CsvSlice& slice = slices[i];
+        for (size_t j = 0; j < slice.newCategories.size(); ++j) {
+          const std::string& name = slice.newCategories[j].second;
+          auto ref = categoryRefs.find(name);
+          if (ref == categoryRefs.end()) {
+            LedgerId id(generateCategoryId());
+            Category::emplaceCategory(id, name);
+            ++result.categoriesCreated;
+            ref = categoryRefs.emplace(name, id).first;
+          }
+          slice.rows[slice.newCategories[j].first].setCategoryId(ref->second);
+        }
+        result.errors.insert(result.errors.end(), slice.errors.begin(),
+                             slice.errors.end());
+        for (size_t j = 0; j < slice.rows.size(); ++j) {
+          if (slice.rows[j].getId().empty()) unnamed.push_back(batch.size());
+          batch.push_back(std::move(slice.rows[j]));
+          lineOf.push_back(slice.lines[j]);
+        }
+      }
+      if (!unnamed.empty()) {
+        int64_t firstId =
+            IdAllocator::reserve(IdAllocator::TransactionIds, unnamed.size());
+        for (size_t i = 0; i < unnamed.size(); ++i) {
+          batch[unnamed[i]].setId(IdAllocator::format(
+              IdAllocator::TransactionIds, firstId + static_cast<int64_t>(i)));
+        }
+      }
+      std::vector<ImportError> batchErrors;
+      result.accepted += Transaction::addTransactions(batch, batchErrors);
+      for (size_t i = 0; i < batchErrors.size(); ++i) {
+        result.errors.push_back({lineOf[batchErrors[i].row],
+                                 batchErrors[i].reason});
+      }
+    }
+
+    records.clear();
+    buffer.erase(0, start);
+    pos -= start;
+    start = 0;
+    if (eof) break;
+  }
+  file.close();
+
+  std::sort(result.errors.begin(), result.errors.end(),
+            [](const ImportError& a, const ImportError& b) {
+              return a.row < b.row;
+            });
+  METRICS_ADD(m, matched, result.accepted);
+  result.ok = haveHeader &&
+      ((result.accepted == 0 && result.categoriesCreated == 0) ||
+       DataPersistence::saveAll());
+  return result;
+}
+
+bool ImportService::splitCsv(std::string_view record, char delimiter,
+                             std::vector<std::string>& fields) {
+  // 字段对象逐条记录复用，保留已分配的容量
+  size_t count = 0;
+  auto next = [&fields, &count]() -> std::string& {
+    if (count == fields.size()) fields.emplace_back();
+    fields[count].clear();
+    return fields[count++];
+  };
+  std::string* field = &next();
+  const char specials[] = {'"', delimiter, '\0'};
+  bool quoted = false;
+  size_t i = 0;
+  while (i < record.size()) {
+    if (quoted) {
+      // 整段追加到下一个引号；"" 为转义的引号
+      size_t q = record.find('"', i);
+      if (q == std::string_view::npos) {
+        field->append(record.substr(i));
+        break;
+      }
+      field->append(record.substr(i, q - i));
+      if (q + 1 < record.size() && record[q + 1] == '"') {
+        *field += '"';
+        i = q + 2;
+      } else {
+        quoted = false;
+        i = q + 1;
+      }
+      continue;
+    }
+    size_t stop = record.find_first_of(specials, i, 2);
+    if (stop == std::string_view::npos) {
+      field->append(record.substr(i));
+      break;
+    }
+    field->append(record.substr(i, stop - i));
+    if (record[stop] == '"') {
+      quoted = true;
+    } else {
+      field = &next();
+    }
+    i = stop + 1;
+  }
+  fields.resize(count);
+  return !quoted;
+}
+
+void ImportService::parseCsvSlice(
+    std::string_view text, const std::vector<CsvRecord>& records,
+    size_t begin, size_t end, const CsvColumns& columns, char delimiter,
+    const std::unordered_map<std::string, LedgerId>& categoryRefs,
+    CsvSlice& slice) {
+  std::vector<std::string> fields;
+  slice.rows.reserve(end - begin);
+  slice.lines.reserve(end - begin);
+  for (size_t r = begin; r < end; ++r) {
+    const CsvRecord& record = records[r];
+    std::string_view row = text.substr(record.begin, record.end - record.begin);
+    if (!row.empty() && row.back() == '\r') row.remove_suffix(1);
+    if (row.empty()) continue;
+    if (!splitCsv(row, delimiter, fields)) {
+      slice.errors.push_back({record.line, "引号不匹配"});
+      continue;
+    }
+    if (fields.size() < columns.count) fields.resize(columns.count);
+
+    std::string amountText;
+    for (char c : fields[columns.amount]) {
+      if (c != ',' && c != ' ') amountText += c;
+    }
+    char* endPtr = nullptr;
+    double amount = std::strtod(amountText.c_str(), &endPtr);
+    if (amountText.empty() || *endPtr != '\0') {
+      slice.errors.push_back({record.line,
+                              "金额无效: " + fields[columns.amount]});
+      continue;
+    }
+    std::string date = trim(fields[columns.date]);
+    std::replace(date.begin(), date.end(), '/', '-');
+    if (!isValidDate(date)) {
+      slice.errors.push_back({record.line,
+                              "日期无效: " + fields[columns.date]});
+      continue;
+    }
+    TransactionType type;
+    if (columns.type != CsvColumns::NONE) {
+      const std::string t = trim(fields[columns.type]);
+      if (t == "income" || t == "收入" || t == "0") {
+        type = TransactionType::Income;
+      } else if (t == "expense" || t == "支出" || t == "1") {
+        type = TransactionType::Expense;
+      } else {
+        slice.errors.push_back({record.line, "类型无效: " + t});
+        continue;
+      }
+    } else {
+      type = amount < 0.0 ? TransactionType::Expense : TransactionType::Income;
+      amount = std::fabs(amount);
+    }
+    std::string category = trim(fields[columns.category]);
+    if (category.empty()) {
+      slice.errors.push_back({record.line, "分类为空"});
+      continue;
+    }
+
+    Transaction tx;
+    if (columns.id != CsvColumns::NONE) tx.setId(trim(fields[columns.id]));
+    tx.setAmount(amount);
+    tx.setTime(std::move(date));
+    tx.setType(type);
+    if (columns.remarks != CsvColumns::NONE) {
+      tx.setRemarks(std::move(fields[columns.remarks]));
+    }
+    auto ref = categoryRefs.find(category);
+    if (ref != categoryRefs.end()) {
+      tx.setCategoryId(ref->second);
+    } else {
+      slice.newCategories.emplace_back(slice.rows.size(), std::move(category));
+    }
+    slice.rows.push_back(std::move(tx));
+    slice.lines.push_back(record.line);
+  }
+}
+
+void displayCategories() {
+  std::cout << "\n可用分类：\n";
+  Category::forEachCategory([](const Category& c) {
+    std::cout << "  [" << c.getId() << "] " << c.getName() << '\n';
+  });
+}
+
+void manageCategoriesMenu() {
+  std::cout << "\n========== 分类管理 ==========\n";
+  bool dataChanged = false;
+  while (true) {
+    std::cout << "\n1. 添加分类\n2. 删除分类\n3. 返回\n";
+    int choice = readInt("请输入选项: ");
+    if (choice == 1) {
+      std::string id = generateCategoryId();
+      std::string name;
+      while (name.empty()) {
+        name = readString("分类名称（必填）: ");
+        if (name.empty()) std::cout << "不能为空！\n";
+      }
+      if (Category::addCategory(Category(id, name))) {
+        std::cout << "添加成功 ID: " << id << '\n';
+        dataChanged = true;
+      } else {
+        std::cout << "添加失败！\n";
+      }
+    } else if (choice == 2) {
+      displayCategories();
+      std::string id = readString("删除的分类ID(0取消): ");
+      if (id == "0") {
+        std::cout << "已取消。\n";
+        continue;
+      }
+      if (!Category::categoryExists(id)) {
+        std::cout << "不存在！\n";
+        continue;
+      }
+      if (Transaction::categoryHasTransactions(id)) {
+        std::cout << "该分类下存在交易,无法删除！\n";
+        continue;
+      }
+      if (Category::deleteCategory(id)) {
+        std::cout << "删除成功。\n";
+        dataChanged = true;
+      }
+    } else if (choice == 3) {
+      break;
+    }
+  }
+  if (dataChanged) DataPersistence::saveAll();
+}
+
+void recordTransaction() {
+  std::cout << "\n========== 记一笔 ==========\n";
+  while (true) {
+    std::string id = generateTransactionId();
+    double amount = -1.0;
+    while (amount < 0.0) {
+      amount = readDouble("金额（>=0）: ");
+      if (amount < 0.0) std::cout << "金额不能为负！\n";
+    }
+    std::string date = readDate("日期(YYYY-MM-DD): ", true);
+
+    std::string categoryId;
+    while (categoryId.empty()) {
+      displayCategories();
+      std::cout << "[0] 添加新分类\n";
+      categoryId = readString("分类ID或0新增: ");
+      if (categoryId == "0") {
+        std::string newName;
+        while (newName.empty()) {
+          newName = readString("新分类名称: ");
+          if (newName.empty()) std::cout << "不能为空！\n";
+        }
+        std::string newId = generateCategoryId();
+        if (Category::emplaceCategory(newId, std::move(newName))) {
+          std::cout << "新分类添加成功: " << newId << '\n';
+          categoryId = newId;
+        } else {
+          categoryId.clear();
+        }
+      } else if (!Category::categoryExists(categoryId)) {
+        std::cout << "分类不存在。\n";
+        categoryId.clear();
+      }
+    }
+
+    int typeChoice = -1;
+    while (typeChoice != 1 && typeChoice != 2) {
+      typeChoice = readInt("类型 [1收入 2支出]: ");
+    }
+    TransactionType type = typeChoice == 1 ? TransactionType::Income :
+                                             TransactionType::Expense;
+
+    if (Transaction::emplaceTransaction(id, amount, std::move(date),
+                                        std::move(categoryId), type,
+                                        readString("备注(可空): "))) {
+      std::cout << "记账成功 ID: " << id << '\n';
+    }
+    std::string cont = readString("继续？[y/n]: ");
+    if (cont != "y" && cont != "Y") break;
+  }
+}
+
+void statisticAnalysis() {
+  std::cout << "\n========== 统计分析 ==========\n";
+  while (true) {
+    std::cout << "\n1. 按类型\n2. 按时间\n3. 按分类\n"
+              << "4. 按金额区间\n5. 余额走势\n"
+              << "6. 支出分位数与去重计数\n7. 排行榜\n0. 返回\n";
+    int choice = readInt("选项: ");
+    StatisticService stat(Transaction::list());
+    if (choice == 1) {
+      stat.calculateAndDisplayByType();
+    } else if (choice == 2) {
+      std::cout << "1日 2月 3年\n";
+      int g = readInt("粒度: ");
+      TimeGroup group = (g == 2) ? TimeGroup::Monthly :
+                       (g == 3) ? TimeGroup::Yearly : TimeGroup::Daily;
+      std::string startDate = readDate("开始日期(可空): ", false);
+      std::string endDate = readDate("结束日期(可空): ", false);
+      if (!startDate.empty() && !endDate.empty() && startDate > endDate) {
+        std::swap(startDate, endDate);
+      }
+      stat.calculateAndDisplayByTime(group, {startDate, endDate});
+    } else if (choice == 3) {
+      stat.calculateAndDisplayByCategory();
+    } else if (choice == 4) {
+      std::string spec =
+          readString("区间边界(如 100,500,1000 或 log:1:10000:4，回车默认): ");
+      AmountHistogram buckets = AmountHistogram::defaults();
+      if (!spec.empty() && !AmountHistogram::parse(spec, buckets)) {
+        std::cout << "边界格式无效，使用默认区间。\n";
+        buckets = AmountHistogram::defaults();
+      }
+      stat.calculateAndDisplayByAmountRange(buckets);
+    } else if (choice == 6) {
+      std::cout << "1月 2分类\n";
+      int g = readInt("分组: ");
+      stat.setSketches(true);
+      StatisticReport report = g == 2 ? stat.reportByCategory()
+                                      : stat.reportByTime(TimeGroup::Monthly, {});
+      std::cout << "\n支出分布（近似）：\n分组\t支出笔数\t中位数\tP90\t"
+                << "不同备注\t不同关键词\n"
+                << "--------------------------------------\n";
+      for (size_t i = 0; i < report.rows.size(); ++i) {
+        const GroupSketch& sketch = report.sketches[i];
+        std::cout << report.rows[i].key << '\t' << report.rows[i].expenseCount
+                  << '\t' << sketch.expenses.quantile(0.5) << '\t'
+                  << sketch.expenses.quantile(0.9) << '\t'
+                  << std::llround(sketch.remarks.estimate()) << '\t'
+                  << std::llround(sketch.keywords.estimate()) << '\n';
+      }
+    } else if (choice == 5) {
+      std::cout << "1日 2月 3年\n";
+      int g = readInt("粒度: ");
+      TimeGroup group = (g == 2) ? TimeGroup::Monthly :
+                       (g == 3) ? TimeGroup::Yearly : TimeGroup::Daily;
+      std::string startDate = readDate("开始日期(可空): ", false);
+      std::string endDate = readDate("结束日期(可空): ", false);
+      std::vector<BalancePoint> points =
+          BalanceIndex::series(startDate, endDate, group);
+      std::cout << "\n========== 余额走势 ==========\n";
+      for (size_t i = 0; i < points.size(); ++i) {
+        std::cout << points[i].period << "  "
+                  << ReportWriter::formatAmount(points[i].balance) << '\n';
+      }
+      if (points.empty()) std::cout << "无记录。\n";
+    } else if (choice == 7) {
+      std::cout << "1支出最多的分类 2金额最大的支出 3支出最多的备注词\n";
+      int kind = readInt("排行: ");
+      int n = readInt("前几名: ");
+      if (n < 1) n = 10;
+      if (static_cast<size_t>(n) > StatisticService::MAX_RANKING) {
+        n = static_cast<int>(StatisticService::MAX_RANKING);
+      }
+      std::string startDate = readDate("开始日期(可空): ", false);
+      std::string endDate = readDate("结束日期(可空): ", false);
+      std::vector<std::string> range = {startDate, endDate};
+      if (kind == 2) {
+        displayTransactionList(stat.topTransactions(
+            static_cast<size_t>(n), TransactionType::Expense, range));
+      } else {
+        StatisticReport report =
+            kind == 3 ? stat.topTerms(static_cast<size_t>(n), range)
+                      : stat.topCategories(static_cast<size_t>(n), range);
+        std::cout << "\n排行：\n名次\t" << (kind == 3 ? "关键词" : "分类")
+                  << "\t支出\t笔数\n"
+                  << "--------------------------------------\n";
+        for (size_t i = 0; i < report.rows.size(); ++i) {
+          std::cout << (i + 1) << '\t' << report.rows[i].key << '\t'
+                    << report.rows[i].expense << '\t'
+                    << report.rows[i].expenseCount << '\n';
+        }
+      }
+    } else if (choice == 0) {
+      break;
+    }
+    std::string cont = readString("继续统计？[y/n]: ");
+    if (cont != "y" && cont != "Y") break;
+  }
+}
+
+void displayTransactionList(const std::vector<Transaction>& list) {
+  if (list.empty()) {
+    std::cout << "\n无记录。\n";
+    return;
+  }
+  std::cout << "\n========== 交易列表 ==========\n";
+  for (size_t i = 0; i < list.size(); ++i) {
+    std::cout << (i + 1) << ". " << list[i].getTransactionDetail() << '\n';
+  }
+  std::cout << "共 " << list.size() << " 条\n";
+}
+
+void editTransaction(Transaction& tx) {
+  std::cout << "\n========== 编辑 ==========\n"
+            << tx.getTransactionDetail() << '\n';
+  std::string input = readString("新金额(回车跳过): ");
+  if (!input.empty()) {
+    std::stringstream ss(input);
+    double v;
+    if (ss >> v && v >= 0.0) tx.setAmount(v);
+  }
+  std::string nd = readString("新日期(回车跳过): ");
+  if (!nd.empty() && isValidDate(nd)) tx.setTime(nd);
+
+  displayCategories();
+  std::cout << "[0] 新增分类\n";
+  input = readString("新分类ID(回车跳过/0新增): ");
+  if (!input.empty()) {
+    if (input == "0") {
+      std::string nm;
+      while (nm.empty()) nm = readString("新分类名称: ");
+      std::string nid = generateCategoryId();
+      if (Category::addCategory(Category(nid, nm))) tx.setCategoryId(nid);
+    } else if (Category::categoryExists(input)) {
+      tx.setCategoryId(input);
+    }
+  }
+  input = readString("新类型[1收入 2支出](回车跳过): ");
+  if (input == "1") {
+    tx.setType(TransactionType::Income);
+  } else if (input == "2") {
+    tx.setType(TransactionType::Expense);
+  }
+
+  input = readString("新备注(回车跳过): ");
+  if (!input.empty()) tx.setRemarks(input);
+
+  if (tx.updateTransaction()) {
+    std::cout << "更新成功。\n";
+    DataPersistence::saveAll();
+  }
+}
+
+void searchBills() {
+  std::cout << "\n========== 查找账单 ==========\n";
+  while (true) {
+    std::string startDate = readDate("起始日期(可空): ", false);
+    std::string endDate = readDate("结束日期(可空): ", false);
+    if (!startDate.empty() && !endDate.empty() && startDate > endDate) {
+      std::swap(startDate, endDate);
+    }
+    double minAmount = readDouble("最小金额(可空): ");
+    double maxAmount = readDouble("最大金额(可空): ");
+    if (minAmount >= 0.0 && maxAmount >= 0.0 && minAmount > maxAmount) {
+      std::swap(minAmount, maxAmount);
+    }
+
+    displayCategories();
+    std::string categoryId = readString("分类ID(可空): ");
+    if (!categoryId.empty() && !Category::categoryExists(categoryId)) {
+      categoryId.clear();
+    }
+    std::string keyword = readString("关键词(可空): ");
+
+    // 相同条件重复查找时直接命中缓存
+    SearchQuery query;
+    query.dateRange = {startDate, endDate};
+    query.amountRange = {minAmount >= 0.0 ? minAmount : 0.0,
+                         maxAmount >= 0.0 ? maxAmount : 999999999.0};
+    query.categoryId = categoryId;
+    query.keyword = keyword;
+    QueryCache::TransactionList results = QueryCache::search(query);
+
+    displayTransactionList(*results);
+
+    if (results->empty()) {
+      std::string c = readString("重新搜索？[y/n]: ");
+      if (c != "y" && c != "Y") break;
+      continue;
+    }
+
+    std::string sortChoice = readString("排序？[y/n]: ");
+    if (sortChoice == "y" || sortChoice == "Y") {
+      int f = readInt("字段[1金额 2时间]: ");
+      int d = readInt("方向[1升 2降]: ");
+      query.sorted = true;
+      query.sortField = (f == 1) ? SortField::Amount : SortField::Time;
+      query.direction = (d == 1) ? SortDirection::Asc : SortDirection::Desc;
+      results = QueryCache::search(query);
+      displayTransactionList(*results);
+    }
+
+    std::string op = readString(
+        "操作[1编辑 2删除 3全部删除 4全部改分类 5全部改备注 0跳过]: ");
+    if (op == "1") {
+      int idx = readInt("记录编号: ") - 1;
+      if (idx >= 0 && static_cast<size_t>(idx) < results->size()) {
+        // 修改副本后经 updateTransaction 提交，只标记新旧两个月份
+        Transaction tx = (*results)[idx];
+        editTransaction(tx);
+      }
+    } else if (op == "2") {
+      int idx = readInt("删除编号: ") - 1;
+      if (idx >= 0 && static_cast<size_t>(idx) < results->size()) {
+        std::string cf = readString("确认删除？[y/n]: ");
+        if (cf == "y" || cf == "Y") {
+          Transaction::deleteTransaction((*results)[idx].getId());
+        }
+      }
+    } else if (op == "3") {
+      std::string cf = readString("确认删除以上全部 " +
+                                  std::to_string(results->size()) +
+                                  " 条？[y/n]: ");
+      if (cf == "y" || cf == "Y") {
+        std::cout << "已删除 " << BulkEditService::deleteMatching(query)
+                  << " 条。\n";
+      }
+    } else if (op == "4") {
+      displayCategories();
+      std::string cId = readString("新分类ID: ");
+      if (Category::categoryExists(cId)) {
+        std::cout << "已修改 " << BulkEditService::recategorize(query, cId)
+                  << " 条。\n";
+      } else {
+        std::cout << "分类不存在。\n";
+      }
+    } else if (op == "5") {
+      std::string rem = readString("新备注: ");
+      std::cout << "已修改 " << BulkEditService::setRemarks(query, rem)
+                << " 条。\n";
+    }
+
+    std::string cont = readString("继续查找？[y/n]: ");
+    if (cont != "y" && cont != "Y") break;
+  }
+}
+
+void displayHomePage() {
+  StatisticService stat(Transaction::list());
+  double ti, te, bal;
+  stat.calculateHomePage(ti, te, bal);
+  std::cout << "\n================================\n"
+            << "        个人记账系统首页\n"
+            << "================================\n"
+            << "总收入: " << ti << "\n总支出: " << te << "\n结余:   "
+            << bal << "\n================================\n";
+  // 预算消耗增量维护，这里只按预算逐项查表
+  std::vector<BudgetStatus> budgets = BudgetBook::status(currentDate());
+  if (budgets.empty()) return;
+  std::cout << "预算:\n";
+  for (size_t i = 0; i < budgets.size(); ++i) {
+    displayBudgetStatus(budgets[i]);
+  }
+  std::cout << "================================\n";
+}
+
+void displayBudgetStatus(const BudgetStatus& status) {
+  const char* periods[] = {"每日", "每月", "每年"};
+  std::string name = status.budget.categoryId.str();
+  {
+    LedgerLock::ReadGuard guard;
+    Category* cat = Category::findCategory(status.budget.categoryId);
+    if (cat) name = cat->getName();
+  }
+  std::cout << "  " << name << ' '
+            << periods[static_cast<int>(status.budget.period)] << ' '
+            << status.periodKey << ": "
+            << ReportWriter::formatAmount(status.spent) << " / "
+            << ReportWriter::formatAmount(status.budget.limit);
+  if (status.overLimit()) {
+    std::cout << "  已超支 "
+              << ReportWriter::formatAmount(-status.remaining());
+  }
+  std::cout << '\n';
+}
+
+void manageBudgetsMenu() {
+  std::cout << "\n========== 预算与周期交易 ==========\n";
+  while (true) {
+    std::cout << "\n1. 查看预算\n2. 设置预算\n3. 删除预算\n"
+              << "4. 查看周期交易\n5. 添加周期交易\n6. 删除周期交易\n"
+              << "7. 补记到期的周期交易\n8. 返回\n";
+    int choice = readInt("请输入选项: ");
+    if (choice == 1) {
+      std::string date = readDate("日期(YYYY-MM-DD，留空为今天): ", false);
+      std::vector<BudgetStatus> budgets =
+          BudgetBook::status(date.empty() ? currentDate() : date);
+      if (budgets.empty()) std::cout << "尚未设置预算。\n";
+      for (size_t i = 0; i < budgets.size(); ++i) {
+        displayBudgetStatus(budgets[i]);
+      }
+    } else if (choice == 2 || choice == 3) {
+      displayCategories();
+      std::string id = readString("分类ID: ");
+      int period = 0;
+      while (period < 1 || period > 3) {
+        period = readInt("周期 [1每日 2每月 3每年]: ");
+      }
+      Budget budget{id, static_cast<TimeGroup>(period - 1), 0.0};
+      bool ok;
+      if (choice == 2) {
+        while (!(budget.limit > 0.0)) {
+          budget.limit = readDouble("上限金额（>0）: ");
+        }
+        ok = BudgetBook::setBudget(budget);
+      } else {
+        ok = BudgetBook::removeBudget(budget.categoryId, budget.period);
+      }
+      std::cout << (ok ? "已保存。\n" : "分类或预算不存在！\n");
+      if (ok) DataPersistence::saveAll();
+    } else if (choice == 4) {
+      std::vector<RecurringTemplate> templates = RecurringService::templates();
+      if (templates.empty()) std::cout << "尚无周期交易。\n";
+      const char* periods[] = {"每日", "每月", "每年"};
+      for (size_t i = 0; i < templates.size(); ++i) {
+        const RecurringTemplate& t = templates[i];
+        std::cout << "  [" << t.id << "] "
+                  << (t.type == TransactionType::Income ? "收入" : "支出")
+                  << ' ' << ReportWriter::formatAmount(t.amount) << ' '
+                  << periods[static_cast<int>(t.every)] << " 分类="
+                  << t.categoryId << " 下次=" << t.next << ' ' << t.remarks
+                  << '\n';
+      }
+    } else if (choice == 5) {
+      RecurringTemplate tmpl{LedgerId(), -1.0, LedgerId(),
+                             TransactionType::Expense, TimeGroup::Monthly,
+                             std::string(), 0, std::string()};
+      while (tmpl.amount < 0.0) tmpl.amount = readDouble("金额（>=0）: ");
+      tmpl.next = readDate("首次日期(YYYY-MM-DD): ", true);
+      displayCategories();
+      tmpl.categoryId = readString("分类ID: ");
+      int type = 0, period = 0;
+      while (type != 1 && type != 2) type = readInt("类型 [1收入 2支出]: ");
+      if (type == 1) tmpl.type = TransactionType::Income;
+      while (period < 1 || period > 3) {
+        period = readInt("周期 [1每日 2每月 3每年]: ");
+      }
+      tmpl.every = static_cast<TimeGroup>(period - 1);
+      tmpl.remarks = readString("备注(可空): ");
+      if (RecurringService::addTemplate(tmpl)) {
+        std::cout << "添加成功 ID: " << RecurringService::templates().back().id
+                  << '\n';
+        DataPersistence::saveAll();
+      } else {
+        std::cout << "分类不存在！\n";
+      }
+    } else if (choice == 6) {
+      std::string id = readString("删除的模板ID: ");
+      if (RecurringService::removeTemplate(id)) {
+        std::cout << "删除成功。\n";
+        DataPersistence::saveAll();
+      } else {
+        std::cout << "不存在！\n";
+      }
+    } else if (choice == 7) {
+      std::cout << "已补记 " << RecurringService::post(currentDate())
+                << " 笔。\n";
+    } else if (choice == 8) {
+      break;
+    }
+  }
+}
+
+void initDefaultCategories() {
+  Category::addCategory(Category("c1", "餐饮"));
+  Category::addCategory(Category("c2", "交通"));
+  Category::addCategory(Category("c3", "购物"));
+  Category::addCategory(Category("c4", "工资"));
+  Category::addCategory(Category("c5", "奖金"));
+  Category::addCategory(Category("c6", "娱乐"));
+  Category::addCategory(Category("c7", "医疗"));
+  Category::addCategory(Category("c8", "教育"));
+}
+
+bool JsonReader::parseObject(const std::string& text,
+                             std::unordered_map<std::string, JsonValue>& obj) {
+  size_t pos = 0;
+  skipSpace(text, pos);
+  if (pos >= text.size() || text[pos] != '{') return false;
+  ++pos;
+  skipSpace(text, pos);
+  if (pos < text.size() && text[pos] == '}') return trailing(text, ++pos);
+  while (true) {
+    std::string key;
+    skipSpace(text, pos);
+    if (!readString(text, pos, key)) return false;
+    skipSpace(text, pos);
+    if (pos >= text.size() || text[pos] != ':') return false;
+    ++pos;
+    skipSpace(text, pos);
+    if (!readValue(text, pos, obj[key])) return false;
+    skipSpace(text, pos);
+    if (pos >= text.size()) return false;
+    if (text[pos] == '}') return trailing(text, ++pos);
+    if (text[pos] != ',') return false;
+    ++pos;
+  }
+}
+
+void JsonReader::skipSpace(const std::string& text, size_t& pos) {
+  while (pos < text.size() &&
+         std::isspace(static_cast<unsigned char>(text[pos]))) {
+    ++pos;
+  }
+}
+
+bool JsonReader::trailing(const std::string& text, size_t pos) {
+  skipSpace(text, pos);
+  return pos == text.size();
+}
+
+bool JsonReader::readValue(const std::string& text, size_t& pos,
+                           JsonValue& value) {
+  if (pos >= text.size()) return false;
+  if (text[pos] == '"') return readString(text, pos, value.text);
+  if (text[pos] == '[') {
+    ++pos;
+    skipSpace(text, pos);
+    if (pos < text.size() && text[pos] == ']') {
+      ++pos;
+      return true;
+    }
+    while (true) {
+      std::string item;
+      skipSpace(text, pos);
+      if (!readString(text, pos, item)) return false;
+      value.items.push_back(std::move(item));
+      skipSpace(text, pos);
+      if (pos >= text.size()) return false;
+      if (text[pos] == ']') {
+        ++pos;
+        return true;
+      }
+      if (text[pos] != ',') return false;
+      ++pos;
+    }
+  }
+  // 数字、true/false/null：按原文保存
+  size_t start = pos;
+  while (pos < text.size() && text[pos] != ',' && text[pos] != '}' &&
+         !std::isspace(static_cast<unsigned char>(text[pos]))) {
+    ++pos;
+  }
+  value.text = text.substr(start, pos - start);
+  return pos > start;
+}
+
+bool JsonReader::readString(const std::string& text, size_t& pos,
+                            std::string& out) {
+  if (pos >= text.size() || text[pos] != '"') return false;
+  ++pos;
+  while (pos < text.size()) {
+    char c = text[pos++];
+    if (c == '"') return true;
+    if (c != '\\') {
+      out += c;
+      continue;
+    }
+    if (pos >= text.size()) return false;
+    char e = text[pos++];
+    if (e == 'n') {
+      out += '\n';
+    } else if (e == 't') {
+      out += '\t';
+    } else if (e == 'r') {
+      out += '\r';
+    } else if (e == 'b') {
+      out += '\b';
+    } else if (e == 'f') {
+      out += '\f';
+    } else if (e == 'u') {
+      if (pos + 4 > text.size()) return false;
+      unsigned long code =
+          std::strtoul(text.substr(pos, 4).c_str(), nullptr, 16);
+      pos += 4;
+      appendUtf8(out, code);
+    } else {
+      out += e;  // \" \\ \/
+    }
+  }
+  return false;
+}
+
+void JsonReader::appendUtf8(std::string& out, unsigned long code) {
+  if (code < 0x80) {
+    out += static_cast<char>(code);
+  } else if (code < 0x800) {
+    out += static_cast<char>(0xC0 | (code >> 6));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    out += static_cast<char>(0xE0 | (code >> 12));
+    out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+int CommandLine::usage(std::ostream& err) {
+  err << "用法:\n"
+      << "  bookkeeping                      进入交互菜单\n"
+      << "  bookkeeping search [--from 日期] [--to 日期] [--min 金额]"
+         " [--max 金额]\n"
+      << "                     [--category 分类ID] [--keyword 关键词]\n"
+      << "                     [--sort amount|time] [--desc]"
+         " [--format csv|json|jsonl]\n"
+      << "  bookkeeping stats [--by type|day|month|year|category|amount]\n"
+      << "                    [--from 日期] [--to 日期]"
+         " [--format csv|json|jsonl]\n"
+      << "                    [--buckets 100,500,1000"
+         " | linear:最小:最大:桶数 | log:最小:最大:桶数]\n"
+      << "                    [--quantiles 桶数]     金额区间的桶划分\n"
+      << "                    [--sketch [--threads N]]  附加支出分位数和"
+         "不同备注、关键词数（近似）\n"
+      << "  bookkeeping balance [--on 日期]              截至某日的余额\n"
+      << "  bookkeeping balance --from 日期 --to 日期     区间净流入\n"
+      << "  bookkeeping balance --by day|month|year [--from 日期]"
+         " [--to 日期]\n"
+      << "                      [--format csv|json|jsonl]  余额走势\n"
+      << "  bookkeeping top categories|transactions|terms [--limit N]"
+         " [--from 日期] [--to 日期]\n"
+      << "                  [--type income|expense]"
+         " [--format csv|json|jsonl]  排行榜\n"
+      << "  bookkeeping budget [status|alerts] [--on 日期]"
+         " [--format csv|json|jsonl]\n"
+      << "                     预算执行情况（alerts 只列出超支的）\n"
+      << "  bookkeeping budget set --category 分类ID --limit 金额"
+         " [--period day|month|year]\n"
+      << "  bookkeeping budget remove --category 分类ID"
+         " [--period day|month|year]\n"
+      << "  bookkeeping recurring add --amount 金额 --start 日期"
+         " --category 分类ID\n"
+      << "                        [--every day|month|year]"
+         " [--type income|expense] [--remarks 备注] [--id ID]\n"
+      << "  bookkeeping recurring remove <ID>\n"
+      << "  bookkeeping recurring list [--format csv|json|jsonl]\n"
+      << "  bookkeeping recurring run [--until 日期]   补记到期的周期交易\n"
+      << "  bookkeeping import <文件>\n"
+      << "  bookkeeping import <文件.csv> [--csv] [--amount-column 列名]"
+         " [--date-column 列名]\n"
+      << "                     [--category-column 列名]"
+         " [--type-column 列名] [--id-column 列名]\n"
+      << "                     [--remarks-column 列名] [--threads N]\n"
+      << "  bookkeeping export [--format csv|json|jsonl] [--output 文件]\n"
+      << "                     [检索条件]      按条件流式导出\n"
+      << "  bookkeeping add --amount 金额 --date 日期 --category 分类ID\n"
+      << "                  [--type income|expense] [--remarks 备注]"
+         " [--id ID]\n"
+      << "  bookkeeping delete <ID>\n"
+      << "  bookkeeping bulk-delete <检索条件>        删除全部命中的交易\n"
+      << "  bookkeeping bulk-update <检索条件> --set-category 分类ID\n"
+      << "                      | --set-remarks 备注 | --append-remarks 备注\n"
+      << "    检索条件同 search: --from --to --min --max --category"
+         " --keyword\n"
+      << "  bookkeeping layout [single|year|month]  查看或切换存储布局"
+         "（按年、按月分区）\n"
+      << "  bookkeeping compress [on|off]        查看或切换分块压缩\n"
+      << "  bookkeeping metrics                  输出埋点指标\n"
+      << "  bookkeeping serve [--socket 路径]       常驻服务模式\n"
+      << "  bookkeeping client [--socket 路径] <子命令> [选项]\n"
+      << "任一子命令加 --metrics 时，结束后把指标输出到标准错误\n";
+  return 1;
+}
+
+bool CommandLine::parseOptions(
+    const std::vector<std::string>& args,
+    std::unordered_map<std::string, std::string>& opts,
+    std::vector<std::string>& positional, std::ostream& err) {
+  for (size_t i = 1; i < args.size(); ++i) {
+    if (args[i].compare(0, 2, "--") != 0) {
+      positional.push_back(args[i]);
+      continue;
+    }
+    std::string name = args[i].substr(2);
+    if (name == "desc" || name == "metrics" || name == "csv" ||
+        name == "sketch") {
+      opts[name] = "1";
+      continue;
+    }
+    if (i + 1 >= args.size()) {
+      err << "选项缺少参数: " << args[i] << '\n';
+      return false;
+    }
+    opts[name] = args[++i];
+  }
+  return true;
+}
+
+bool CommandLine::readDateRange(
+    std::unordered_map<std::string, std::string>& opts,
+    std::vector<std::string>& range, std::ostream& err) {
+  std::string from = opts["from"], to = opts["to"];
+  if ((!from.empty() && !isValidDate(from)) ||
+      (!to.empty() && !isValidDate(to))) {
+    err << "日期格式无效 (YYYY-MM-DD)\n";
+    return false;
+  }
+  range = {from, to};
+  return true;
+}
+
+bool CommandLine::readThreads(
+    std::unordered_map<std::string, std::string>& opts, size_t& threads,
+    std::ostream& err) {
+  threads = 0;
+  if (opts.count("threads") == 0) return true;
+  char* end = nullptr;
+  long count = std::strtol(opts["threads"].c_str(), &end, 10);
+  if (opts["threads"].empty() || *end != '\0' || count < 1) {
+    err << "线程数无效: " << opts["threads"] << '\n';
+    return false;
+  }
+  threads = static_cast<size_t>(count);
+  return true;
+}
+
+bool CommandLine::readAmount(const std::string& text, double& value) {
+  char* end = nullptr;
+  value = std::strtod(text.c_str(), &end);
+  return !text.empty() && *end == '\0' && value >= 0.0;
+}
+
+bool CommandLine::readQuery(std::unordered_map<std::string, std::string>& opts,
+                            SearchQuery& query, std::ostream& err) {
+  std::vector<std::string> dateRange;
+  if (!readDateRange(opts, dateRange, err)) return false;
+
+  std::vector<double> amountRange;
+  if (opts.count("min") || opts.count("max")) {
+    double lo = 0.0, hi = std::numeric_limits<double>::max();
+    if ((opts.count("min") && !readAmount(opts["min"], lo)) ||
+        (opts.count("max") && !readAmount(opts["max"], hi))) {
+      err << "金额无效\n";
+      return false;
+    }
+    amountRange = {lo, hi};
+  }
+
+  query.dateRange = dateRange;
+  query.amountRange = amountRange;
+  query.categoryId = opts["category"];
+  query.keyword = opts["keyword"];
+  return true;
+}
+
+int CommandLine::runSearch(std::unordered_map<std::string, std::string>& opts,
+                           OutputFormat format, std::ostream& out,
+                           std::ostream& err) {
+  SearchQuery query;
+  if (!readQuery(opts, query, err)) return 1;
+  if (opts.count("sort")) {
+    if (opts["sort"] == "amount") {
+      query.sortField = SortField::Amount;
+    } else if (opts["sort"] == "time") {
+      query.sortField = SortField::Time;
+    } else {
+      err << "未知排序字段: " << opts["sort"] << '\n';
+      return 1;
+    }
+    query.sorted = true;
+    query.direction =
+        opts.count("desc") ? SortDirection::Desc : SortDirection::Asc;
+  }
+  QueryCache::TransactionList results = QueryCache::search(query);
+  ReportWriter::writeTransactions(out, *results, format);
+  return 0;
+}
+
+int CommandLine::runStats(std::unordered_map<std::string, std::string>& opts,
+                          OutputFormat format, std::ostream& out,
+                          std::ostream& err) {
+  std::vector<std::string> range;
+  if (!readDateRange(opts, range, err)) return 1;
+
+  std::string by = opts.count("by") ? opts["by"] : "type";
+  StatisticDimension dimension;
+  if (by == "type") {
+    dimension = StatisticDimension::Type;
+  } else if (by == "day") {
+    dimension = StatisticDimension::Day;
+  } else if (by == "month") {
+    dimension = StatisticDimension::Month;
+  } else if (by == "year") {
+    dimension = StatisticDimension::Year;
+  } else if (by == "category") {
+    dimension = StatisticDimension::Category;
+  } else if (by == "amount") {
+    dimension = StatisticDimension::AmountRange;
+  } else {
+    err << "未知统计维度: " << by << '\n';
+    return 1;
+  }
+
+  // 金额区间可自定义桶边界，或按分位数划分
+  AmountHistogram buckets = AmountHistogram::defaults();
+  bool custom = opts.count("buckets") || opts.count("quantiles");
+  if (opts.count("buckets") &&
+      !AmountHistogram::parse(opts["buckets"], buckets)) {
+    err << "桶边界无效: " << opts["buckets"] << '\n';
+    return 1;
+  }
+  if (opts.count("quantiles")) {
+    char* end = nullptr;
+    long count = std::strtol(opts["quantiles"].c_str(), &end, 10);
+    if (opts["quantiles"].empty() || *end != '\0' || count < 1 ||
+        count > 10000) {
+      err << "分位数桶数无效: " << opts["quantiles"] << '\n';
+      return 1;
+    }
+    buckets = StatisticService(Transaction::list())
+                  .quantileHistogram(static_cast<size_t>(count), range);
+  }
+  const AmountHistogram* histogram = custom ? &buckets : nullptr;
+  if (!opts.count("sketch")) {
+    ReportWriter::writeReport(
+        out, *QueryCache::statistic(dimension, range, histogram), format);
+    return 0;
+  }
+  // 带 sketch 的统计不经过查询缓存
+  size_t threads;
+  if (!readThreads(opts, threads, err)) return 1;
+  StatisticService stat(Transaction::list());
+  stat.setSketches(true, threads);
+  ReportWriter::writeReport(out, stat.report(dimension, range, histogram),
+                            format);
+  return 0;
+}
+
+int CommandLine::runTop(const std::string& kind,
+                        std::unordered_map<std::string, std::string>& opts,
+                        OutputFormat format, std::ostream& out,
+                        std::ostream& err) {
+  std::vector<std::string> range;
+  if (!readDateRange(opts, range, err)) return 1;
+  size_t limit = 10;
+  if (opts.count("limit")) {
+    char* end = nullptr;
+    long count = std::strtol(opts["limit"].c_str(), &end, 10);
+    if (opts["limit"].empty() || *end != '\0' || count < 1 ||
+        static_cast<unsigned long>(count) > StatisticService::MAX_RANKING) {
+      err << "数量无效: " << opts["limit"] << '\n';
+      return 1;
+    }
+    limit = static_cast<size_t>(count);
+  }
+  std::string type = opts.count("type") ? opts["type"] : "expense";
+  if (type != "income" && type != "expense") {
+    err << "类型无效: " << type << '\n';
+    return 1;
+  }
+
+  StatisticService stat(Transaction::list());
+  if (kind == "categories") {
+    ReportWriter::writeReport(out, stat.topCategories(limit, range), format);
+  } else if (kind == "transactions") {
+    ReportWriter::writeTransactions(
+        out,
+        stat.topTransactions(limit,
+                             type == "income" ? TransactionType::Income
+                                              : TransactionType::Expense,
+                             range),
+        format);
+  } else if (kind == "terms") {
+    ReportWriter::writeReport(out, stat.topTerms(limit, range), format);
+  } else {
+    err << "未知排行: " << kind << '\n';
+    return 1;
+  }
+  return 0;
+}
+
+int CommandLine::runBalance(std::unordered_map<std::string, std::string>& opts,
+                            OutputFormat format, std::ostream& out,
+                            std::ostream& err) {
+  std::vector<std::string> range;
+  if (!readDateRange(opts, range, err)) return 1;
+  if (!opts["on"].empty() && !isValidDate(opts["on"])) {
+    err << "日期格式无效 (YYYY-MM-DD)\n";
+    return 1;
+  }
+  if (opts.count("by")) {
+    const char* names[] = {"day", "month", "year"};
+    for (int i = 0; i < 3; ++i) {
+      if (opts["by"] != names[i]) continue;
+      ReportWriter::writeBalanceSeries(
+          out,
+          BalanceIndex::series(range[0], range[1],
+                               static_cast<TimeGroup>(i)),
+          format);
+      return 0;
+    }
+    err << "未知统计维度: " << opts["by"] << '\n';
+    return 1;
+  }
+  if (!range[0].empty() || !range[1].empty()) {
+    out << ReportWriter::formatAmount(
+               BalanceIndex::netFlow(range[0], range[1]))
+        << '\n';
+  } else {
+    out << ReportWriter::formatAmount(BalanceIndex::balanceAt(opts["on"]))
+        << '\n';
+  }
+  return 0;
+}
+
+bool CommandLine::readPeriod(const std::string& name, TimeGroup& period) {
+  const char* names[] = {"day", "month", "year"};
+  for (int i = 0; i < 3; ++i) {
+    if (name != names[i]) continue;
+    period = static_cast<TimeGroup>(i);
+    return true;
+  }
+  return false;
+}
+
+int CommandLine::runBudget(const std::string& action,
+                           std::unordered_map<std::string, std::string>& opts,
+                           OutputFormat format, std::ostream& out,
+                           std::ostream& err) {
+  if (action == "status" || action == "alerts") {
+    std::string on = opts["on"].empty() ? currentDate() : opts["on"];
+    if (!isValidDate(on)) {
+      err << "日期格式无效 (YYYY-MM-DD)\n";
+      return 1;
+    }
+    ReportWriter::writeBudgetStatus(out,
+                                    action == "status"
+                                        ? BudgetBook::status(on)
+                                        : BudgetBook::alerts(on),
+                                    format);
+    return 0;
+  }
+  if (action != "set" && action != "remove") {
+    err << "未知预算操作: " << action << '\n';
+    return 1;
+  }
+  TimeGroup period = TimeGroup::Monthly;
+  if (opts.count("period") && !readPeriod(opts["period"], period)) {
+    err << "未知周期: " << opts["period"] << '\n';
+    return 1;
+  }
+  if (action == "set") {
+    double limit = 0.0;
+    if (!readAmount(opts["limit"], limit) || limit == 0.0) {
+      err << "预算金额无效\n";
+      return 1;
+    }
+    if (!BudgetBook::setBudget({opts["category"], period, limit})) {
+      err << "分类不存在: " << opts["category"] << '\n';
+      return 1;
+    }
+  } else if (!BudgetBook::removeBudget(opts["category"], period)) {
+    err << "预算不存在: " << opts["category"] << '\n';
+    return 1;
+  }
+  if (!DataPersistence::saveAll()) {
+    err << "保存失败\n";
+    return 1;
+  }
+  return 0;
+}
+
+int CommandLine::runRecurring(
+    const std::vector<std::string>& positional,
+    std::unordered_map<std::string, std::string>& opts, OutputFormat format,
+    std::ostream& out, std::ostream& err) {
+  const std::string& action = positional[0];
+  if (action == "list" && positional.size() == 1) {
+    ReportWriter::writeTemplates(out, RecurringService::templates(), format);
+    return 0;
+  }
+  if (action == "run" && positional.size() == 1) {
+    std::string until =
+        opts["until"].empty() ? currentDate() : opts["until"];
+    if (!isValidDate(until)) {
+      err << "日期格式无效 (YYYY-MM-DD)\n";
+      return 1;
+    }
+    out << RecurringService::post(until) << '\n';
+    return 0;
+  }
+  if (action == "remove" && positional.size() == 2) {
+    if (!RecurringService::removeTemplate(positional[1])) {
+      err << "模板不存在: " << positional[1] << '\n';
+      return 1;
+    }
+  } else if (action == "add" && positional.size() == 1) {
+    RecurringTemplate tmpl{opts["id"], 0.0, opts["category"],
+                           TransactionType::Expense, TimeGroup::Monthly,
+                           opts["start"], 0, opts["remarks"]};
+    if (!readAmount(opts["amount"], tmpl.amount)) {
+      err << "金额无效\n";
+      return 1;
+    }
+    if (!isValidDate(tmpl.next)) {
+      err << "日期格式无效 (YYYY-MM-DD)\n";
+      return 1;
+    }
+    if (opts.count("every") && !readPeriod(opts["every"], tmpl.every)) {
+      err << "未知周期: " << opts["every"] << '\n';
+      return 1;
+    }
+    std::string type = opts.count("type") ? opts["type"] : "expense";
+    if (type != "income" && type != "expense") {
+      err << "类型无效: " << type << '\n';
+      return 1;
+    }
+    if (type == "income") tmpl.type = TransactionType::Income;
+    if (!RecurringService::addTemplate(tmpl)) {
+      err << "添加失败: 分类不存在或 ID 重复\n";
+      return 1;
+    }
+    out << RecurringService::templates().back().id << '\n';
+  } else {
+    err << "未知周期交易操作: " << action << '\n';
+    return 1;
+  }
+  if (!DataPersistence::saveAll()) {
+    err << "保存失败\n";
+    return 1;
+  }
+  return 0;
+}
+
+int CommandLine::runExport(std::unordered_map<std::string, std::string>& opts,
+                           OutputFormat format, std::ostream& out,
+                           std::ostream& err) {
+  SearchQuery query;
+  if (!readQuery(opts, query, err)) return 1;
+  if (!opts.count("output")) {
+    ReportWriter::exportTransactions(out, query, format);
+    return 0;
+  }
+  std::ofstream file(opts["output"], std::ios::trunc);
+  if (!file.is_open()) {
+    err << "无法写入 " << opts["output"] << '\n';
+    return 1;
+  }
+  ReportWriter::exportTransactions(file, query, format);
+  return file.good() ? 0 : 1;
+}
+
+int CommandLine::runAdd(std::unordered_map<std::string, std::string>& opts,
+                        std::ostream& out, std::ostream& err) {
+  double amount = 0.0;
+  if (!readAmount(opts["amount"], amount)) {
+    err << "金额无效\n";
+    return 1;
+  }
+  if (!isValidDate(opts["date"])) {
+    err << "日期格式无效 (YYYY-MM-DD)\n";
+    return 1;
+  }
+  if (!Category::categoryExists(opts["category"])) {
+    err << "分类不存在: " << opts["category"] << '\n';
+    return 1;
+  }
+  std::string type = opts.count("type") ? opts["type"] : "expense";
+  if (type != "income" && type != "expense") {
+    err << "类型无效: " << type << '\n';
+    return 1;
+  }
+
+  std::string id = opts["id"].empty() ? generateTransactionId() : opts["id"];
+  if (!Transaction::emplaceTransaction(
+          id, amount, std::move(opts["date"]), std::move(opts["category"]),
+          type == "income" ? TransactionType::Income :
+                             TransactionType::Expense,
+          std::move(opts["remarks"]))) {
+    err << "添加失败: ID 重复 " << id << '\n';
+    return 1;
+  }
+  if (!DataPersistence::saveAll()) {
+    err << "保存失败\n";
+    return 1;
+  }
+  out << id << '\n';
+  return 0;
+}
+
+int CommandLine::runLayout(const std::vector<std::string>& positional,
+                           std::ostream& out, std::ostream& err) {
+  const char* names[] = {"single", "year", "month"};
+  if (positional.empty()) {
+    out << names[static_cast<int>(DataPersistence::layout())] << ' '
+        << DataPersistence::partitionCount() << '\n';
+    return 0;
+  }
+  for (int i = 0; i < 3; ++i) {
+    if (positional[0] != names[i]) continue;
+    DataPersistence::setLayout(static_cast<StorageLayout>(i));
+    if (!DataPersistence::saveAll()) {
+      err << "保存失败\n";
+      return 1;
+    }
+    out << names[i] << ' ' << DataPersistence::partitionCount() << '\n';
+    return 0;
+  }
+  err << "未知布局: " << positional[0] << '\n';
+  return 1;
+}
+
+int CommandLine::runCompress(const std::vector<std::string>& positional,
+                             std::ostream& out, std::ostream& err) {
+  if (!positional.empty()) {
+    if (positional[0] != "on" && positional[0] != "off") {
+      err << "未知取值: " << positional[0] << '\n';
+      return 1;
+    }
+    DataPersistence::setCompression(positional[0] == "on");
+    if (!DataPersistence::saveAll()) {
+      err << "保存失败\n";
+      return 1;
+    }
+  }
+  out << (DataPersistence::compressionEnabled() ? "on" : "off") << '\n';
+  return 0;
+}
+
+int CommandLine::runBulkDelete(
+    std::unordered_map<std::string, std::string>& opts, std::ostream& out,
+    std::ostream& err) {
+  SearchQuery query;
+  if (!readQuery(opts, query, err)) return 1;
+  if (SearchFilter(query).matchesAll()) {
+    err << "批量删除至少需要一个检索条件\n";
+    return 1;
+  }
+  out << "已删除 " << BulkEditService::deleteMatching(query) << " 条\n";
+  return 0;
+}
+
+int CommandLine::runBulkUpdate(
+    std::unordered_map<std::string, std::string>& opts, std::ostream& out,
+    std::ostream& err) {
+  SearchQuery query;
+  if (!readQuery(opts, query, err)) return 1;
+  if (SearchFilter(query).matchesAll()) {
+    err << "批量修改至少需要一个检索条件\n";
+    return 1;
+  }
+  bool recategorize = opts.count("set-category") != 0;
+  bool setRemarks = opts.count("set-remarks") != 0;
+  bool appendRemarks = opts.count("append-remarks") != 0;
+  if (recategorize + setRemarks + appendRemarks != 1) {
+    err << "须且只能指定 --set-category、--set-remarks、"
+           "--append-remarks 之一\n";
+    return 1;
+  }
+  size_t count;
+  if (recategorize) {
+    if (!Category::categoryExists(opts["set-category"])) {
+      err << "分类不存在: " << opts["set-category"] << '\n';
+      return 1;
+    }
+    count = BulkEditService::recategorize(query, opts["set-category"]);
+  } else if (setRemarks) {
+    count = BulkEditService::setRemarks(query, opts["set-remarks"]);
+  } else {
+    count = BulkEditService::appendRemarks(query, opts["append-remarks"]);
+  }
+  out << "已修改 " << count << " 条\n";
+  return 0;
+}
+
+int CommandLine::runDelete(const std::string& id, std::ostream& out,
+                           std::ostream& err) {
+  if (!Transaction::deleteTransaction(id)) {
+    err << "交易不存在: " << id << '\n';
+    return 1;
+  }
+  out << id << '\n';
+  return 0;
+}
+
+int CommandLine::runImport(const std::string& path,
+                           std::unordered_map<std::string, std::string>& opts,
+                           std::ostream& out, std::ostream& err) {
+  std::string ext = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+  std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) {
+    return static_cast<char>(std::tolower(c));
+  });
+  ImportResult result;
+  if (ext == ".csv" || opts.count("csv")) {
+    CsvImportOptions options;
+    std::string* columns[] = {&options.idColumn, &options.amountColumn,
+                              &options.dateColumn, &options.categoryColumn,
+                              &options.typeColumn, &options.remarksColumn};
+    const char* names[] = {"id-column", "amount-column", "date-column",
+                           "category-column", "type-column",
+                           "remarks-column"};
+    for (size_t i = 0; i < 6; ++i) {
+      if (opts.count(names[i])) *columns[i] = opts[names[i]];
+    }
+    if (!readThreads(opts, options.threads, err)) return 1;
+    result = ImportService::importCsv(path, options);
+  } else {
+    result = ImportService::importFile(path);
+  }
+  for (size_t i = 0; i < result.errors.size(); ++i) {
+    err << "第 " << result.errors[i].row << " 行: "
+        << result.errors[i].reason << '\n';
+  }
+  if (!result.ok) {
+    err << "导入失败: 无法读取 " << path << " 或保存数据\n";
+    return 1;
+  }
+  out << "导入完成: 成功 " << result.accepted << " 条, 失败 "
+      << result.errors.size() << " 条\n";
+  if (result.categoriesCreated != 0) {
+    out << "新建分类 " << result.categoriesCreated << " 个\n";
+  }
+  return result.errors.empty() ? 0 : 2;
+}
+
+int CommandLine::run(const std::vector<std::string>& args, std::ostream& out,
+                     std::ostream& err) {
+  if (args.empty()) return usage(err);
+  std::unordered_map<std::string, std::string> opts;
+  std::vector<std::string> positional;
+  if (!parseOptions(args, opts, positional, err)) return 1;
+
+  OutputFormat format = OutputFormat::Csv;
+  if (opts.count("format")) {
+    if (opts["format"] == "json") {
+      format = OutputFormat::Json;
+    } else if (opts["format"] == "jsonl") {
+      format = OutputFormat::JsonLines;
+    } else if (opts["format"] != "csv") {
+      err << "未知输出格式: " << opts["format"] << '\n';
+      return 1;
+    }
+  }
+
+  const std::string& command = args[0];
+  // 分区存储只载入了清单时，检索、统计、导出按日期范围载入所需的分区；
+  // 余额从账本开头累计，需要截止日期之前的全部分区
+  std::string from = opts["from"], to = opts["to"];
+  if (command == "balance") {
+    from.clear();
+    if (!opts["on"].empty()) to = opts["on"];
+  }
+  if (isReadOnly(command) && command != "metrics" &&
+      !DataPersistence::loadRange(from, to)) {
+    err << "无法读取数据分区\n";
+    return 1;
+  }
+  int status;
+  if (command == "search") {
+    status = runSearch(opts, format, out, err);
+  } else if (command == "stats") {
+    status = runStats(opts, format, out, err);
+  } else if (command == "export") {
+    status = runExport(opts, format, out, err);
+  } else if (command == "balance") {
+    status = runBalance(opts, format, out, err);
+  } else if (command == "top" && positional.size() == 1) {
+    status = runTop(positional[0], opts, format, out, err);
+  } else if (command == "budget" && positional.size() <= 1) {
+    status = runBudget(positional.empty() ? "status" : positional[0], opts,
+                       format, out, err);
+  } else if (command == "recurring" && !positional.empty()) {
+    status = runRecurring(positional, opts, format, out, err);
+  } else if (command == "import" && positional.size() == 1) {
+    status = runImport(positional[0], opts, out, err);
+  } else if (command == "add") {
+    status = runAdd(opts, out, err);
+  } else if (command == "delete" && positional.size() == 1) {
+    status = runDelete(positional[0], out, err);
+  } else if (command == "layout" && positional.size() <= 1) {
+    status = runLayout(positional, out, err);
+  } else if (command == "compress" && positional.size() <= 1) {
+    status = runCompress(positional, out, err);
+  } else if (command == "bulk-delete") {
+    status = runBulkDelete(opts, out, err);
+  } else if (command == "bulk-update") {
+    status = runBulkUpdate(opts, out, err);
+  } else if (command == "metrics") {
+    Metrics::write(out);
+    status = 0;
+  } else {
+    return usage(err);
+  }
+  if (opts.count("metrics")) Metrics::write(err);
+  return status;
+}
+
+#if !defined(_WIN32) && !defined(_WIN64)
+const char LedgerServer::DEFAULT_SOCKET[] = "bookkeeping.sock";
+std::atomic<bool> LedgerServer::signalled(false);
+
+bool LedgerServer::writeAll(int fd, const std::string& data) {
+  size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = ::send(fd, data.data() + sent, data.size() - sent,
+                       MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    sent += static_cast<size_t>(n);
+  }
+  return true;
+}
+
+void LedgerServer::reapFinished(std::vector<Worker>& workers) {
+  for (size_t i = 0; i < workers.size();) {
+    if (*workers[i].done) {
+      workers[i].thread.join();
+      workers[i] = std::move(workers.back());
+      workers.pop_back();
+    } else {
+      ++i;
+    }
+  }
+}
+
+std::string LedgerServer::response(int status, const std::string& output,
+                                   const std::string& error) {
+  return "{\"status\":" + std::to_string(status) +
+         ",\"output\":" + ReportWriter::jsonString(output) +
+         ",\"error\":" + ReportWriter::jsonString(error) + "}";
+}
+
+void LedgerServer::serveConnection(int fd) {
+  std::string buffer;
+  char chunk[4096];
+  while (!stopRequested()) {
+    pollfd pfd = {fd, POLLIN, 0};
+    if (::poll(&pfd, 1, POLL_INTERVAL_MS) <= 0) continue;
+    ssize_t n = ::read(fd, chunk, sizeof(chunk));
+    if (n <= 0) break;
+    buffer.append(chunk, static_cast<size_t>(n));
+    size_t newline;
+    while ((newline = buffer.find('\n')) != std::string::npos) {
+      std::string reply = handleRequest(buffer.substr(0, newline)) + "\n";
+      buffer.erase(0, newline + 1);
+      if (!writeAll(fd, reply)) {
+        ::close(fd);
+        return;
+      }
+    }
+  }
+  ::close(fd);
+}
+
+std::string LedgerServer::handleRequest(const std::string& line) {
+  std::unordered_map<std::string, JsonValue> request;
+  if (!JsonReader::parseObject(line, request) ||
+      request["args"].items.empty()) {
+    return response(1, "", "请求格式错误\n");
+  }
+  const std::vector<std::string>& args = request["args"].items;
+  if (args[0] == "serve" || args[0] == "client") {
+    return response(1, "", "不支持的子命令: " + args[0] + "\n");
+  }
+
+  std::ostringstream out, err;
+  int status;
+  if (CommandLine::isReadOnly(args[0])) {
+    LedgerLock::ReadGuard guard;
+    status = CommandLine::run(args, out, err);
+  } else {
+    // 整条修改命令（取 ID、写入、保存）在同一把写锁内完成
+    LedgerLock::WriteGuard guard;
+    status = CommandLine::run(args, out, err);
+  }
+  return response(status, out.str(), err.str());
+}
+
+int LedgerServer::run(std::ostream& log) {
+  if (socketPath.size() >= sizeof(sockaddr_un().sun_path)) {
+    log << "套接字路径过长: " << socketPath << '\n';
+    return 1;
+  }
+  int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listenFd < 0) {
+    log << "无法创建套接字\n";
+    return 1;
+  }
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s",
+                socketPath.c_str());
+  ::unlink(socketPath.c_str());
+  if (::bind(listenFd, reinterpret_cast<sockaddr*>(&addr),
+             sizeof(addr)) < 0 ||
+      ::listen(listenFd, 64) < 0) {
+    log << "无法监听 " << socketPath << '\n';
+    ::close(listenFd);
+    return 1;
+  }
+  log << "服务已启动: " << socketPath << std::endl;
+
+  std::vector<Worker> workers;
+  while (!stopRequested()) {
+    pollfd pfd = {listenFd, POLLIN, 0};
+    if (::poll(&pfd, 1, POLL_INTERVAL_MS) <= 0) continue;
+    int fd = ::accept(listenFd, nullptr, nullptr);
+    if (fd < 0) continue;
+    reapFinished(workers);
+    std::shared_ptr<std::atomic<bool>> done =
+        std::make_shared<std::atomic<bool>>(false);
+    workers.push_back(Worker{std::thread([this, fd, done]() {
+      serveConnection(fd);
+      *done = true;
+    }), done});
+  }
+  for (size_t i = 0; i < workers.size(); ++i) workers[i].thread.join();
+  ::close(listenFd);
+  ::unlink(socketPath.c_str());
+  log << "服务已停止\n";
+  return 0;
+}
+
+bool LedgerClient::request(const std::string& socketPath,
+                           const std::vector<std::string>& args,
+                           std::string& reply) {
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) return false;
+  sockaddr_un addr = {};
+  addr.sun_family = AF_UNIX;
+  std::snprintf(addr.sun_path, sizeof(addr.sun_path), "%s",
+                socketPath.c_str());
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+    ::close(fd);
+    return false;
+  }
+  std::string line = "{\"args\":[";
+  for (size_t i = 0; i < args.size(); ++i) {
+    if (i > 0) line += ',';
+    line += ReportWriter::jsonString(args[i]);
+  }
+  line += "]}\n";
+  bool ok = LedgerServer::writeAll(fd, line);
+
+  reply.clear();
+  char chunk[4096];
+  while (ok && reply.find('\n') == std::string::npos) {
+    ssize_t n = ::read(fd, chunk, sizeof(chunk));
+    if (n <= 0) break;
+    reply.append(chunk, static_cast<size_t>(n));
+  }
+  ::close(fd);
+  size_t newline = reply.find('\n');
+  if (newline == std::string::npos) return false;
+  reply.resize(newline);
+  return true;
+}
+
+int LedgerClient::run(const std::vector<std::string>& args, std::ostream& out,
+                      std::ostream& err) {
+  std::string socketPath = LedgerServer::DEFAULT_SOCKET;
+  size_t first = 1;
+  if (args.size() > 2 && args[1] == "--socket") {
+    socketPath = args[2];
+    first = 3;
+  }
+  if (first >= args.size()) return CommandLine::usage(err);
+
+  std::string reply;
+  std::vector<std::string> forwarded(args.begin() + first, args.end());
+  if (!request(socketPath, forwarded, reply)) {
+    err << "无法连接服务: " << socketPath << '\n';
+    return 1;
+  }
+  std::unordered_map<std::string, JsonValue> obj;
+  if (!JsonReader::parseObject(reply, obj)) {
+    err << "服务响应格式错误\n";
+    return 1;
+  }
+  out << obj["output"].text;
+  err << obj["error"].text;
+  return std::atoi(obj["status"].text.c_str());
+}
+#endif
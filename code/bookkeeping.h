@@ -0,0 +1,2134 @@
+// Copyright 2025 user
+// 记账系统核心库：数据模型、持久化、统计检索、导入导出、命令行与服务模式。
+// 应用程序（code.cpp）、单元测试与基准测试都链接同一个库目标。
+// 构造单元测试时定义 UNIT_TEST，saveAll 在未设置测试文件路径时不写盘。
+#ifndef CODE_BOOKKEEPING_H_
+#define CODE_BOOKKEEPING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <limits>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#else
+#include <csignal>
+// 在非 Windows 平台上提供最小兼容定义以避免编译错误
+// 定义 UTF-8 常量（Windows 中 CP_UTF8 = 65001）和空函数签名
+constexpr unsigned int CP_UTF8 = 65001;
+inline void SetConsoleOutputCP(unsigned int) {}
+inline void SetConsoleCP(unsigned int) {}
+#endif
+
+enum class TransactionType { Income, Expense };
+enum class TimeGroup { Daily, Monthly, Yearly };
+// 统计维度，对应命令行 stats --by 的取值
+enum class StatisticDimension { Type, Day, Month, Year, Category, AmountRange };
+enum class SortField { Amount, Time };
+enum class SortDirection { Asc, Desc };
+
+class DataPersistence;
+
+// 批量导入时单行失败的记录
+struct ImportError {
+  size_t row;          // 出错行的位置（批次下标或文件行号）
+  std::string reason;  // 失败原因
+};
+
+// 热路径埋点：按操作统计调用次数、耗时分布、扫描/命中行数、写出字节数
+// 和内存分配次数，以 Prometheus 文本格式输出（见 Metrics::write）。
+// 以 BOOKKEEPING_METRICS 编译时启用（CMake 默认开启）；未定义时 METRICS_* 宏展开为空，
+// 参数也不会求值，不产生任何运行时开销。用法：
+//   METRICS_SCOPE(m, Search);          // 作用域结束时记录一次调用
+//   METRICS_ADD(m, scanned, n);        // scanned、matched、bytes 三种计数
+class Metrics {
+ public:
+  enum Op {
+    LoadAll, SaveAll, Search, ReportByType, ReportByTime, ReportByCategory,
+    ReportByAmountRange, HomePage, Sort, AddTransaction, AddTransactions,
+    DeleteTransaction, UpdateTransaction, AddCategory, DeleteCategory,
+    Compact, ImportCsv, BalanceQuery, Ranking, BudgetQuery, OpCount
+  };
+
+  // 以 Prometheus 文本格式输出全部指标
+  static void write(std::ostream& out);
+
+#ifdef BOOKKEEPING_METRICS
+  // 计时区间：构造时记下时间和本线程的分配次数，析构时汇总到全局
+  class Scope {
+   public:
+    explicit Scope(Op op);
+    ~Scope();
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+    void scanned(size_t n) { rowsScanned += n; }
+    void matched(size_t n) { rowsMatched += n; }
+    void bytes(size_t n) { bytesWritten += n; }
+
+   private:
+    Op op;
+    std::chrono::steady_clock::time_point start;
+    uint64_t allocationsAtStart;
+    size_t rowsScanned = 0;
+    size_t rowsMatched = 0;
+    size_t bytesWritten = 0;
+  };
+
+  static void reset();
+  static uint64_t calls(Op op);
+  // 本线程累计的 operator new 次数
+  static uint64_t& threadAllocations();
+#endif
+};
+
+#ifdef BOOKKEEPING_METRICS
+#define METRICS_SCOPE(var, op) Metrics::Scope var(Metrics::op)
+#define METRICS_ADD(var, counter, n) var.counter(n)
+#else
+#define METRICS_SCOPE(var, op)
+#define METRICS_ADD(var, counter, n) static_cast<void>(0)
+#endif
+
+// 账本读写锁，保护 Transaction::repository 与 Category::categories。
+// 加锁约定：
+//  * 增删改函数（addTransaction、deleteCategory 等）、loadAll 和 saveAll
+//    内部加写锁（saveAll 要清除脏标记）；
+//  * 查询服务（SearchService、StatisticService）、返回副本或布尔值的查询
+//    函数内部加读锁，因此多个查询可以并行，并且不会看到写到一半的数据；
+//  * list()、getRepository()、findCategory() 这类返回引用或指针的访问器
+//    不加锁，多线程下调用方须在使用期间持有 ReadGuard 或 WriteGuard；
+//  * 同一线程可以嵌套加锁，内层为空操作，所以可以用一个 WriteGuard 把多步
+//    修改组合成原子操作；但持有读锁时不能再申请写锁（无法升级，会死锁）。
+// 每次释放最外层写锁都会递增账本版本号，供快照和缓存判断数据是否变化。
+class LedgerLock {
+ public:
+  class ReadGuard {
+   public:
+    // enabled 为 false 时不加锁，供读取不可变快照的服务使用
+    explicit ReadGuard(bool enabled = true)
+        : owns(enabled && readDepth == 0 && writeDepth == 0) {
+      if (owns) {
+        std::lock_guard<std::mutex> gate(turnstile());
+        mutex().lock_shared();
+      }
+      ++readDepth;
+    }
+    ~ReadGuard() {
+      --readDepth;
+      if (owns) mutex().unlock_shared();
+    }
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+   private:
+    bool owns;
+  };
+
+  class WriteGuard {
+   public:
+    WriteGuard() : owns(writeDepth == 0) {
+      if (owns) {
+        std::lock_guard<std::mutex> gate(turnstile());
+        mutex().lock();
+      }
+      ++writeDepth;
+    }
+    ~WriteGuard() {
+      --writeDepth;
+      if (owns) {
+        markModified();
+        mutex().unlock();
+      }
+    }
+    WriteGuard(const WriteGuard&) = delete;
+    WriteGuard& operator=(const WriteGuard&) = delete;
+
+   private:
+    bool owns;
+  };
+
+  // 当前账本版本号，任何修改之后都会变化
+  static uint64_t version() { return counter().load(); }
+  static void markModified() { ++counter(); }
+  // 当前线程是否持有写锁；持有期间的修改要到释放时才反映到版本号上
+  static bool writeHeld() { return writeDepth > 0; }
+
+ private:
+  static std::atomic<uint64_t>& counter() {
+    static std::atomic<uint64_t> instance(0);
+    return instance;
+  }
+  static std::shared_mutex& mutex() {
+    static std::shared_mutex instance;
+    return instance;
+  }
+  // std::shared_mutex 在 glibc 上偏向读者，连续的查询会让写者一直等待。
+  // 写者在等待期间占住这道闸门，新的读者只能排在它后面
+  static std::mutex& turnstile() {
+    static std::mutex instance;
+    return instance;
+  }
+  static thread_local int readDepth;
+  static thread_local int writeDepth;
+};
+
+// 交易和分类的 ID。ID 都很短（"T1000"、"c100"），直接内联存放在两个
+// 机器字中，不足 MAX_LENGTH 的部分补 0：比较只需两次整数比较，哈希由两个
+// 字混合得到，无需逐字符遍历，也没有堆分配。
+// 超过 MAX_LENGTH 或含 '\0' 的文本无法表示，构造出的 ID 为无效（valid()
+// 为 false），交易和分类的合法性检查会拒绝它
+class LedgerId {
+ public:
+  static constexpr size_t MAX_LENGTH = 16;
+
+  LedgerId() = default;
+  // 允许由字符串隐式转换，便于沿用以字符串传 ID 的接口
+  LedgerId(std::string_view text) {
+    if (text.size() > MAX_LENGTH ||
+        std::memchr(text.data(), '\0', text.size()) != nullptr) {
+      words[1] = INVALID;
+    } else {
+      std::memcpy(words, text.data(), text.size());
+    }
+  }
+  LedgerId(const std::string& text) : LedgerId(std::string_view(text)) {}
+  LedgerId(const char* text) : LedgerId(std::string_view(text)) {}
+
+  bool empty() const { return words[0] == 0 && words[1] == 0; }
+  bool valid() const { return words[0] != 0 || words[1] == 0; }
+  size_t size() const {
+    const char* p = chars();
+    const void* end = std::memchr(p, '\0', MAX_LENGTH);
+    return end ? static_cast<const char*>(end) - p : MAX_LENGTH;
+  }
+  std::string_view view() const {
+    return valid() ? std::string_view(chars(), size()) : std::string_view();
+  }
+  std::string str() const { return std::string(view()); }
+
+  size_t hash() const {
+    uint64_t h = (words[0] ^ (words[1] * 0x9E3779B97F4A7C15ULL)) *
+                 0xBF58476D1CE4E5B9ULL;
+    return static_cast<size_t>(h ^ (h >> 31));
+  }
+
+  friend bool operator==(const LedgerId& a, const LedgerId& b) {
+    return a.words[0] == b.words[0] && a.words[1] == b.words[1];
+  }
+  friend bool operator!=(const LedgerId& a, const LedgerId& b) {
+    return !(a == b);
+  }
+  friend std::ostream& operator<<(std::ostream& out, const LedgerId& id) {
+    return out << id.view();
+  }
+
+ private:
+  // 合法 ID 的首字节为 0 时其余字节必为 0，借此表示无效 ID
+  static constexpr uint64_t INVALID = ~uint64_t(0);
+
+  const char* chars() const { return reinterpret_cast<const char*>(words); }
+
+  uint64_t words[2] = {0, 0};
+};
+
+namespace std {
+template <>
+struct hash<LedgerId> {
+  size_t operator()(const LedgerId& id) const { return id.hash(); }
+};
+}  // namespace std
+
+// 交易 ID（T1000 起）与分类 ID（c100 起）的分配器。每种 ID 维护一个只增
+// 不减的高水位（下一个未分配的编号），为原子变量，可以无锁地一次取走一段
+// 连续编号，供批量导入和多线程写入使用。
+// 高水位由 saveAll 写入数据文件的 [HEADER] 段、loadAll 读回，启动时无需
+// 扫描仓库，删除过的编号也不会再次分配。以其他途径进入仓库的 ID（命令行
+// --id、导入文件、旧格式的数据文件）经 observe 抬高水位，不会与之后分配的
+// 编号冲突
+class IdAllocator {
+ public:
+  enum Kind { TransactionIds, CategoryIds, KindCount };
+
+  // 预留 n 个连续编号，返回第一个
+  static int64_t reserve(Kind kind, size_t n) {
+    return counters[kind].fetch_add(static_cast<int64_t>(n));
+  }
+  static std::string next(Kind kind) { return format(kind, reserve(kind, 1)); }
+  static std::string format(Kind kind, int64_t number) {
+    return PREFIX[kind] + std::to_string(number);
+  }
+
+  // 下一个未分配的编号
+  static int64_t highWater(Kind kind) { return counters[kind].load(); }
+  // 把高水位抬高到至少 next，不会降低
+  static void raise(Kind kind, int64_t next) {
+    int64_t current = counters[kind].load();
+    while (current < next &&
+           !counters[kind].compare_exchange_weak(current, next)) {
+    }
+  }
+  // 形如前缀加十进制数字的 ID 抬高水位，其余格式忽略
+  static void observe(Kind kind, const LedgerId& id) {
+    int64_t number = 0;
+    if (parse(kind, id.view(), number)) raise(kind, number + 1);
+  }
+  static bool parse(Kind kind, std::string_view text, int64_t& number) {
+    if (text.size() < 2 || text[0] != PREFIX[kind]) return false;
+    const char* end = text.data() + text.size();
+    std::from_chars_result r = std::from_chars(text.data() + 1, end, number);
+    return r.ec == std::errc() && r.ptr == end && number >= 0;
+  }
+
+  // 恢复初始编号，用于测试中模拟重新启动
+  static void reset() {
+    for (int k = 0; k < KindCount; ++k) counters[k].store(FIRST[k]);
+  }
+
+  static const char PREFIX[KindCount];
+  static const int64_t FIRST[KindCount];
+
+ private:
+  static std::atomic<int64_t> counters[KindCount];
+};
+
+// 分类类
+class Category {
+ public:
+  Category(LedgerId id, std::string name)
+      : categoryId(id), categoryName(std::move(name)) {}
+
+  // 返回全部分类的副本；只需遍历时用 forEachCategory，不复制
+  static std::vector<Category> getCategoryList() {
+    LedgerLock::ReadGuard guard;
+    return categories;
+  }
+
+  // 在读锁下依次以常量引用访问每个分类。fn 中不能修改分类
+  template <typename Fn>
+  static void forEachCategory(Fn&& fn) {
+    LedgerLock::ReadGuard guard;
+    for (size_t i = 0; i < categories.size(); ++i) fn(categories[i]);
+  }
+
+  static bool addCategory(const Category& category) {
+    return emplaceCategory(category);
+  }
+  static bool addCategory(Category&& category) {
+    return emplaceCategory(std::move(category));
+  }
+
+  // 以 args 在仓库末尾原地构造分类，ID 为空或重复时撤销并返回 false
+  template <typename... Args>
+  static bool emplaceCategory(Args&&... args) {
+    METRICS_SCOPE(m, AddCategory);
+    LedgerLock::WriteGuard guard;
+    categories.emplace_back(std::forward<Args>(args)...);
+    const LedgerId& id = categories.back().categoryId;
+    bool ok = !id.empty() && id.valid();
+    METRICS_ADD(m, scanned, categories.size() - 1);
+    for (size_t i = 0; ok && i + 1 < categories.size(); ++i) {
+      if (categories[i].categoryId == id) ok = false;
+    }
+    if (!ok) {
+      categories.pop_back();
+      return false;
+    }
+    IdAllocator::observe(IdAllocator::CategoryIds, id);
+    METRICS_ADD(m, matched, 1);
+    return true;
+  }
+
+  static bool deleteCategory(const LedgerId& id) {
+    METRICS_SCOPE(m, DeleteCategory);
+    LedgerLock::WriteGuard guard;
+    METRICS_ADD(m, scanned, categories.size());
+    for (size_t i = 0; i < categories.size(); ++i) {
+      if (categories[i].categoryId == id) {
+        METRICS_ADD(m, matched, 1);
+        categories.erase(
+            categories.begin() + static_cast<std::ptrdiff_t>(i));
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static bool categoryExists(const LedgerId& id) {
+    LedgerLock::ReadGuard guard;
+    for (size_t i = 0; i < categories.size(); ++i) {
+      if (categories[i].categoryId == id) return true;
+    }
+    return false;
+  }
+
+  // 返回指向仓库内部的指针，多线程下须持有 LedgerLock
+  static Category* findCategory(const LedgerId& id) {
+    for (size_t i = 0; i < categories.size(); ++i) {
+      if (categories[i].categoryId == id) return &categories[i];
+    }
+    return nullptr;
+  }
+
+  const LedgerId& getId() const { return categoryId; }
+  const std::string& getName() const { return categoryName; }
+
+ private:
+  LedgerId categoryId;
+  std::string categoryName;
+  static std::vector<Category> categories;
+};
+
+// 自上次保存以来有改动的交易日期，精确到月（日期的前 7 个字符）。
+// 分区存储据此只重写有改动的分区；经 getRepository() 直接修改时无法
+// 得知改了哪些行，记为全部有改动。只在写锁下修改和读取
+class DirtyTracker {
+ public:
+  static void mark(std::string_view date) {
+    if (paused || all) return;
+    std::string_view month = date.substr(0, 7);
+    if (month == last) return;  // 批量写入时相邻行多为同一个月
+    last.assign(month.data(), month.size());
+    months.insert(last);
+  }
+  static void markAll() {
+    if (!paused) all = true;
+  }
+  static bool allDirty() { return all; }
+  static const std::unordered_set<std::string>& dirtyMonths() {
+    return months;
+  }
+  static void clear() {
+    all = false;
+    months.clear();
+    last.clear();
+  }
+
+  // 从磁盘载入数据期间不记录，载入的行与文件内容一致
+  class Pause {
+   public:
+    Pause() : previous(paused) { paused = true; }
+    ~Pause() { paused = previous; }
+    Pause(const Pause&) = delete;
+    Pause& operator=(const Pause&) = delete;
+
+   private:
+    bool previous;
+  };
+
+ private:
+  static std::unordered_set<std::string> months;
+  static std::string last;
+  static bool all;
+  static bool paused;
+};
+
+// 余额曲线上的一点：周期（格式同 reportByTime 的键）及周期末的余额
+struct BalancePoint {
+  std::string period;
+  double balance;
+};
+
+// 按日期的累计余额索引：以天为下标的树状数组（Fenwick tree），每一项为
+// 当天收入减支出的合计，因此任意日期的余额（截至当天的前缀和）和两个
+// 日期之间的净流入都只需 O(log n)，不再扫描账本。日期按字符串比较，与
+// 统计、检索的日期范围一致；isValidDate 不接受的日期另存在一张有序表中，
+// 查询时逐项比较（这类行极少）。
+// 交易增删改时由 Transaction 在写锁下增量维护；经 getRepository() 直接
+// 修改后失效，下次查询时在读锁下整体重建（重建之间以互斥量串行）
+class BalanceIndex {
+ public:
+  // 下标覆盖的日期范围，与 isValidDate 相同
+  static constexpr int FIRST_YEAR = 1900;
+  static constexpr int LAST_YEAR = 2100;
+
+  // 截至 date（含当天）的余额；date 为空串时为全部交易的余额
+  static double balanceAt(const std::string& date);
+  // [from, to] 内的收入减支出，空串表示不限
+  static double netFlow(const std::string& from, const std::string& to);
+  // 余额曲线：[from, to] 内每个周期末的余额，from、to 为空时取账本中
+  // 最早、最晚的合法日期。日期不合法时返回空
+  static std::vector<BalancePoint> series(const std::string& from,
+                                          const std::string& to,
+                                          TimeGroup group);
+
+  // 以下由 Transaction 在写锁下调用：某一天的余额变化 delta
+  static void record(std::string_view date, double delta) {
+    if (valid.load(std::memory_order_relaxed)) apply(date, delta, 1);
+  }
+  static void remove(std::string_view date, double delta) {
+    if (valid.load(std::memory_order_relaxed)) apply(date, -delta, -1);
+  }
+  static void invalidate() { valid.store(false); }
+
+ private:
+  // 以下须持有读锁或写锁。ensureBuilt 返回重建时扫描的行数
+  static size_t ensureBuilt();
+  static void apply(std::string_view date, double delta, int64_t count);
+  // 日期字符串不大于 date（inclusive 为 false 时小于）的天数
+  static size_t daysUpTo(std::string_view date, bool inclusive);
+  static double sumUpTo(std::string_view date, bool inclusive);
+  // 无合法日期的交易中日期字符串不大于（小于）date 的合计，all 时不比较
+  static double undatedUpTo(std::string_view date, bool inclusive, bool all);
+  // 前 days 天的金额合计与交易笔数
+  static double prefix(size_t days);
+  static int64_t countPrefix(size_t days);
+  // 第 rank 笔（从 1 起）有合法日期的交易所在的天（下标从 1 起）
+  static size_t dayOfRank(int64_t rank);
+
+  static std::vector<double> amounts;  // 树状数组，下标从 1 起
+  static std::vector<int64_t> counts;  // 每天的交易笔数，同上
+  static std::map<std::string, std::pair<double, int64_t>> undated;
+  static std::atomic<bool> valid;
+  static std::mutex buildMutex;
+};
+
+// 预算：某分类在每个周期（日、月、年）内的支出上限。同一分类的同一
+// 周期只有一项预算
+struct Budget {
+  LedgerId categoryId;
+  TimeGroup period;
+  double limit;
+};
+
+// 预算在某个周期内的执行情况
+struct BudgetStatus {
+  Budget budget;
+  std::string periodKey;  // 所在周期，格式同 reportByTime 的键
+  double spent;           // 该周期内该分类的支出合计
+
+  double remaining() const { return budget.limit - spent; }
+  bool overLimit() const { return spent > budget.limit; }
+};
+
+// 预算及其消耗。每项预算按周期键（日期的前 10、7、4 个字符）累计所属
+// 分类的支出，交易增删改时由 Transaction 在写锁下增量维护，因此首页的
+// 预算状态和超支提醒只需 O(预算数) 次查表，不再按分类统计整个账本。
+// 与 BalanceIndex 相同：经 getRepository() 直接修改或新增预算后失效，
+// 下次查询时在读锁下扫描一遍重建（重建之间以互斥量串行）。
+// 预算本身受 LedgerLock 保护，随数据文件的 [BUDGETS] 段保存
+class BudgetBook {
+ public:
+  // 新增预算，或修改已有 (分类, 周期) 预算的上限。上限须为正数，分类须
+  // 存在（载入数据文件时分类总在预算之前）
+  static bool setBudget(const Budget& budget);
+  static bool removeBudget(const LedgerId& categoryId, TimeGroup period);
+  // 全部预算的副本，按设置的先后顺序
+  static std::vector<Budget> budgets();
+  // 清空全部预算，用于测试
+  static void clear();
+
+  // date 所在周期内每项预算的执行情况，顺序同 budgets()。O(预算数)
+  static std::vector<BudgetStatus> status(const std::string& date);
+  // 只返回已超支的预算
+  static std::vector<BudgetStatus> alerts(const std::string& date);
+  // 周期键：日期的前 10、7、4 个字符
+  static std::string_view periodKey(std::string_view date, TimeGroup period) {
+    size_t length = period == TimeGroup::Monthly ? 7 :
+                    period == TimeGroup::Yearly ? 4 : 10;
+    return date.substr(0, std::min(length, date.size()));
+  }
+
+  // 以下由 Transaction 在写锁下调用：一笔交易计入或移出。只有支出计入
+  static void record(const LedgerId& categoryId, TransactionType type,
+                     std::string_view date, double amount) {
+    if (type == TransactionType::Expense &&
+        valid.load(std::memory_order_relaxed)) {
+      apply(categoryId, date, amount);
+    }
+  }
+  static void remove(const LedgerId& categoryId, TransactionType type,
+                     std::string_view date, double amount) {
+    record(categoryId, type, date, -amount);
+  }
+  static void invalidate() { valid.store(false); }
+
+ private:
+  struct Entry {
+    Budget budget;
+    std::unordered_map<std::string, double> spent;  // 周期键到支出合计
+  };
+
+  // 以下须持有读锁或写锁。ensureBuilt 返回重建时扫描的行数
+  static size_t ensureBuilt();
+  static void apply(const LedgerId& categoryId, std::string_view date,
+                    double amount);
+  static BudgetStatus statusOf(const Entry& entry, std::string_view date);
+
+  static std::vector<Entry> entries;
+  static std::atomic<bool> valid;
+  static std::mutex buildMutex;
+};
+
+// 从数据文件载入的备注文本的存放区：按块追加、只增不减，已分配的块不
+// 搬移，因此指向其中的视图在进程结束前一直有效。被修改或删除的行留下的
+// 文本也一直保留（与映射整个数据文件相同），换来载入时不必逐行分配。
+// 只在持有写锁时追加
+class RemarkArena {
+ public:
+  static constexpr size_t BLOCK_SIZE = 1 << 20;
+  // 将文件中的原始字段（含转义）反转义后存入，返回存放后的文本
+  static std::string_view store(std::string_view raw);
+  // 原样存入已反转义的文本
+  static std::string_view copy(std::string_view text);
+  // 已分配的字节数
+  static size_t capacity() { return allocated; }
+
+ private:
+  // 在最后一块中留出 size 字节，不够时新开一块
+  static char* reserve(size_t size);
+
+  static std::vector<std::unique_ptr<char[]>> blocks;
+  static size_t used;       // 最后一块已用的字节数
+  static size_t blockSize;  // 最后一块的大小
+  static size_t allocated;
+};
+
+// 交易备注。新建或修改的备注持有自己的字符串；载入的备注只是指向
+// RemarkArena 的视图，不单独占用堆内存，复制时也只复制指针
+class Remarks {
+ public:
+  Remarks() = default;
+  explicit Remarks(std::string text) : owned(std::move(text)) {}
+  static Remarks pooled(std::string_view text) {
+    Remarks r;
+    if (!text.empty()) {
+      r.data = text.data();
+      r.size = text.size();
+    }
+    return r;
+  }
+
+  std::string_view view() const {
+    return data != nullptr ? std::string_view(data, size)
+                           : std::string_view(owned);
+  }
+  bool isPooled() const { return data != nullptr; }
+  // 持有的字符串；载入的备注为空串
+  const std::string& ownedText() const { return owned; }
+
+ private:
+  std::string owned;
+  const char* data = nullptr;
+  size_t size = 0;
+};
+
+// 交易类
+class Transaction {
+ public:
+  Transaction()
+      : amount(0.0), transactionTime(""),
+        transactionType(TransactionType::Expense) {}
+  // 字符串参数按值传入后移动到成员，传右值时不复制
+  Transaction(LedgerId id, double amt, std::string time, LedgerId cId,
+              TransactionType type, std::string rem = std::string())
+      : transactionId(id), amount(amt), transactionTime(std::move(time)),
+        categoryId(cId), remarks(std::move(rem)), transactionType(type) {}
+  // 载入数据文件时使用，备注指向 RemarkArena
+  Transaction(LedgerId id, double amt, std::string time, LedgerId cId,
+              TransactionType type, Remarks rem)
+      : transactionId(id), amount(amt), transactionTime(std::move(time)),
+        categoryId(cId), remarks(std::move(rem)), transactionType(type) {}
+
+  static bool addTransaction(const Transaction& t);
+  static bool addTransaction(Transaction&& t);
+  // 以 args 在仓库末尾原地构造交易（参数同构造函数），不合法或 ID 重复时
+  // 撤销并返回 false
+  template <typename... Args>
+  static bool emplaceTransaction(Args&&... args) {
+    METRICS_SCOPE(m, AddTransaction);
+    LedgerLock::WriteGuard guard;
+    ensureRowIndex();
+    repository.emplace_back(std::forward<Args>(args)...);
+    const Transaction& t = repository.back();
+    if (!validateTransaction(t) || rowIndex.count(t.transactionId)) {
+      repository.pop_back();
+      return false;
+    }
+    rowIndex.emplace(t.transactionId, repository.size() - 1);
+    IdAllocator::observe(IdAllocator::TransactionIds, t.transactionId);
+    DirtyTracker::mark(t.transactionTime);
+    indexRow(t);
+    METRICS_ADD(m, matched, 1);
+    return true;
+  }
+  // 批量添加：整批统一做合法性、ID 查重和分类引用检查，合格的行一次性
+  // 追加到仓库（会移走 batch 中对应的元素）；不合格的行记录在 errors
+  // 中（row 为批次下标），不影响其余行。返回成功添加的条数
+  static size_t addTransactions(std::vector<Transaction>& batch,
+                                std::vector<ImportError>& errors);
+  static bool deleteTransaction(const LedgerId& id);
+  // 批量删除：每个 ID 经哈希索引定位并打上删除标记，整批只保存一次。
+  // 返回实际删除的条数
+  static size_t deleteTransactions(const std::vector<LedgerId>& ids);
+  // 按谓词批量删除：在同一把写锁内扫描一遍，给 pred(const Transaction&)
+  // 为真的行打删除标记，最后统一检查压缩并只保存一次。返回删除的条数
+  template <typename Pred>
+  static size_t deleteWhere(Pred pred) {
+    METRICS_SCOPE(m, DeleteTransaction);
+    LedgerLock::WriteGuard guard;
+    METRICS_ADD(m, scanned, repository.size());
+    ensureRowIndex();
+    size_t count = 0;
+    for (size_t i = 0; i < repository.size(); ++i) {
+      if (isDeleted(i) || !pred(std::as_const(repository[i]))) continue;
+      rowIndex.erase(repository[i].transactionId);
+      markDeletedRow(i);
+      ++count;
+    }
+    METRICS_ADD(m, matched, count);
+    return finishBatch(count);
+  }
+  // 按谓词批量修改：对命中的每一行调用 edit(Transaction&) 原地修改，整批
+  // 只保存一次。ID 由索引定位，不允许修改，edit 改动的 ID 会被还原；
+  // 其余字段由 edit 保证仍然合法。返回修改的条数
+  template <typename Pred, typename Edit>
+  static size_t updateWhere(Pred pred, Edit edit) {
+    METRICS_SCOPE(m, UpdateTransaction);
+    LedgerLock::WriteGuard guard;
+    METRICS_ADD(m, scanned, repository.size());
+    size_t count = 0;
+    for (size_t i = 0; i < repository.size(); ++i) {
+      if (isDeleted(i) || !pred(std::as_const(repository[i]))) continue;
+      Transaction& tx = repository[i];
+      const LedgerId id = tx.transactionId;
+      DirtyTracker::mark(tx.transactionTime);
+      unindexRow(tx);
+      edit(tx);
+      tx.transactionId = id;
+      DirtyTracker::mark(tx.transactionTime);
+      indexRow(tx);
+      ++count;
+    }
+    METRICS_ADD(m, matched, count);
+    return finishBatch(count);
+  }
+
+  // 删除只在原位打标记（逻辑删除）：该行内容被清空、ID 置空，并在删除
+  // 位图中置位，其余行的位置不变，因此行号和 ID 索引在压缩前一直有效。
+  // 已删除的行超过 COMPACT_THRESHOLD 时自动压缩，整体搬移一次
+  static constexpr double COMPACT_THRESHOLD = 0.25;
+  static bool isDeleted(size_t row) { return isDeleted(&deadBits, row); }
+  static bool isDeleted(const std::vector<uint64_t>* mask, size_t row) {
+    return mask != nullptr && (row >> 6) < mask->size() &&
+           (((*mask)[row >> 6] >> (row & 63)) & 1) != 0;
+  }
+  // rows 为仓库本身时返回其删除位图，否则（快照、检索结果等不含已删除
+  // 行的向量）返回 nullptr。查询服务据此决定扫描时是否跳过已删除的行
+  static const std::vector<uint64_t>* deletedMask(
+      const std::vector<Transaction>& rows) {
+    return &rows == &repository ? &deadBits : nullptr;
+  }
+  static size_t deletedCount() { return deadRows; }
+  static size_t liveCount() { return repository.size() - deadRows; }
+  // 立即移除全部已删除的行并重建索引
+  static void compact();
+
+  static bool validateTransaction(const Transaction& t) {
+    return !t.transactionId.empty() && t.transactionId.valid() &&
+           t.amount >= 0.0;
+  }
+
+  static bool categoryHasTransactions(const LedgerId& cId) {
+    LedgerLock::ReadGuard guard;
+    for (size_t i = 0; i < repository.size(); ++i) {
+      if (repository[i].categoryId == cId) return true;
+    }
+    return false;
+  }
+
+  std::string getTransactionDetail() const {
+    LedgerLock::ReadGuard guard;
+    std::string detail = "交易[" + transactionId.str() + "] 金额=" +
+                        std::to_string(amount) + ", 时间=" + transactionTime +
+                        ", 分类=";
+    Category* cat = Category::findCategory(categoryId);
+    if (cat) {
+      detail += cat->getName() + "(" + categoryId.str() + ")";
+    } else {
+      detail += categoryId.view();
+    }
+    detail += ", 类型=" + std::string(transactionType ==
+              TransactionType::Income ? "收入" : "支出") +
+              ", 备注=";
+    detail += remarks.view();
+    return detail;
+  }
+
+  bool updateTransaction() {
+    METRICS_SCOPE(m, UpdateTransaction);
+    LedgerLock::WriteGuard guard;
+    ensureRowIndex();
+    auto row = rowIndex.find(transactionId);
+    if (row == rowIndex.end()) return false;
+    METRICS_ADD(m, matched, 1);
+    Transaction& old = repository[row->second];
+    DirtyTracker::mark(old.transactionTime);
+    DirtyTracker::mark(transactionTime);
+    unindexRow(old);
+    indexRow(*this);
+    old = *this;
+    return true;
+  }
+
+  void setId(LedgerId id) { transactionId = id; }
+  void setAmount(double amt) { amount = amt; }
+  void setTime(std::string time) { transactionTime = std::move(time); }
+  void setCategoryId(LedgerId cId) { categoryId = cId; }
+  void setRemarks(std::string rem) { remarks = Remarks(std::move(rem)); }
+  void setRemarks(Remarks rem) { remarks = std::move(rem); }
+  void setType(TransactionType type) { transactionType = type; }
+
+  const LedgerId& getId() const { return transactionId; }
+  double getAmount() const { return amount; }
+  const std::string& getTime() const { return transactionTime; }
+  const LedgerId& getCategoryId() const { return categoryId; }
+  std::string_view getRemarks() const { return remarks.view(); }
+  const Remarks& getRemarkStorage() const { return remarks; }
+  TransactionType getType() const { return transactionType; }
+  // 对余额的影响：收入为正，支出为负
+  double signedAmount() const {
+    return transactionType == TransactionType::Income ? amount : -amount;
+  }
+
+  // 直接访问仓库，多线程下须持有 LedgerLock（见其加锁约定）。
+  // list() 含尚未压缩的已删除行（ID 为空），按下标遍历时用 isDeleted 跳过。
+  // getRepository() 返回可写引用，调用即视为一次修改（递增账本版本号，
+  // 分区存储下下次保存重写全部已载入的分区）：
+  // 调用前先压缩，调用后 ID 索引失效、在下次使用时重建，因此通过它直接
+  // 增删改不会破坏删除标记和索引
+  static const std::vector<Transaction>& list() { return repository; }
+  static std::vector<Transaction>& getRepository() {
+    LedgerLock::markModified();
+    DirtyTracker::markAll();
+    BalanceIndex::invalidate();
+    BudgetBook::invalidate();
+    if (deadRows != 0) compact();
+    rowIndexValid = false;
+    return repository;
+  }
+
+ private:
+  // ID 到行号的索引，只在写锁下使用；失效后在下次使用时整体重建
+  static void ensureRowIndex();
+  // 给 ID 对应的行打删除标记，不保存、不压缩
+  static bool markDeleted(const LedgerId& id);
+  // 清空第 row 行并在位图中置位；调用方负责移除该行的索引项
+  static void markDeletedRow(size_t row);
+  // 批量修改的收尾：有改动时检查压缩并保存一次，返回 count
+  static size_t finishBatch(size_t count);
+  static void compactIfNeeded() {
+    if (deadRows > repository.size() * COMPACT_THRESHOLD) compact();
+  }
+  // 一行计入或移出增量维护的余额索引和预算消耗，须持有写锁
+  static void indexRow(const Transaction& tx) {
+    BalanceIndex::record(tx.transactionTime, tx.signedAmount());
+    BudgetBook::record(tx.categoryId, tx.transactionType, tx.transactionTime,
+                       tx.amount);
+  }
+  static void unindexRow(const Transaction& tx) {
+    BalanceIndex::remove(tx.transactionTime, tx.signedAmount());
+    BudgetBook::remove(tx.categoryId, tx.transactionType, tx.transactionTime,
+                       tx.amount);
+  }
+
+  LedgerId transactionId;
+  double amount;
+  std::string transactionTime;
+  LedgerId categoryId;
+  Remarks remarks;
+  TransactionType transactionType;
+  static std::vector<Transaction> repository;
+  static std::vector<uint64_t> deadBits;  // 删除位图，第 i 位对应第 i 行
+  static size_t deadRows;
+  static std::unordered_map<LedgerId, size_t> rowIndex;
+  static bool rowIndexValid;
+};
+
+// 账本快照：某一版本交易与分类数据的不可变视图，按引用计数共享。
+// 同一版本的快照共享同一份数据；最新版本的数据由缓存持有，更早的版本在
+// 最后一个持有者释放后回收。基于快照构造的查询服务不再加账本锁，
+// 因此长时间的报表既能看到一致的数据，也不会阻塞并发的修改
+class LedgerSnapshot {
+ public:
+  LedgerSnapshot() = default;
+
+  // 获取当前版本的快照：版本未变时直接共享缓存，否则在读锁下复制一份
+  static LedgerSnapshot current();
+
+  bool valid() const { return data != nullptr; }
+  uint64_t version() const { return data ? data->version : 0; }
+  const std::vector<Transaction>& transactions() const {
+    return data ? data->transactions : empty().transactions;
+  }
+  const std::vector<Category>& categories() const {
+    return data ? data->categories : empty().categories;
+  }
+
+ private:
+  struct Data {
+    uint64_t version = 0;
+    std::vector<Transaction> transactions;
+    std::vector<Category> categories;
+  };
+
+  explicit LedgerSnapshot(std::shared_ptr<const Data> d) : data(std::move(d)) {}
+
+  static const Data& empty() {
+    static const Data instance;
+    return instance;
+  }
+
+  std::shared_ptr<const Data> data;
+  static std::mutex cacheMutex;
+  static std::shared_ptr<const Data> cache;
+};
+
+
+// 近似分位数（t-digest）：数据压缩成至多约 compression 个加权质心，
+// 靠近两端的质心更小，尾部分位数更准。新值先进缓冲区，攒满后排序并入质心。
+// 可合并：各分段、各分区分别累加后合并，精度与顺序累加相当
+class QuantileSketch {
+ public:
+  static constexpr double DEFAULT_COMPRESSION = 200.0;
+
+  explicit QuantileSketch(double compression = DEFAULT_COMPRESSION)
+      : compression(compression) {}
+
+  void add(double value) {
+    buffer.push_back({value, 1.0});
+    weight += 1.0;
+    min = std::min(min, value);
+    max = std::max(max, value);
+    if (buffer.size() >= 5 * compression) flush();
+  }
+  void merge(const QuantileSketch& other);
+  // 缓冲区并入质心，并释放缓冲区
+  void flush();
+
+  // q 取 0~1，没有数据时返回 0
+  double quantile(double q) const;
+  double count() const { return weight; }
+  size_t centroidCount() const { return centroids.size(); }
+
+ private:
+  struct Centroid {
+    double mean;
+    double weight;
+  };
+  double compression;
+  double weight = 0.0;
+  double min = std::numeric_limits<double>::infinity();
+  double max = -std::numeric_limits<double>::infinity();
+  std::vector<Centroid> centroids;  // 按 mean 升序
+  std::vector<Centroid> buffer;
+};
+
+// 基数估计（HyperLogLog）：2^PRECISION 个寄存器，标准误差约 1.6%。
+// 合并即逐个寄存器取最大值。寄存器在第一次 add 时才分配
+class DistinctSketch {
+ public:
+  static constexpr int PRECISION = 12;
+
+  void add(std::string_view item);
+  void merge(const DistinctSketch& other);
+  double estimate() const;
+
+ private:
+  std::vector<uint8_t> registers;
+};
+
+// 一个统计分组的近似聚合：支出金额的分位数、不同备注数、
+// 备注中不同关键词（按空白和标点切分）数
+struct GroupSketch {
+  QuantileSketch expenses;
+  DistinctSketch remarks;
+  DistinctSketch keywords;
+
+  void add(const Transaction& tx);
+  void merge(const GroupSketch& other);
+};
+
+// 有界堆：只保留 greater 意义下最大的 limit 个元素。堆顶是当前的第 limit 名，
+// 新元素不比堆顶大时直接丢弃，否则替换堆顶，每次 push 为 O(log limit)。
+// candidates 为候选元素数的上界，按它与 limit 的较小者预留空间，limit
+// 很大时也不会按 limit 分配
+template <typename T, typename Greater>
+class TopN {
+ public:
+  TopN(size_t limit, Greater greater, size_t candidates = 0)
+      : limit(limit), greater(greater) {
+    heap.reserve(std::min(limit, candidates));
+  }
+
+  void push(T value) {
+    if (heap.size() < limit) {
+      heap.push_back(std::move(value));
+      std::push_heap(heap.begin(), heap.end(), greater);
+    } else if (limit > 0 && greater(value, heap.front())) {
+      std::pop_heap(heap.begin(), heap.end(), greater);
+      heap.back() = std::move(value);
+      std::push_heap(heap.begin(), heap.end(), greater);
+    }
+  }
+
+  // 按从大到小取出全部元素，之后为空
+  std::vector<T> take() {
+    std::sort_heap(heap.begin(), heap.end(), greater);
+    std::vector<T> result;
+    result.swap(heap);
+    return result;
+  }
+
+ private:
+  size_t limit;
+  Greater greater;
+  std::vector<T> heap;  // 以 greater 为比较的小顶堆
+};
+
+// 统计结果中的一个分组（按时间、分类、金额区间或类型）
+struct StatisticRow {
+  std::string key;
+  double income = 0.0;
+  double expense = 0.0;
+  int incomeCount = 0;
+  int expenseCount = 0;
+};
+
+// 一次统计的完整结果，rows 按分组首次出现的顺序排列
+struct StatisticReport {
+  double totalIncome = 0.0;
+  double totalExpense = 0.0;
+  std::vector<StatisticRow> rows;
+  // 与 rows 一一对应，仅在 StatisticService::setSketches 开启时填充
+  std::vector<GroupSketch> sketches;
+};
+
+// 金额直方图的桶划分。edges 为升序边界，桶 i 为 [edges[i-1], edges[i])，
+// 首尾两个桶分别没有下界和上界，共 edges.size() + 1 个桶。
+// 只描述划分方式，计数和求和由 StatisticService 在扁平数组中累加
+class AmountHistogram {
+ public:
+  // 边界排序去重，忽略 NaN 和无穷
+  explicit AmountHistogram(std::vector<double> edges);
+  // 默认划分：小于100、100-499、500-999、1000及以上
+  static AmountHistogram defaults() {
+    return AmountHistogram({100.0, 500.0, 1000.0});
+  }
+  // [min, max] 等宽或等比（min 须大于 0）分成 buckets 个桶
+  static AmountHistogram linear(double min, double max, size_t buckets);
+  static AmountHistogram logScale(double min, double max, size_t buckets);
+  // 按 amounts 的分位数分成至多 buckets 个桶，重复的分位点合并
+  static AmountHistogram quantiles(std::vector<double> amounts,
+                                   size_t buckets);
+  // 解析 "100,500,1000"、"linear:最小:最大:桶数"、"log:最小:最大:桶数"
+  static bool parse(const std::string& spec, AmountHistogram& out);
+
+  size_t bucketCount() const { return edges.size() + 1; }
+  const std::vector<double>& getEdges() const { return edges; }
+
+  // 不大于 amount 的边界个数，即所在桶的下标。无分支二分：
+  // 每步用比较结果选择下一段的起点，循环次数只取决于边界个数
+  size_t bucketOf(double amount) const {
+    if (edges.empty()) return 0;
+    const double* base = edges.data();
+    for (size_t n = edges.size(); n > 1;) {
+      size_t half = n / 2;
+      base += (base[half - 1] <= amount) * half;
+      n -= half;
+    }
+    return static_cast<size_t>(base - edges.data()) + (*base <= amount);
+  }
+
+  // 桶的显示名，只在输出时生成
+  std::string label(size_t bucket) const;
+
+ private:
+  std::vector<double> edges;
+};
+
+// 统计服务
+class StatisticService {
+ public:
+  explicit StatisticService(const std::vector<Transaction>& data)
+      : transactions(data), deleted(Transaction::deletedMask(data)) {}
+  // 基于快照统计：结果对应快照的版本，执行期间不阻塞修改
+  explicit StatisticService(const LedgerSnapshot& snapshot)
+      : pinned(snapshot), transactions(pinned.transactions()),
+        deleted(nullptr) {}
+
+  // 以下 report* 只计算不输出，供菜单显示和命令行的 CSV/JSON 输出共用
+  StatisticReport reportByType(
+      const std::vector<std::string>& range = {}) const;
+  StatisticReport reportByTime(TimeGroup timeGroup,
+                               const std::vector<std::string>& range) const;
+  StatisticReport reportByCategory(
+      const std::vector<std::string>& range = {}) const;
+  // 按默认金额区间统计，等价于 reportByHistogram(AmountHistogram::defaults())
+  StatisticReport reportByAmountRange(
+      const std::vector<std::string>& range = {}) const;
+  // 按给定的桶划分统计，rows 按桶升序排列，只含有交易的桶
+  StatisticReport reportByHistogram(
+      const AmountHistogram& buckets,
+      const std::vector<std::string>& range = {}) const;
+  // 以日期范围内交易金额的分位数划分桶
+  AmountHistogram quantileHistogram(
+      size_t buckets, const std::vector<std::string>& range = {}) const;
+  // 排行榜：单趟扫描，用容量为 n 的有界堆保留前 n 名，O(行数 · log n)。
+  // 命令行和菜单中 n 不超过 MAX_RANKING
+  static const size_t MAX_RANKING = 100000;
+  // 支出最多的 n 个分类，rows 按支出从大到小，不含没有支出的分类
+  StatisticReport topCategories(
+      size_t n, const std::vector<std::string>& range = {}) const;
+  // 金额最大的 n 笔 type 类交易，金额相同时仓库中靠前的优先
+  std::vector<Transaction> topTransactions(
+      size_t n, TransactionType type,
+      const std::vector<std::string>& range = {}) const;
+  // 备注关键词按所在支出的总额排名，同一笔交易中重复的词只计一次
+  StatisticReport topTerms(
+      size_t n, const std::vector<std::string>& range = {}) const;
+
+  // 统计时在同一趟扫描中为每个分组累加 GroupSketch。按类型、时间、分类
+  // 统计时把仓库分成至多 threads 段并行扫描再合并（0 表示按 CPU 核数）
+  void setSketches(bool enabled, size_t threads = 0) {
+    withSketches = enabled;
+    sketchThreads = threads ? threads
+                            : std::max(1u, std::thread::hardware_concurrency());
+  }
+  // 把 part 按分组键并入 into：金额、笔数相加，sketch 合并，
+  // 新分组追加在末尾。两者须同时带或同时不带 sketch
+  static void mergeReport(StatisticReport& into, const StatisticReport& part);
+
+  // 按维度分派到上面的 report*；buckets 只用于金额区间维度，为空时用默认划分
+  StatisticReport report(StatisticDimension dimension,
+                         const std::vector<std::string>& range,
+                         const AmountHistogram* buckets = nullptr) const;
+
+  void calculateAndDisplayByType() {
+    StatisticReport report = reportByType();
+    displaySummary(report.totalIncome, report.totalExpense);
+  }
+
+  void calculateAndDisplayByTime(TimeGroup group,
+                                 const std::vector<std::string>& range) {
+    StatisticReport report = reportByTime(group, range);
+    displaySummary(report.totalIncome, report.totalExpense);
+    if (!report.rows.empty()) {
+      std::cout << "\n时间段统计：\n时间\t收入\t支出\t结余\n"
+                << "--------------------------------------\n";
+      for (size_t i = 0; i < report.rows.size(); ++i) {
+        const StatisticRow& row = report.rows[i];
+        std::cout << row.key << '\t' << row.income << '\t' << row.expense
+                  << '\t' << (row.income - row.expense) << '\n';
+      }
+    }
+  }
+
+  void calculateAndDisplayByCategory() {
+    StatisticReport report = reportByCategory();
+    displaySummary(report.totalIncome, report.totalExpense);
+    if (!report.rows.empty()) {
+      std::cout << "\n分类统计：\n分类\t收入\t支出\t净额\n"
+                << "--------------------------------------\n";
+      for (size_t i = 0; i < report.rows.size(); ++i) {
+        const StatisticRow& row = report.rows[i];
+        std::cout << row.key << '\t' << row.income << '\t' << row.expense
+                  << '\t' << (row.income - row.expense) << '\n';
+      }
+    }
+  }
+
+  void calculateAndDisplayByAmountRange(
+      const AmountHistogram& buckets = AmountHistogram::defaults()) {
+    StatisticReport report = reportByHistogram(buckets);
+    displaySummary(report.totalIncome, report.totalExpense);
+    if (!report.rows.empty()) {
+      std::cout << "\n金额区间统计：\n区间\t收入笔数\t支出笔数\t总笔数\n"
+                << "--------------------------------------\n";
+      for (size_t i = 0; i < report.rows.size(); ++i) {
+        const StatisticRow& row = report.rows[i];
+        std::cout << row.key << '\t' << row.incomeCount << '\t'
+                  << row.expenseCount << '\t'
+                  << (row.incomeCount + row.expenseCount) << '\n';
+      }
+    }
+  }
+
+  void calculateHomePage(double& totalIncome, double& totalExpense,
+                        double& balance);
+
+ private:
+  LedgerSnapshot pinned;  // 基于快照构造时持有，保证数据在使用期间存活
+  const std::vector<Transaction>& transactions;
+  const std::vector<uint64_t>* deleted;  // 基于仓库本身构造时跳过已删除行
+  bool withSketches = false;
+  size_t sketchThreads = 1;
+  static const size_t MIN_SLICE_ROWS = 65536;  // 并行时每段的最少行数
+
+  void displaySummary(double income, double expense) {
+    std::cout << "\n========== 统计结果 ==========\n"
+              << "总收入: " << income << "\n总支出: " << expense
+              << "\n结余: " << (income - expense) << std::endl;
+  }
+
+  // 单趟扫描：按 keyOf 给出的键分组累加，哈希索引保持分组首次出现的顺序。
+  // 开启 sketch 时分段并行扫描，各段结果按段的顺序合并，分组顺序不变
+  template <typename KeyFn>
+  StatisticReport group(KeyFn keyOf,
+                        const std::vector<std::string>& range) const {
+    LedgerLock::ReadGuard guard(!pinned.valid());
+    size_t count = transactions.size();
+    if (!withSketches) return groupRows(keyOf, range, 0, count);
+    size_t slices =
+        std::min(sketchThreads, std::max<size_t>(count / MIN_SLICE_ROWS, 1));
+    std::vector<StatisticReport> parts(slices);
+    std::vector<std::thread> workers;
+    for (size_t i = 1; i < slices; ++i) {
+      workers.emplace_back([&, i]() {
+        parts[i] = groupRows(keyOf, range, count * i / slices,
+                             count * (i + 1) / slices);
+      });
+    }
+    parts[0] = groupRows(keyOf, range, 0, count / slices);
+    for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+    for (size_t i = 1; i < slices; ++i) mergeReport(parts[0], parts[i]);
+    for (size_t i = 0; i < parts[0].sketches.size(); ++i) {
+      parts[0].sketches[i].expenses.flush();
+    }
+    return std::move(parts[0]);
+  }
+
+  // 扫描 [begin, end) 行；调用方持有读锁
+  template <typename KeyFn>
+  StatisticReport groupRows(KeyFn& keyOf,
+                            const std::vector<std::string>& range,
+                            size_t begin, size_t end) const {
+    StatisticReport report;
+    std::unordered_map<std::string, size_t> index;
+    for (size_t i = begin; i < end; ++i) {
+      if (Transaction::isDeleted(deleted, i)) continue;
+      const Transaction& tx = transactions[i];
+      if (!inDateRange(tx.getTime(), range)) continue;
+
+      std::string key = keyOf(tx);
+      auto it = index.find(key);
+      if (it == index.end()) {
+        it = index.emplace(key, report.rows.size()).first;
+        report.rows.push_back(StatisticRow());
+        report.rows.back().key = std::move(key);
+        if (withSketches) report.sketches.emplace_back();
+      }
+      StatisticRow& row = report.rows[it->second];
+      if (withSketches) report.sketches[it->second].add(tx);
+      if (tx.getType() == TransactionType::Income) {
+        report.totalIncome += tx.getAmount();
+        row.income += tx.getAmount();
+        ++row.incomeCount;
+      } else {
+        report.totalExpense += tx.getAmount();
+        row.expense += tx.getAmount();
+        ++row.expenseCount;
+      }
+    }
+    return report;
+  }
+
+  // 统计中实际计入的行数（落在日期范围内的交易）
+  static size_t countedRows(const StatisticReport& report) {
+    size_t n = 0;
+    for (size_t i = 0; i < report.rows.size(); ++i) {
+      n += report.rows[i].incomeCount + report.rows[i].expenseCount;
+    }
+    return n;
+  }
+
+  static bool inDateRange(const std::string& date,
+                          const std::vector<std::string>& range) {
+    if (range.size() != 2) return true;
+    if (!range[0].empty() && date < range[0]) return false;
+    if (!range[1].empty() && date > range[1]) return false;
+    return true;
+  }
+
+  static std::string getTimeKey(const std::string& time, TimeGroup group) {
+    if (group == TimeGroup::Monthly && time.size() >= 7) {
+      return time.substr(0, 7);
+    } else if (group == TimeGroup::Yearly && time.size() >= 4) {
+      return time.substr(0, 4);
+    }
+    return time;
+  }
+};
+
+// 搜索服务
+class SearchService {
+ public:
+  explicit SearchService(const std::vector<Transaction>& data)
+      : transactions(data), deleted(Transaction::deletedMask(data)) {}
+  // 基于快照检索：结果对应快照的版本，执行期间不阻塞修改
+  explicit SearchService(const LedgerSnapshot& snapshot)
+      : pinned(snapshot), transactions(pinned.transactions()),
+        deleted(nullptr) {}
+
+  std::vector<Transaction> searchTransaction(
+      const std::vector<std::string>& dateRange,
+      const std::vector<double>& amountRange,
+      const std::string& categoryId,
+      const std::string& keyword) const;
+
+ private:
+  LedgerSnapshot pinned;
+  const std::vector<Transaction>& transactions;
+  const std::vector<uint64_t>* deleted;  // 基于仓库本身构造时跳过已删除行
+};
+
+// UI 服务
+class UIService {
+ public:
+  static std::vector<Transaction> sortTransactionList(
+      std::vector<Transaction> list, SortField field, SortDirection direction);
+};
+
+// 检索条件，与 SearchService::searchTransaction 的参数一致；
+// sorted 为 false 时保持仓库顺序，忽略 sortField 和 direction
+struct SearchQuery {
+  std::vector<std::string> dateRange;
+  std::vector<double> amountRange;
+  std::string categoryId;
+  std::string keyword;
+  bool sorted = false;
+  SortField sortField = SortField::Time;
+  SortDirection direction = SortDirection::Asc;
+};
+
+// 检索谓词：检索条件预先转换好（分类 ID 只转换一次），逐行判断是否命中。
+// 检索和按条件批量修改共用同一个谓词，同一条件命中的行完全一致
+class SearchFilter {
+ public:
+  SearchFilter(const std::vector<std::string>& dateRange,
+               const std::vector<double>& amountRange,
+               const std::string& categoryId, const std::string& keyword)
+      : hasDate(dateRange.size() == 2), hasAmount(amountRange.size() == 2),
+        hasCategory(!categoryId.empty()), minAmount(0.0), maxAmount(0.0),
+        category(categoryId), keyword(keyword) {
+    if (hasDate) {
+      fromDate = dateRange[0];
+      toDate = dateRange[1];
+    }
+    if (hasAmount) {
+      minAmount = amountRange[0];
+      maxAmount = amountRange[1];
+    }
+  }
+  explicit SearchFilter(const SearchQuery& query)
+      : SearchFilter(query.dateRange, query.amountRange, query.categoryId,
+                     query.keyword) {}
+
+  // 是否没有任何条件（命中全部行）
+  bool matchesAll() const {
+    return (!hasDate || (fromDate.empty() && toDate.empty())) &&
+           !hasAmount && !hasCategory && keyword.empty();
+  }
+
+  bool operator()(const Transaction& tx) const {
+    if (hasDate) {
+      if (!fromDate.empty() && tx.getTime() < fromDate) return false;
+      if (!toDate.empty() && tx.getTime() > toDate) return false;
+    }
+    if (hasAmount) {
+      if (tx.getAmount() < minAmount || tx.getAmount() > maxAmount) {
+        return false;
+      }
+    }
+    if (hasCategory && tx.getCategoryId() != category) return false;
+    if (!keyword.empty()) {
+      if (tx.getId().view().find(keyword) == std::string_view::npos &&
+          tx.getRemarks().find(keyword) == std::string::npos) return false;
+    }
+    return true;
+  }
+
+ private:
+  bool hasDate, hasAmount, hasCategory;
+  std::string fromDate, toDate;
+  double minAmount, maxAmount;
+  LedgerId category;
+  std::string keyword;
+};
+
+// 查询结果缓存：按规范化后的检索条件或统计维度缓存结果，LRU 淘汰。
+// 缓存的结果以 shared_ptr 共享，命中时既不扫描仓库也不复制结果。
+// 每个条目记下计算时的账本版本号，版本变化后旧条目全部作废，
+// 因此任何修改之后都不会返回过期数据。条目占用的内存按交易和分组的
+// 实际大小估算，总量超过预算时从最久未用的条目开始淘汰
+class QueryCache {
+ public:
+  typedef std::shared_ptr<const std::vector<Transaction>> TransactionList;
+  typedef std::shared_ptr<const StatisticReport> Report;
+
+  static const size_t DEFAULT_BUDGET = 64 << 20;  // 64 MiB
+
+  static TransactionList search(const SearchQuery& query);
+  static Report statistic(StatisticDimension dimension,
+                          const std::vector<std::string>& range,
+                          const AmountHistogram* buckets = nullptr);
+
+  // 设置内存预算（字节），超出部分立即淘汰；0 表示不缓存
+  static void setBudget(size_t bytes);
+  static size_t budget();
+  static size_t memoryUsage();
+  static size_t size();
+  static uint64_t hits();
+  static uint64_t misses();
+  static void clear();
+
+  // 以 Prometheus 文本格式输出命中、未命中次数和内存占用
+  static void write(std::ostream& out);
+
+ private:
+  struct Entry {
+    std::string key;
+    std::shared_ptr<const void> value;
+    size_t bytes;
+  };
+  typedef std::list<Entry> EntryList;
+
+  static std::shared_ptr<const void> lookup(const std::string& key);
+  static void store(const std::string& key, uint64_t version,
+                    std::shared_ptr<const void> value, size_t bytes);
+  // 以下须持有 mutex
+  static void dropStale(uint64_t version);
+  static void evictToBudget();
+
+  static size_t footprint(const std::string& str);
+  static size_t footprint(const std::vector<Transaction>& list);
+  static size_t footprint(const StatisticReport& report);
+
+  static std::mutex mutex;
+  static EntryList entries;  // 表头为最近使用
+  static std::unordered_map<std::string, EntryList::iterator> index;
+  static uint64_t cachedVersion;
+  static size_t bytesUsed;
+  static size_t bytesBudget;
+  static std::atomic<uint64_t> hitCount;
+  static std::atomic<uint64_t> missCount;
+};
+
+// 按检索条件批量修改：命中的行与同样条件的检索结果一致（排序设置不影响
+// 命中）。每个操作在一把写锁内一次扫描完成，ID 索引不重建，只保存一次
+class BulkEditService {
+ public:
+  static size_t deleteMatching(const SearchQuery& query) {
+    return Transaction::deleteWhere(SearchFilter(query));
+  }
+  // 把命中行改到 categoryId 分类；分类不存在时不做修改并返回 0
+  static size_t recategorize(const SearchQuery& query,
+                             const LedgerId& categoryId) {
+    LedgerLock::WriteGuard guard;
+    if (!Category::categoryExists(categoryId)) return 0;
+    return Transaction::updateWhere(
+        SearchFilter(query),
+        [&categoryId](Transaction& tx) { tx.setCategoryId(categoryId); });
+  }
+  static size_t setRemarks(const SearchQuery& query,
+                           const std::string& remarks) {
+    return Transaction::updateWhere(
+        SearchFilter(query),
+        [&remarks](Transaction& tx) { tx.setRemarks(remarks); });
+  }
+  // 在命中行原有备注之后追加 suffix
+  static size_t appendRemarks(const SearchQuery& query,
+                              const std::string& suffix) {
+    return Transaction::updateWhere(
+        SearchFilter(query), [&suffix](Transaction& tx) {
+          tx.setRemarks(std::string(tx.getRemarks()) + suffix);
+        });
+  }
+};
+
+// 周期交易模板：从 next 起每隔一个周期（日、月、年）记一笔相同的交易。
+// 按月、按年时记账日固定为 day（取自首次日期），遇到较短的月份取该月
+// 最后一天，之后的月份仍回到 day
+struct RecurringTemplate {
+  LedgerId id;
+  double amount;
+  LedgerId categoryId;
+  TransactionType type;
+  TimeGroup every;
+  std::string next;  // 下一次记账的日期
+  int day;           // 记账日（1-31）
+  std::string remarks;
+};
+
+// 周期交易：管理模板，并把到期的记录一次性补记到账本。模板受
+// LedgerLock 保护，随数据文件的 [RECURRING] 段保存
+class RecurringService {
+ public:
+  // 新增模板，next 为首次记账日期；ID 为空时自动分配 R1、R2……，day 不在
+  // 1-31 内时取 next 当天。ID 重复、金额为负、日期不合法或分类不存在时
+  // 返回 false
+  static bool addTemplate(RecurringTemplate tmpl);
+  static bool removeTemplate(const LedgerId& id);
+  static std::vector<RecurringTemplate> templates();
+  // 清空全部模板，用于测试
+  static void clear();
+
+  // 把各模板截至 until（含当天）到期的记录整批加入账本（经
+  // Transaction::addTransactions，交易 ID 由 IdAllocator 分配），推进各模板
+  // 的 next，并保存一次。返回补记的条数
+  static size_t post(const std::string& until);
+  // date 之后的下一个记账日期，day 为记账日
+  static std::string advance(const std::string& date, TimeGroup every,
+                             int day);
+
+ private:
+  static std::vector<RecurringTemplate> list;
+};
+
+// JsonLines 每行一个 JSON 对象，不含外层数组，便于逐行流式处理
+enum class OutputFormat { Csv, Json, JsonLines };
+
+// 机器可读输出：把交易列表和统计结果写成 CSV、JSON 或 JSON Lines
+class ReportWriter {
+ public:
+  // 交易逐行格式化到一块固定大小的缓冲区，写满才整块交给 out，
+  // 内存占用与行数无关
+  static const size_t BUFFER_SIZE = 1 << 20;  // 1 MiB
+
+  static void writeTransactions(std::ostream& out,
+                                const std::vector<Transaction>& list,
+                                OutputFormat format);
+  // 导出仓库中满足 query 的交易：边扫描边输出，不生成中间结果，
+  // 也不经过查询缓存。导出保持仓库顺序，忽略 query 的排序设置
+  static void exportTransactions(std::ostream& out, const SearchQuery& query,
+                                 OutputFormat format);
+
+  static void writeReport(std::ostream& out, const StatisticReport& report,
+                          OutputFormat format);
+  static void writeBalanceSeries(std::ostream& out,
+                                 const std::vector<BalancePoint>& points,
+                                 OutputFormat format);
+  static void writeBudgetStatus(std::ostream& out,
+                                const std::vector<BudgetStatus>& statuses,
+                                OutputFormat format);
+  static void writeTemplates(std::ostream& out,
+                             const std::vector<RecurringTemplate>& templates,
+                             OutputFormat format);
+
+  // 金额统一保留两位小数，避免默认精度下大金额变成科学计数法
+  static std::string formatAmount(double amount) {
+    std::string result;
+    appendAmount(result, amount);
+    return result;
+  }
+  static void appendAmount(std::string& out, double amount) {
+    char buf[64];
+    int len = std::snprintf(buf, sizeof(buf), "%.2f", amount);
+    out.append(buf, static_cast<size_t>(len));
+  }
+
+  static std::string csvField(std::string_view str) {
+    std::string result;
+    appendCsvField(result, str);
+    return result;
+  }
+  static void appendCsvField(std::string& out, std::string_view str) {
+    if (str.find_first_of(",\"\r\n") == std::string_view::npos) {
+      out.append(str);
+      return;
+    }
+    out += '"';
+    for (size_t i = 0; i < str.size(); ++i) {
+      if (str[i] == '"') out += '"';
+      out += str[i];
+    }
+    out += '"';
+  }
+
+  static std::string jsonString(std::string_view str) {
+    std::string result;
+    appendJsonString(result, str);
+    return result;
+  }
+  static void appendJsonString(std::string& out, std::string_view str) {
+    out += '"';
+    for (size_t i = 0; i < str.size(); ++i) {
+      unsigned char c = static_cast<unsigned char>(str[i]);
+      if (c == '"') {
+        out += "\\\"";
+      } else if (c == '\\') {
+        out += "\\\\";
+      } else if (c == '\n') {
+        out += "\\n";
+      } else if (c == '\r') {
+        out += "\\r";
+      } else if (c == '\t') {
+        out += "\\t";
+      } else if (c < 0x20) {
+        char buf[8];
+        std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+        out += buf;
+      } else {
+        out += str[i];
+      }
+    }
+    out += '"';
+  }
+
+ private:
+  // filter 为 nullptr 时输出 list 中全部未删除的行
+  static void writeRows(std::ostream& out, const std::vector<Transaction>& list,
+                        const SearchFilter* filter, OutputFormat format);
+};
+
+// 极简 JSON 读取器，只支持服务协议用到的子集：
+// 一层对象，值为字符串、数字、布尔、null 或字符串数组
+struct JsonValue {
+  std::string text;                // 字符串值；数字、布尔按原文保存
+  std::vector<std::string> items;  // 字符串数组
+};
+
+class JsonReader {
+ public:
+  static bool parseObject(const std::string& text,
+                          std::unordered_map<std::string, JsonValue>& obj);
+
+ private:
+  static void skipSpace(const std::string& text, size_t& pos);
+  static bool trailing(const std::string& text, size_t pos);
+  static bool readValue(const std::string& text, size_t& pos,
+                        JsonValue& value);
+  static bool readString(const std::string& text, size_t& pos,
+                         std::string& out);
+  static void appendUtf8(std::string& out, unsigned long code);
+};
+
+
+// 交易数据的分块压缩格式，启用压缩时代替逐行的文本格式。每块最多
+// BLOCK_ROWS 行，先逐行编码：ID 为"前缀+序号"且前缀与上一行相同时只记
+// 序号之差，合法日期只记与上一行相差的天数，整分的金额记为分，分类和备注
+// 查块内字典、重复出现时只记下标；再以 LZ77 类的字节压缩（序列格式同
+// LZ4 的 block format）压缩整块。块与块相互独立，载入时逐块读出、校验、
+// 解压，内存中只保留一块。块的布局（整数为 LEB128 变长编码）：
+//   行数 | 编码后字节数 | 压缩后字节数 | 校验和（4 字节） | 压缩数据
+// 行数为 0 表示结束
+class BlockCodec {
+ public:
+  static constexpr size_t BLOCK_ROWS = 4096;
+  static const char SECTION[];  // 数据文件中压缩数据之前的一行
+
+  class Writer {
+   public:
+    explicit Writer(std::ostream& out) : out(out) {}
+    void add(const Transaction& tx);
+    // 写出未满的最后一块和结束标记
+    void finish();
+
+   private:
+    void flush();
+
+    std::ostream& out;
+    std::string raw;  // 当前块编码后的字节
+    size_t rows = 0;
+    // 以下为块内的编码状态，每块重新开始
+    std::string prevPrefix;
+    int64_t prevNumber = 0;
+    int64_t prevDay = 0;
+    std::unordered_map<LedgerId, size_t> categories;
+    // 备注字典：哈希到条目下标，条目为 raw 中的偏移和长度
+    std::unordered_map<uint64_t, size_t> remarkIndex;
+    std::vector<std::pair<size_t, size_t>> remarks;
+  };
+
+  class Reader {
+   public:
+    explicit Reader(std::istream& in) : in(in) {}
+    // 读出下一块，解码后追加到 rows。读到结束标记或数据损坏时返回 false，
+    // 以 ok() 区分；解码出的备注存入 RemarkArena
+    bool next(std::vector<Transaction>& rows);
+    bool ok() const { return good; }
+
+   private:
+    std::istream& in;
+    std::string packed, raw;  // 跨块复用的缓冲区
+    bool good = true;
+  };
+
+  // 字节压缩；解压时输入损坏或解压后长度不是 size 返回 false
+  static std::string compress(std::string_view input);
+  static bool decompress(std::string_view input, size_t size,
+                         std::string& output);
+};
+
+// 数据持久化管理类
+// 数据文件布局。Single 为单个文件；Yearly/Monthly 为分区存储：数据文件
+// 只作为清单，保存文件头、分类和分区列表，每年（每月）的交易单独存放在
+// "<数据文件>.<分区>" 中，例如 bookkeeping.db.2024 或 bookkeeping.db.2024-03
+enum class StorageLayout { Single, Yearly, Monthly };
+
+class DataPersistence {
+ public:
+  static const char DB_FILE[];
+  static const char DELIMITER = '|';
+  static std::string testFilePath;
+  // 在测试中可设置临时文件路径以进行真实 IO
+  static void setTestFilePath(const std::string& path) { testFilePath = path; }
+  static std::string getTestFilePath() { return testFilePath; }
+
+  // 分区存储下只重写有改动的分区（见 DirtyTracker）和清单，其余分区
+  // 文件不动；有改动的冷分区先载入再重写。分区文件先写临时文件再改名
+  static bool saveAll();
+  // 载入清单和全部分区
+  static bool loadAll();
+  // 只载入清单（文件头、分类、分区列表），分区留在磁盘上，由 loadRange
+  // 按需载入。单文件布局下等同于 loadAll
+  static bool loadManifest();
+  // 载入与日期范围 [from, to]（空串表示不限）相交的冷分区。已全部载入
+  // 时只做检查、不加写锁，因此可在持有读锁时调用；需要载入时不可
+  static bool loadRange(const std::string& from, const std::string& to);
+
+  // 切换布局：载入全部分区，下次保存时按新布局整体重写并删除旧的
+  // 分区文件
+  static void setLayout(StorageLayout layout);
+  static StorageLayout layout() { return storageLayout; }
+  // 启用或关闭分块压缩（见 BlockCodec）：载入全部分区，下次保存时整体
+  // 重写。设置记录在文件头中；载入时按各文件的实际格式读取
+  static void setCompression(bool enabled);
+  static bool compressionEnabled() { return compression; }
+  // 清单中的分区数与已载入的分区数
+  static size_t partitionCount() { return partitions.size(); }
+  static size_t loadedPartitionCount();
+  // 日期所属的分区；日期格式不合法时归入 "undated" 分区
+  static std::string partitionKey(std::string_view date,
+                                  StorageLayout layout);
+
+  // 以下解析工具也供批量导入复用
+  static std::string escapeString(std::string_view str) {
+    std::string result;
+    for (size_t i = 0; i < str.size(); ++i) {
+      if (str[i] == DELIMITER) {
+        result += "\\|";
+      } else if (str[i] == '\n') {
+        result += "\\n";
+      } else if (str[i] == '\\') {
+        result += "\\\\";
+      } else {
+        result += str[i];
+      }
+    }
+    return result;
+  }
+
+  // 按值接收：不含转义的字段（绝大多数）直接原样移出，不再逐字节复制
+  static std::string unescapeString(std::string str) {
+    if (str.find('\\') == std::string::npos) return str;
+    std::string result;
+    for (size_t i = 0; i < str.size(); ++i) {
+      if (str[i] == '\\' && i + 1 < str.size()) {
+        if (str[i + 1] == '|') {
+          result += '|';
+          ++i;
+        } else if (str[i + 1] == 'n') {
+          result += '\n';
+          ++i;
+        } else if (str[i + 1] == '\\') {
+          result += '\\';
+          ++i;
+        } else {
+          result += str[i];
+        }
+      } else {
+        result += str[i];
+      }
+    }
+    return result;
+  }
+
+  static std::vector<std::string> split(const std::string& str,
+                                       char delimiter) {
+    std::vector<std::string> tokens;
+    std::string token;
+    bool escaped = false;
+    for (size_t i = 0; i < str.size(); ++i) {
+      if (str[i] == '\\' && !escaped) {
+        escaped = true;
+        token += str[i];
+      } else if (str[i] == delimiter && !escaped) {
+        tokens.push_back(std::move(token));
+        token.clear();
+      } else {
+        token += str[i];
+        escaped = false;
+      }
+    }
+    tokens.push_back(std::move(token));
+    return tokens;
+  }
+
+  // 取出 rest 开头到下一个未转义分隔符为止的原始字段（不反转义、不复制），
+  // 并把 rest 推进到该分隔符之后；取出最后一个字段后 rest 置为默认构造的
+  // 空视图（data() 为空指针）。依次取出的字段与 split 的结果一致
+  static std::string_view nextField(std::string_view& rest, char delimiter) {
+    size_t i = 0;
+    while (i < rest.size() && rest[i] != delimiter) {
+      i += rest[i] == '\\' ? 2 : 1;
+    }
+    if (i >= rest.size()) {
+      std::string_view field = rest;
+      rest = std::string_view();
+      return field;
+    }
+    std::string_view field = rest.substr(0, i);
+    rest.remove_prefix(i + 1);
+    return field;
+  }
+
+ private:
+  struct Partition {
+    size_t rows;   // 最近一次保存或清单中记录的行数
+    bool loaded;
+  };
+
+  static std::string dbPath() {
+    return testFilePath.empty() ? std::string(DB_FILE) : testFilePath;
+  }
+  static std::string partitionPath(const std::string& key) {
+    return dbPath() + "." + key;
+  }
+  static void writeHeader(std::ostream& out);
+  static void writeTransaction(std::ostream& out, const Transaction& tx);
+  // 写出交易段：rows 为空指针时写出全部未删除的行，否则只写其中的行号。
+  // 按当前设置写成文本或压缩块
+  static void writeTransactions(std::ostream& out,
+                                const std::vector<size_t>* rows);
+  static std::ios::openmode writeMode() {
+    return compression ? std::ios::trunc | std::ios::binary : std::ios::trunc;
+  }
+  // 以下须持有写锁
+  static bool saveSingle(size_t& bytes);
+  static bool savePartitioned(size_t& bytes);
+  static bool loadPartition(const std::string& key);
+  static bool overlaps(const std::string& key, const std::string& from,
+                       const std::string& to);
+
+  static void loadHeader(const std::string& line);
+  static void loadCategory(const std::string& line);
+  static void loadBudget(const std::string& line);
+  static void loadRecurring(const std::string& line);
+
+  // 返回该行是否成功加入 repo（调用方每次载入只取一次仓库引用）
+  static bool loadTransaction(std::vector<Transaction>& repo,
+                              const std::string& line);
+  // 从 path 的 pos 处读取压缩块，合法的行加入仓库，计入 loaded
+  static bool loadBlocks(const std::string& path, std::streampos pos,
+                         size_t& loaded);
+
+  static StorageLayout storageLayout;
+  static bool compression;
+  static std::map<std::string, Partition> partitions;
+  static std::vector<std::string> obsoleteFiles;  // 切换布局后待删除
+};
+
+// ID 生成与交互输入
+std::string generateTransactionId();
+std::string generateCategoryId();
+std::string readString(const std::string& prompt);
+double readDouble(const std::string& prompt);
+int readInt(const std::string& prompt);
+bool isValidDate(const std::string& date);
+// 本地时区的当天日期（YYYY-MM-DD）
+std::string currentDate();
+std::string readDate(const std::string& prompt, bool required = true);
+
+// 批量导入结果
+struct ImportResult {
+  bool ok = false;                  // 文件可读且结果已保存
+  size_t accepted = 0;              // 成功导入的条数
+  std::vector<ImportError> errors;  // 失败行及原因（按行号排序）
+  size_t categoriesCreated = 0;     // 导入时自动新建的分类数
+};
+// CSV 导入选项。各字段按表头中的列名定位，默认与 export 输出的 CSV 表头
+// 一致；列名留空或表头中没有该列表示文件不含此字段
+struct CsvImportOptions {
+  std::string idColumn = "id";
+  std::string amountColumn = "amount";
+  std::string dateColumn = "date";
+  std::string categoryColumn = "category_name";
+  std::string typeColumn = "type";
+  std::string remarksColumn = "remarks";
+  char delimiter = ',';
+  size_t threads = 0;             // 解析线程数，0 表示按 CPU 核数
+  size_t chunkSize = 4 << 20;     // 每次读入的字节数
+};
+
+// 批量导入服务：非交互地将大量交易一次性写入仓库
+class ImportService {
+ public:
+  // 导入一批交易：整批校验、查重后一次追加，最后只保存一次
+  static ImportResult importBatch(std::vector<Transaction> batch);
+
+  // 从文本文件导入。每行格式与数据文件的交易段一致：
+  //   ID|金额|日期|分类|类型|备注
+  // ID 可留空以自动生成（整个文件一次预留一段编号）；分类可填分类 ID 或分类名称；类型 0 收入 1 支出；
+  // 空行和以 # 开头的行被忽略。errors 中的 row 为文件行号
+  static ImportResult importFile(const std::string& path);
+
+  // 从 CSV 文件（如银行流水）导入。文件按块流式读入，每块内的记录分给
+  // 多个线程并行解析，解析结果按块整批追加，全部完成后只保存一次；
+  // 导入期间持有写锁。支持带引号的字段（可含分隔符、换行和 "" 转义）
+  // 以及 UTF-8 BOM。
+  // 金额、日期、分类三列必须存在；日期可写作 YYYY-MM-DD 或 YYYY/MM/DD，
+  // 金额中的千位分隔符被忽略。类型列可填 income/expense、收入/支出或
+  // 0/1；没有类型列时负数金额记为支出、其余记为收入。分类列按分类 ID
+  // 或名称经哈希表匹配，都不匹配时以该名称新建分类。
+  // ID 列缺失或留空时自动生成。errors 中的 row 为记录起始的文件行号
+  static ImportResult importCsv(
+      const std::string& path,
+      const CsvImportOptions& options = CsvImportOptions());
+
+ private:
+  // 各字段在记录中的列号，缺失为 NONE
+  struct CsvColumns {
+    static const size_t NONE = static_cast<size_t>(-1);
+    size_t id, amount, date, category, type, remarks, count;
+  };
+  struct CsvRecord {
+    size_t begin, end;  // 在缓冲区中的范围，不含换行
+    size_t line;        // 起始行号
+  };
+  // 一个线程解析出的一段记录。分类未能匹配的行 categoryId 为空，
+  // 分类名记在 newCategories 中（rows 下标, 名称），由主线程统一新建
+  struct CsvSlice {
+    std::vector<Transaction> rows;
+    std::vector<size_t> lines;
+    std::vector<ImportError> errors;
+    std::vector<std::pair<size_t, std::string>> newCategories;
+  };
+
+  static bool splitCsv(std::string_view record, char delimiter,
+                       std::vector<std::string>& fields);
+  static void parseCsvSlice(
+      std::string_view text, const std::vector<CsvRecord>& records,
+      size_t begin, size_t end, const CsvColumns& columns, char delimiter,
+      const std::unordered_map<std::string, LedgerId>& categoryRefs,
+      CsvSlice& slice);
+
+  // ID 留空的行 tx 的 ID 也为空，由调用方分配
+  static bool parseLine(
+      const std::string& line,
+      const std::unordered_map<std::string, LedgerId>& categoryRefs,
+      Transaction& tx, std::string& reason);
+};
+
+// 交互菜单
+void displayCategories();
+void manageCategoriesMenu();
+void recordTransaction();
+void statisticAnalysis();
+void displayTransactionList(const std::vector<Transaction>& list);
+void editTransaction(Transaction& tx);
+void searchBills();
+void displayHomePage();
+void displayBudgetStatus(const BudgetStatus& status);
+void manageBudgetsMenu();
+void initDefaultCategories();
+
+// 非交互命令行：供脚本和定时任务直接调用，不渲染菜单，输出后立即退出。
+// 调用前由 main 负责加载数据；args 不含程序名，返回值为进程退出码
+class CommandLine {
+ public:
+  static int run(const std::vector<std::string>& args, std::ostream& out,
+                 std::ostream& err);
+
+  // 只读子命令可以与其他只读请求并发执行
+  static bool isReadOnly(const std::string& command) {
+    return command == "search" || command == "stats" ||
+           command == "export" || command == "balance" ||
+           command == "top" || command == "metrics";
+  }
+
+  static int usage(std::ostream& err);
+
+ private:
+  // 解析 "--名称 值" 形式的选项；--desc、--metrics、--csv、--sketch
+  // 为不带值的开关
+  static bool parseOptions(
+      const std::vector<std::string>& args,
+      std::unordered_map<std::string, std::string>& opts,
+      std::vector<std::string>& positional, std::ostream& err);
+
+  static bool readDateRange(
+      std::unordered_map<std::string, std::string>& opts,
+      std::vector<std::string>& range, std::ostream& err);
+
+  // 读取 --threads，未指定时为 0（按 CPU 核数）；不是正整数时报错
+  static bool readThreads(std::unordered_map<std::string, std::string>& opts,
+                          size_t& threads, std::ostream& err);
+
+  static bool readAmount(const std::string& text, double& value);
+
+  // 读取 search、bulk-delete、bulk-update 共用的检索条件
+  static bool readQuery(std::unordered_map<std::string, std::string>& opts,
+                        SearchQuery& query, std::ostream& err);
+
+  static int runSearch(std::unordered_map<std::string, std::string>& opts,
+                       OutputFormat format, std::ostream& out,
+                       std::ostream& err);
+
+  static int runStats(std::unordered_map<std::string, std::string>& opts,
+                      OutputFormat format, std::ostream& out,
+                      std::ostream& err);
+
+  // 排行榜：categories 为支出最多的分类，transactions 为金额最大的交易
+  // （--type 缺省为支出），terms 为支出总额最多的备注关键词
+  static int runTop(const std::string& kind,
+                    std::unordered_map<std::string, std::string>& opts,
+                    OutputFormat format, std::ostream& out,
+                    std::ostream& err);
+
+  // --by 输出余额走势；否则有 --from 或 --to 时输出区间净流入，
+  // 都没有时输出截至 --on（缺省为全部）的余额
+  static int runBalance(std::unordered_map<std::string, std::string>& opts,
+                        OutputFormat format, std::ostream& out,
+                        std::ostream& err);
+
+  static bool readPeriod(const std::string& name, TimeGroup& period);
+
+  // status（缺省）与 alerts 输出 --on（缺省为今天）所在周期的预算执行
+  // 情况，alerts 只含超支的；set、remove 修改预算并保存
+  static int runBudget(const std::string& action,
+                       std::unordered_map<std::string, std::string>& opts,
+                       OutputFormat format, std::ostream& out,
+                       std::ostream& err);
+
+  // add 新增模板并输出其 ID；remove 删除模板；list 输出全部模板；
+  // run 补记截至 --until（缺省为今天）到期的记录并输出条数
+  static int runRecurring(const std::vector<std::string>& positional,
+                          std::unordered_map<std::string, std::string>& opts,
+                          OutputFormat format, std::ostream& out,
+                          std::ostream& err);
+
+  static int runExport(std::unordered_map<std::string, std::string>& opts,
+                       OutputFormat format, std::ostream& out,
+                       std::ostream& err);
+
+  static int runAdd(std::unordered_map<std::string, std::string>& opts,
+                    std::ostream& out, std::ostream& err);
+
+  // 不带参数时输出当前布局和分区数；带参数时切换布局并立即保存
+  static int runLayout(const std::vector<std::string>& positional,
+                       std::ostream& out, std::ostream& err);
+
+  static int runCompress(const std::vector<std::string>& positional,
+                         std::ostream& out, std::ostream& err);
+
+  // 批量删除不接受空条件，避免漏写选项时清空整个账本
+  static int runBulkDelete(std::unordered_map<std::string, std::string>& opts,
+                           std::ostream& out, std::ostream& err);
+
+  static int runBulkUpdate(std::unordered_map<std::string, std::string>& opts,
+                           std::ostream& out, std::ostream& err);
+
+  static int runDelete(const std::string& id, std::ostream& out,
+                       std::ostream& err);
+
+  // 扩展名为 .csv（不区分大小写）或指定了 --csv 时按 CSV 导入，
+  // --*-column 选项指定各字段的列名，--threads 指定解析线程数。
+  // 汇总写到 out，逐行错误写到 err。
+  // 返回 0 全部成功，1 文件无法读取或保存失败，2 部分行被拒绝
+  static int runImport(const std::string& path,
+                       std::unordered_map<std::string, std::string>& opts,
+                       std::ostream& out, std::ostream& err);
+};
+
+#if !defined(_WIN32) && !defined(_WIN64)
+// 常驻查询服务：只加载一次数据，通过 Unix 域套接字应答请求。
+// 协议为按行分隔的 JSON，args 与命令行子命令完全相同：
+//   请求  {"args":["stats","--by","month","--format","json"]}
+//   响应  {"status":0,"output":"...","error":""}
+// 只读请求（search/stats/export）持共享锁并发执行；
+// 修改请求（import/add/delete）持独占锁，并在返回前完成保存
+class LedgerServer {
+ public:
+  static const char DEFAULT_SOCKET[];
+
+  explicit LedgerServer(const std::string& path)
+      : socketPath(path), stopping(false) {}
+
+  // 处理一行请求并返回一行响应（不含换行），可在多个线程中同时调用
+  static std::string handleRequest(const std::string& line);
+
+  // 监听并服务，直到 stop() 被调用或收到 SIGINT/SIGTERM；返回进程退出码
+  int run(std::ostream& log);
+
+  void stop() { stopping = true; }
+
+  // 供信号处理函数调用，只设置原子标志
+  static void requestStopFromSignal(int) { signalled = true; }
+
+  // 写完整个缓冲区；对端关闭时返回 false 而不触发 SIGPIPE
+  static bool writeAll(int fd, const std::string& data);
+
+ private:
+  struct Worker {
+    std::thread thread;
+    std::shared_ptr<std::atomic<bool>> done;
+  };
+
+  static const int POLL_INTERVAL_MS = 200;
+
+  std::string socketPath;
+  std::atomic<bool> stopping;
+  static std::atomic<bool> signalled;
+
+  bool stopRequested() const { return stopping || signalled; }
+
+  static void reapFinished(std::vector<Worker>& workers);
+
+  static std::string response(int status, const std::string& output,
+                              const std::string& error);
+
+  // 一个连接上可以连续发送多条请求，每行一条
+  void serveConnection(int fd);
+};
+
+
+// 服务模式的客户端：把子命令转发给常驻服务，不加载数据文件
+class LedgerClient {
+ public:
+  // 发送一条请求并读取一行响应
+  static bool request(const std::string& socketPath,
+                      const std::vector<std::string>& args,
+                      std::string& reply);
+
+  // args 形如 client [--socket 路径] <子命令> [选项...]；返回进程退出码
+  static int run(const std::vector<std::string>& args, std::ostream& out,
+                 std::ostream& err);
+};
+#endif
+
+#endif  // CODE_BOOKKEEPING_H_
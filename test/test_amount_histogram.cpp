@@ -0,0 +1,146 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+struct AmountHistogramFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    QueryCache::clear();
+    Category::addCategory(Category("ah1", "餐饮"));
+    const double amounts[] = {5, 99.99, 100, 250, 499.5, 500, 999, 1000, 8000};
+    for (size_t i = 0; i < 9; ++i) {
+      ASSERT_TRUE(Transaction::emplaceTransaction(
+          "H" + std::to_string(i), amounts[i],
+          "2024-03-0" + std::to_string(i + 1), "ah1",
+          i % 3 ? TransactionType::Expense : TransactionType::Income));
+    }
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    QueryCache::clear();
+    Category::deleteCategory("ah1");
+  }
+};
+
+TEST(AmountHistogram, BucketOf_MatchesUpperBound) {
+  uint32_t state = 7;
+  for (size_t n = 0; n < 40; ++n) {
+    std::vector<double> edges;
+    for (size_t i = 0; i < n; ++i) {
+      state = state * 1103515245u + 12345u;
+      edges.push_back(static_cast<double>(state >> 20) / 8);
+    }
+    AmountHistogram buckets(edges);
+    const std::vector<double>& sorted = buckets.getEdges();
+    ASSERT_TRUE(std::is_sorted(sorted.begin(), sorted.end()));
+    std::vector<double> probes = sorted;  // 边界本身落在右侧的桶
+    for (int i = 0; i < 50; ++i) {
+      state = state * 1103515245u + 12345u;
+      probes.push_back(static_cast<double>(state >> 19) / 8 - 100);
+    }
+    for (size_t i = 0; i < probes.size(); ++i) {
+      size_t expected = static_cast<size_t>(
+          std::upper_bound(sorted.begin(), sorted.end(), probes[i]) -
+          sorted.begin());
+      ASSERT_EQ(buckets.bucketOf(probes[i]), expected)
+          << n << ' ' << probes[i];
+    }
+  }
+}
+
+TEST(AmountHistogram, Factories_AndParse) {
+  AmountHistogram defaults = AmountHistogram::defaults();
+  ASSERT_EQ(defaults.bucketCount(), 4u);
+  EXPECT_EQ(defaults.label(0), "小于100");
+  EXPECT_EQ(defaults.label(1), "100-499");
+  EXPECT_EQ(defaults.label(2), "500-999");
+  EXPECT_EQ(defaults.label(3), "1000及以上");
+
+  EXPECT_EQ(AmountHistogram::linear(0, 100, 4).getEdges(),
+            (std::vector<double>{0, 25, 50, 75, 100}));
+  std::vector<double> log = AmountHistogram::logScale(1, 10000, 4).getEdges();
+  ASSERT_EQ(log.size(), 5u);
+  EXPECT_NEAR(log[1], 10, 1e-9);
+  EXPECT_NEAR(log[3], 1000, 1e-9);
+  EXPECT_EQ(AmountHistogram::quantiles({4, 1, 3, 2, 2, 2, 8, 9}, 4).getEdges(),
+            (std::vector<double>{2, 3, 8}));
+  EXPECT_EQ(AmountHistogram(std::vector<double>{0.5, 1.25}).label(1),
+            "0.50-1.25");
+
+  AmountHistogram parsed = AmountHistogram::defaults();
+  ASSERT_TRUE(AmountHistogram::parse("1000,50,200", parsed));
+  EXPECT_EQ(parsed.getEdges(), (std::vector<double>{50, 200, 1000}));
+  ASSERT_TRUE(AmountHistogram::parse("log:1:1000:3", parsed));
+  EXPECT_EQ(parsed.bucketCount(), 5u);
+  ASSERT_TRUE(AmountHistogram::parse("linear:0:10:2", parsed));
+  EXPECT_EQ(parsed.getEdges(), (std::vector<double>{0, 5, 10}));
+  const char* invalid[] = {"", "1,x", "log:0:10:2", "linear:5:1:2",
+                           "linear:0:10:0", "linear:0:10", "1:2", "cubic:1:2:3"};
+  for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); ++i) {
+    EXPECT_FALSE(AmountHistogram::parse(invalid[i], parsed)) << invalid[i];
+  }
+}
+
+TEST_F(AmountHistogramFixture, Report_AccumulatesPerBucketInOrder) {
+  StatisticService stat(Transaction::list());
+  StatisticReport report = stat.reportByAmountRange();
+  ASSERT_EQ(report.rows.size(), 4u);
+  EXPECT_EQ(report.rows[0].key, "小于100");
+  EXPECT_EQ(report.rows[0].incomeCount, 1);
+  EXPECT_EQ(report.rows[0].expenseCount, 1);
+  EXPECT_DOUBLE_EQ(report.rows[0].expense, 99.99);
+  EXPECT_EQ(report.rows[1].key, "100-499");
+  EXPECT_EQ(report.rows[1].expenseCount, 2);  // 100 与 499.5
+  EXPECT_EQ(report.rows[3].key, "1000及以上");
+  EXPECT_DOUBLE_EQ(report.totalIncome, 5 + 250 + 999);
+
+  // 空桶不出现；日期范围照常生效
+  StatisticReport custom = stat.reportByHistogram(
+      AmountHistogram::linear(0, 10000, 2), {"2024-03-02", "2024-03-09"});
+  ASSERT_EQ(custom.rows.size(), 2u);
+  EXPECT_EQ(custom.rows[0].key, "0-4999");
+  EXPECT_EQ(custom.rows[0].incomeCount + custom.rows[0].expenseCount, 7);
+  EXPECT_EQ(custom.rows[1].key, "5000-9999");
+
+  AmountHistogram quartiles = stat.quantileHistogram(3);
+  StatisticReport byQuantile = stat.reportByHistogram(quartiles);
+  ASSERT_EQ(byQuantile.rows.size(), 3u);
+  for (size_t i = 0; i < 3; ++i) {
+    EXPECT_EQ(byQuantile.rows[i].incomeCount + byQuantile.rows[i].expenseCount,
+              3);
+  }
+}
+
+TEST_F(AmountHistogramFixture, CommandLine_CustomBuckets) {
+  std::ostringstream out, err;
+  ASSERT_EQ(CommandLine::run({"stats", "--by", "amount"}, out, err), 0);
+  ASSERT_EQ(CommandLine::run({"stats", "--by", "amount", "--buckets", "1000"},
+                             out, err),
+            0);
+  ASSERT_EQ(CommandLine::run({"stats", "--by", "amount", "--quantiles", "9",
+                              "--from", "2024-03-09"},
+                             out, err),
+            0);
+  const std::string header =
+      "key,income,expense,balance,income_count,expense_count\n";
+  EXPECT_EQ(out.str(),
+            header +
+                "小于100,5.00,99.99,-94.99,1,1\n"
+                "100-499,250.00,599.50,-349.50,1,2\n"
+                "500-999,999.00,500.00,499.00,1,1\n"
+                "1000及以上,0.00,9000.00,-9000.00,0,2\n" +
+                header +
+                "小于1000,1254.00,1199.49,54.51,3,4\n"
+                "1000及以上,0.00,9000.00,-9000.00,0,2\n" +
+                header + "8000及以上,0.00,8000.00,-8000.00,0,1\n");
+  EXPECT_EQ(CommandLine::run({"stats", "--by", "amount", "--buckets", "a"},
+                             out, err),
+            1);
+  EXPECT_EQ(CommandLine::run({"stats", "--by", "amount", "--quantiles", "0"},
+                             out, err),
+            1);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,164 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+struct BalanceIndexFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("bi1", "餐饮"));
+    Category::addCategory(Category("bi2", "工资"));
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("bi1");
+    Category::deleteCategory("bi2");
+  }
+  static bool add(const std::string& id, double amount,
+                  const std::string& date, TransactionType type) {
+    return Transaction::emplaceTransaction(
+        id, amount, date, type == TransactionType::Income ? "bi2" : "bi1",
+        type);
+  }
+  // 逐行扫描得到的参照值：日期字符串在 [from, to] 内的收支合计
+  static double scan(const std::string& from, const std::string& to) {
+    const std::vector<Transaction>& txs = Transaction::list();
+    double sum = 0.0;
+    for (size_t i = 0; i < txs.size(); ++i) {
+      if (Transaction::isDeleted(i)) continue;
+      if (!from.empty() && std::string(txs[i].getTime()) < from) continue;
+      if (!to.empty() && std::string(txs[i].getTime()) > to) continue;
+      sum += txs[i].getType() == TransactionType::Income ? txs[i].getAmount()
+                                                         : -txs[i].getAmount();
+    }
+    return sum;
+  }
+  static void expectMatchesScan() {
+    const char* dates[] = {"", "1900-01-01", "2023-12-31", "2024-01-01",
+                           "2024-01-15", "2024-02", "2024-02-29",
+                           "2024-03-01", "2100-12-31", "zzzz"};
+    for (size_t i = 0; i < sizeof(dates) / sizeof(dates[0]); ++i) {
+      if (dates[i][0] != '\0') {
+        EXPECT_NEAR(BalanceIndex::balanceAt(dates[i]), scan("", dates[i]),
+                    1e-6)
+            << dates[i];
+      }
+      for (size_t j = 0; j < sizeof(dates) / sizeof(dates[0]); ++j) {
+        EXPECT_NEAR(BalanceIndex::netFlow(dates[i], dates[j]),
+                    dates[i][0] != '\0' && dates[j][0] != '\0' &&
+                            std::string(dates[i]) > dates[j]
+                        ? scan(dates[i], "") - scan("", "") +
+                              scan("", dates[j])
+                        : scan(dates[i], dates[j]),
+                    1e-6)
+            << dates[i] << ' ' << dates[j];
+      }
+    }
+    EXPECT_NEAR(BalanceIndex::balanceAt(""), scan("", ""), 1e-6);
+  }
+};
+
+TEST_F(BalanceIndexFixture, Queries_MatchFullScanAcrossEdits) {
+  ASSERT_TRUE(add("B1", 5000, "2024-01-01", TransactionType::Income));
+  ASSERT_TRUE(add("B2", 30.5, "2024-01-15", TransactionType::Expense));
+  ASSERT_TRUE(add("B3", 12, "2024-02-29", TransactionType::Expense));
+  ASSERT_TRUE(add("B4", 7, "1900-01-01", TransactionType::Income));
+  ASSERT_TRUE(add("B5", 99, "2100-12-31", TransactionType::Expense));
+  expectMatchesScan();
+
+  // 建好索引之后的增、改、删都按增量更新
+  ASSERT_TRUE(add("B6", 40, "2023-12-31", TransactionType::Expense));
+  Transaction changed = Transaction::list()[1];
+  changed.setAmount(60);
+  changed.setTime("2024-03-01");
+  ASSERT_TRUE(changed.updateTransaction());
+  ASSERT_TRUE(Transaction::deleteTransaction("B3"));
+  expectMatchesScan();
+
+  SearchQuery query;
+  query.dateRange = {"2024-01-01", "2024-12-31"};
+  EXPECT_EQ(BulkEditService::recategorize(query, "bi1"), 2u);
+  expectMatchesScan();
+  EXPECT_EQ(BulkEditService::deleteMatching(query), 2u);
+  expectMatchesScan();
+
+  std::vector<Transaction> batch;
+  batch.emplace_back("B7", 1, "2024-01-20", "bi2", TransactionType::Income);
+  batch.emplace_back("B8", 2, "2024-01-20", "bi1", TransactionType::Expense);
+  std::vector<ImportError> errors;
+  EXPECT_EQ(Transaction::addTransactions(batch, errors), 2u);
+  expectMatchesScan();
+}
+
+TEST_F(BalanceIndexFixture, DirectRepositoryWrites_RebuildIndex) {
+  ASSERT_TRUE(add("R1", 10, "2024-01-01", TransactionType::Income));
+  EXPECT_NEAR(BalanceIndex::balanceAt(""), 10, 1e-9);
+  // 绕过增删接口直接改仓库时，索引作废并在下次查询时重建
+  Transaction::getRepository().emplace_back("R2", 4, "2024-01-02", "bi1",
+                                            TransactionType::Expense);
+  Transaction::getRepository().emplace_back("R3", 1, "", "bi2",
+                                            TransactionType::Income);
+  Transaction::getRepository().emplace_back("R4", 2, "2024-13-01", "bi2",
+                                            TransactionType::Income);
+  expectMatchesScan();
+
+  // 没有合法日期的交易按日期字符串比较计入
+  ASSERT_TRUE(Transaction::deleteTransaction("R4"));
+  Transaction changed = Transaction::list()[2];
+  changed.setTime("2024-01-03");
+  ASSERT_TRUE(changed.updateTransaction());
+  expectMatchesScan();
+  EXPECT_NEAR(BalanceIndex::netFlow("2024-01-03", "2024-01-03"), 1, 1e-9);
+}
+
+TEST_F(BalanceIndexFixture, Series_TakesBalanceAtPeriodEnds) {
+  EXPECT_TRUE(BalanceIndex::series("", "", TimeGroup::Monthly).empty());
+  ASSERT_TRUE(add("S1", 100, "2023-11-30", TransactionType::Income));
+  ASSERT_TRUE(add("S2", 30, "2024-01-10", TransactionType::Expense));
+  ASSERT_TRUE(add("S3", 5, "2024-01-31", TransactionType::Expense));
+
+  std::vector<BalancePoint> months =
+      BalanceIndex::series("", "", TimeGroup::Monthly);
+  ASSERT_EQ(months.size(), 3u);
+  EXPECT_EQ(months[0].period, "2023-11");
+  EXPECT_EQ(months[1].period, "2023-12");
+  EXPECT_EQ(months[2].period, "2024-01");
+  EXPECT_NEAR(months[1].balance, 100, 1e-9);
+  EXPECT_NEAR(months[2].balance, 65, 1e-9);
+
+  std::vector<BalancePoint> days =
+      BalanceIndex::series("2024-01-09", "2024-01-11", TimeGroup::Daily);
+  ASSERT_EQ(days.size(), 3u);
+  EXPECT_EQ(days[2].period, "2024-01-11");
+  EXPECT_NEAR(days[0].balance, 100, 1e-9);
+  EXPECT_NEAR(days[1].balance, 70, 1e-9);
+
+  std::vector<BalancePoint> years =
+      BalanceIndex::series("2023-12-01", "2024-01-20", TimeGroup::Yearly);
+  ASSERT_EQ(years.size(), 2u);
+  EXPECT_EQ(years[1].period, "2024");
+  EXPECT_NEAR(years[1].balance, 70, 1e-9);
+}
+
+TEST_F(BalanceIndexFixture, CommandLine_Balance) {
+  ASSERT_TRUE(add("C1", 100, "2024-01-01", TransactionType::Income));
+  ASSERT_TRUE(add("C2", 25.5, "2024-02-10", TransactionType::Expense));
+  std::ostringstream out, err;
+  EXPECT_EQ(CommandLine::run({"balance"}, out, err), 0);
+  EXPECT_EQ(CommandLine::run({"balance", "--on", "2024-01-31"}, out, err), 0);
+  EXPECT_EQ(CommandLine::run({"balance", "--from", "2024-02-01"}, out, err),
+            0);
+  EXPECT_EQ(CommandLine::run({"balance", "--by", "month", "--format", "jsonl"},
+                             out, err),
+            0);
+  EXPECT_EQ(out.str(),
+            "74.50\n100.00\n-25.50\n"
+            "{\"key\":\"2024-01\",\"balance\":100.00}\n"
+            "{\"key\":\"2024-02\",\"balance\":74.50}\n");
+  EXPECT_EQ(CommandLine::run({"balance", "--by", "week"}, out, err), 1);
+  EXPECT_EQ(CommandLine::run({"balance", "--on", "2024-1-1"}, out, err), 1);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
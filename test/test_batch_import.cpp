@@ -0,0 +1,102 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+
+using namespace std::filesystem;
+
+struct BatchImportFixture : public ::testing::Test {
+  std::string dbFile;
+  std::string importFile;
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    auto cats = Category::getCategoryList();
+    for (auto &c : cats) Category::deleteCategory(c.getId());
+    Category::addCategory(Category("c1", "餐饮"));
+    Category::addCategory(Category("c2", "交通"));
+    dbFile = "test_batch_import.db";
+    importFile = "test_batch_import.txt";
+    if (exists(dbFile)) remove(dbFile.c_str());
+    DataPersistence::setTestFilePath(dbFile);
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    auto cats = Category::getCategoryList();
+    for (auto &c : cats) Category::deleteCategory(c.getId());
+    if (exists(dbFile)) remove(dbFile.c_str());
+    if (exists(importFile)) remove(importFile.c_str());
+    DataPersistence::setTestFilePath("");
+  }
+};
+
+static Transaction makeTx(const std::string& id, double amount,
+                          const std::string& cat) {
+  Transaction t; t.setId(id); t.setAmount(amount); t.setTime("2024-05-01");
+  t.setCategoryId(cat);
+  return t;
+}
+
+TEST_F(BatchImportFixture, AddTransactions_ReportsRowFailuresWithoutAborting) {
+  Transaction::getRepository().push_back(makeTx("T1", 1, "c1"));
+  std::vector<Transaction> batch = {
+      makeTx("T2", 10, "c1"),
+      makeTx("T1", 20, "c1"),   // 与仓库重复
+      makeTx("T3", -1, "c1"),   // 金额非法
+      makeTx("T4", 30, "nope"), // 分类不存在
+      makeTx("T2", 40, "c2"),   // 与本批次重复
+      makeTx("T5", 50, "c2"),
+  };
+  std::vector<ImportError> errors;
+  EXPECT_EQ(Transaction::addTransactions(batch, errors), 2u);
+  ASSERT_EQ(errors.size(), 4u);
+  EXPECT_EQ(errors[0].row, 1u);
+  EXPECT_EQ(errors[1].row, 2u);
+  EXPECT_EQ(errors[2].row, 3u);
+  EXPECT_EQ(errors[3].row, 4u);
+  ASSERT_EQ(Transaction::list().size(), 3u);
+  EXPECT_EQ(Transaction::list()[1].getId(), "T2");
+  EXPECT_EQ(Transaction::list()[2].getId(), "T5");
+}
+
+TEST_F(BatchImportFixture, ImportFile_ResolvesCategoriesAndSavesOnce) {
+  {
+    std::ofstream out(importFile);
+    out << "# 银行导出\n"
+        << "B1|12.5|2024-01-02|c1|1|早餐\\|豆浆\n"
+        << "|3000|2024-01-05|交通|0|\n"        // 空 ID 自动生成，按名称解析分类
+        << "B3|abc|2024-01-06|c1|1|x\n"        // 金额无效
+        << "B4|5|2024-02-30|c1|1|x\n"          // 日期无效
+        << "B5|5|2024-02-01|未知|1|x\n"        // 分类不存在
+        << "B1|7|2024-02-01|c2|1|dup\n";       // 重复 ID
+  }
+  ImportResult r = ImportService::importFile(importFile);
+  EXPECT_TRUE(r.ok);
+  EXPECT_EQ(r.accepted, 2u);
+  ASSERT_EQ(r.errors.size(), 4u);
+  EXPECT_EQ(r.errors[0].row, 4u);
+  EXPECT_EQ(r.errors[1].row, 5u);
+  EXPECT_EQ(r.errors[2].row, 6u);
+  EXPECT_EQ(r.errors[3].row, 7u);
+
+  ASSERT_EQ(Transaction::list().size(), 2u);
+  EXPECT_EQ(Transaction::list()[0].getRemarks(), "早餐|豆浆");
+  EXPECT_EQ(Transaction::list()[1].getCategoryId(), "c2");
+  EXPECT_EQ(Transaction::list()[1].getType(), TransactionType::Income);
+  EXPECT_FALSE(Transaction::list()[1].getId().empty());
+
+  // 结果已落盘
+  Transaction::getRepository().clear();
+  EXPECT_TRUE(DataPersistence::loadAll());
+  EXPECT_EQ(Transaction::list().size(), 2u);
+}
+
+TEST_F(BatchImportFixture, ImportFile_MissingFileFails) {
+  ImportResult r = ImportService::importFile("no_such_import_file.txt");
+  EXPECT_FALSE(r.ok);
+  EXPECT_EQ(r.accepted, 0u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
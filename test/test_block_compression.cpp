@@ -0,0 +1,165 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+struct BlockCompressionFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("bc1", "餐饮"));
+    Category::addCategory(Category("bc2", "交通"));
+    DataPersistence::setTestFilePath(db);
+  }
+  void TearDown() override {
+    DataPersistence::setCompression(false);
+    DataPersistence::setLayout(StorageLayout::Single);
+    DataPersistence::saveAll();
+    Transaction::getRepository().clear();
+    Category::deleteCategory("bc1");
+    Category::deleteCategory("bc2");
+    DataPersistence::setTestFilePath("");
+    std::remove(db.c_str());
+  }
+  // 跨越多个块，含各种不能按差值或字典编码的字段
+  static void addRows(size_t rows) {
+    std::vector<Transaction>& repo = Transaction::getRepository();
+    for (size_t i = 0; i < rows; ++i) {
+      std::string date = "2023-" + std::string(i % 12 < 9 ? "0" : "") +
+                         std::to_string(i % 12 + 1) + "-15";
+      repo.emplace_back("T" + std::to_string(1000 + 3 * i + i % 3),
+                        i % 5 ? 0.01 * static_cast<double>(i) : 1.0 / 3,
+                        std::move(date), i % 3 ? "bc1" : "bc2",
+                        i % 4 ? TransactionType::Expense
+                              : TransactionType::Income,
+                        i % 2 ? "午饭" : "备注|" + std::to_string(i));
+    }
+    repo.emplace_back("T007", 1e300, "2024-02-30", "bc1",
+                      TransactionType::Income, "a\nb\\c");
+    repo.emplace_back("id-x", 0, "", "bc2", TransactionType::Expense);
+    repo.emplace_back("9", 12345678.91, "1900-01-01", "bc1",
+                      TransactionType::Expense, std::string(300, 'z'));
+  }
+  static std::string readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream text;
+    text << in.rdbuf();
+    return text.str();
+  }
+  static void expectSameRows(const std::vector<Transaction>& expected) {
+    const std::vector<Transaction>& txs = Transaction::list();
+    ASSERT_EQ(txs.size(), expected.size());
+    for (size_t i = 0; i < txs.size(); ++i) {
+      ASSERT_EQ(txs[i].getId(), expected[i].getId()) << i;
+      ASSERT_EQ(txs[i].getAmount(), expected[i].getAmount()) << i;
+      ASSERT_EQ(txs[i].getTime(), expected[i].getTime()) << i;
+      ASSERT_EQ(txs[i].getCategoryId(), expected[i].getCategoryId()) << i;
+      ASSERT_EQ(txs[i].getType(), expected[i].getType()) << i;
+      ASSERT_EQ(txs[i].getRemarks(), expected[i].getRemarks()) << i;
+    }
+  }
+  const std::string db = "test_block_compression.db";
+};
+
+TEST_F(BlockCompressionFixture, RoundTrip_MatchesTextFormatAndIsSmaller) {
+  addRows(3 * BlockCodec::BLOCK_ROWS + 100);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  std::string text = readFile(db);
+  std::vector<Transaction> expected = Transaction::list();
+
+  DataPersistence::setCompression(true);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  EXPECT_LT(readFile(db).size() * 3, text.size());
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  EXPECT_TRUE(DataPersistence::compressionEnabled());
+  expectSameRows(expected);
+  // 块内重复的备注共用同一段文本
+  EXPECT_EQ(Transaction::list()[1].getRemarks().data(),
+            Transaction::list()[3].getRemarks().data());
+  EXPECT_TRUE(Category::categoryExists("bc2"));
+
+  // 关闭后重新写成文本格式（文件头中的 ID 高水位在载入后才更新，不比较）
+  DataPersistence::setCompression(false);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  std::string again = readFile(db);
+  EXPECT_EQ(again.substr(again.find("[CATEGORIES]")),
+            text.substr(text.find("[CATEGORIES]")));
+}
+
+TEST_F(BlockCompressionFixture, Partitions_CompressEachSegment) {
+  addRows(1000);
+  std::vector<Transaction> expected = Transaction::list();
+  DataPersistence::setLayout(StorageLayout::Yearly);
+  DataPersistence::setCompression(true);
+  ASSERT_TRUE(DataPersistence::saveAll());
+
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadManifest());
+  ASSERT_TRUE(DataPersistence::loadRange("2024-01-01", ""));
+  ASSERT_EQ(Transaction::list().size(), 2u);  // 另一行在 undated 分区
+  EXPECT_EQ(Transaction::list()[0].getId(), "T007");
+
+  // 只改动 2024 分区，2023 分区保存时仍是压缩格式，可以照常载入
+  Transaction changed = Transaction::list()[0];
+  changed.setRemarks("改过");
+  ASSERT_TRUE(changed.updateTransaction());
+  ASSERT_TRUE(DataPersistence::saveAll());
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  EXPECT_EQ(Transaction::list().size(), expected.size());
+}
+
+TEST_F(BlockCompressionFixture, CorruptBlock_FailsToLoad) {
+  addRows(500);
+  DataPersistence::setCompression(true);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  {
+    std::fstream file(db, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(-20, std::ios::end);
+    file.put('\x7f');
+  }
+  Transaction::getRepository().clear();
+  EXPECT_FALSE(DataPersistence::loadAll());
+  EXPECT_TRUE(Transaction::list().empty());
+}
+
+TEST(BlockCodecTest, Compress_RoundTrips) {
+  std::string repetitive, noisy;
+  for (int i = 0; i < 20000; ++i) {
+    repetitive += "2024-01-" + std::to_string(i % 28) + "|c1|午饭|";
+  }
+  uint32_t state = 1;
+  for (int i = 0; i < 70000; ++i) {
+    state = state * 1103515245u + 12345u;
+    noisy += static_cast<char>(state >> 24);
+  }
+  const std::string inputs[] = {"", "abc", std::string(100000, 'a'),
+                                repetitive, noisy};
+  for (size_t i = 0; i < 5; ++i) {
+    std::string packed = BlockCodec::compress(inputs[i]);
+    std::string output;
+    ASSERT_TRUE(BlockCodec::decompress(packed, inputs[i].size(), output));
+    EXPECT_EQ(output, inputs[i]);
+    EXPECT_FALSE(BlockCodec::decompress(packed, inputs[i].size() + 1, output));
+  }
+  EXPECT_LT(BlockCodec::compress(repetitive).size() * 4, repetitive.size());
+  std::string output;
+  EXPECT_FALSE(BlockCodec::decompress("\x0f\x01", 100, output));
+}
+
+TEST_F(BlockCompressionFixture, CommandLine_Compress) {
+  addRows(10);
+  std::ostringstream out, err;
+  EXPECT_EQ(CommandLine::run({"compress"}, out, err), 0);
+  EXPECT_EQ(CommandLine::run({"compress", "on"}, out, err), 0);
+  EXPECT_EQ(CommandLine::run({"compress", "maybe"}, out, err), 1);
+  EXPECT_EQ(out.str(), "off\non\n");
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  EXPECT_TRUE(DataPersistence::compressionEnabled());
+  EXPECT_EQ(Transaction::list().size(), 13u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,291 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+struct BudgetFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    BudgetBook::clear();
+    RecurringService::clear();
+    Category::addCategory(Category("bg1", "餐饮"));
+    Category::addCategory(Category("bg2", "交通"));
+    Category::addCategory(Category("bg3", "工资"));
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    BudgetBook::clear();
+    RecurringService::clear();
+    Category::deleteCategory("bg1");
+    Category::deleteCategory("bg2");
+    Category::deleteCategory("bg3");
+    DataPersistence::setTestFilePath("");
+    std::remove(file.c_str());
+  }
+  static bool add(const std::string& id, double amount, const std::string& date,
+                  const std::string& category,
+                  TransactionType type = TransactionType::Expense) {
+    return Transaction::emplaceTransaction(id, amount, date, category, type);
+  }
+  // 逐行扫描得到的参照值：该分类在 date 所在周期内的支出合计
+  static double scan(const Budget& budget, const std::string& date) {
+    std::string_view key = BudgetBook::periodKey(date, budget.period);
+    const std::vector<Transaction>& txs = Transaction::list();
+    double sum = 0.0;
+    for (size_t i = 0; i < txs.size(); ++i) {
+      if (Transaction::isDeleted(i) ||
+          txs[i].getType() != TransactionType::Expense ||
+          txs[i].getCategoryId() != budget.categoryId) {
+        continue;
+      }
+      if (BudgetBook::periodKey(txs[i].getTime(), budget.period) == key) {
+        sum += txs[i].getAmount();
+      }
+    }
+    return sum;
+  }
+  static void expectMatchesScan() {
+    const char* dates[] = {"2024-01-01", "2024-01-31", "2024-02-10",
+                           "2024-03-01", "2023-12-31"};
+    for (size_t d = 0; d < 5; ++d) {
+      std::vector<BudgetStatus> status = BudgetBook::status(dates[d]);
+      ASSERT_EQ(status.size(), BudgetBook::budgets().size());
+      for (size_t i = 0; i < status.size(); ++i) {
+        EXPECT_NEAR(status[i].spent, scan(status[i].budget, dates[d]), 1e-6)
+            << dates[d] << ' ' << status[i].budget.categoryId;
+      }
+    }
+  }
+  const std::string file = "test_budget.db";
+};
+
+TEST_F(BudgetFixture, SetAndRemove_Validate) {
+  EXPECT_TRUE(BudgetBook::setBudget({"bg1", TimeGroup::Monthly, 500}));
+  EXPECT_TRUE(BudgetBook::setBudget({"bg1", TimeGroup::Yearly, 5000}));
+  EXPECT_TRUE(BudgetBook::setBudget({"bg1", TimeGroup::Monthly, 800}));
+  EXPECT_FALSE(BudgetBook::setBudget({"bg9", TimeGroup::Monthly, 100}));
+  EXPECT_FALSE(BudgetBook::setBudget({"bg2", TimeGroup::Monthly, 0}));
+  EXPECT_FALSE(BudgetBook::setBudget({"bg2", TimeGroup::Daily, -1}));
+
+  std::vector<Budget> budgets = BudgetBook::budgets();
+  ASSERT_EQ(budgets.size(), 2u);
+  EXPECT_EQ(budgets[0].period, TimeGroup::Monthly);
+  EXPECT_DOUBLE_EQ(budgets[0].limit, 800);  // 同一分类同一周期只改上限
+  EXPECT_FALSE(BudgetBook::removeBudget("bg1", TimeGroup::Daily));
+  EXPECT_TRUE(BudgetBook::removeBudget("bg1", TimeGroup::Monthly));
+  EXPECT_EQ(BudgetBook::budgets().size(), 1u);
+}
+
+TEST_F(BudgetFixture, Consumption_MatchesFullScanAcrossEdits) {
+  ASSERT_TRUE(add("B1", 120, "2024-01-05", "bg1"));
+  ASSERT_TRUE(add("B2", 30.5, "2024-01-31", "bg1"));
+  ASSERT_TRUE(add("B3", 15, "2024-01-31", "bg2"));
+  ASSERT_TRUE(add("B4", 9000, "2024-01-10", "bg3", TransactionType::Income));
+  ASSERT_TRUE(BudgetBook::setBudget({"bg1", TimeGroup::Monthly, 100}));
+  ASSERT_TRUE(BudgetBook::setBudget({"bg2", TimeGroup::Daily, 10}));
+  ASSERT_TRUE(BudgetBook::setBudget({"bg1", TimeGroup::Yearly, 1000}));
+  expectMatchesScan();
+
+  // 建好之后的增、改、删都按增量更新
+  ASSERT_TRUE(add("B5", 7, "2024-02-10", "bg1"));
+  Transaction changed = Transaction::list()[0];
+  changed.setAmount(60);
+  changed.setTime("2024-03-01");
+  ASSERT_TRUE(changed.updateTransaction());
+  changed = Transaction::list()[3];
+  changed.setType(TransactionType::Expense);
+  changed.setCategoryId("bg1");
+  ASSERT_TRUE(changed.updateTransaction());
+  ASSERT_TRUE(Transaction::deleteTransaction("B3"));
+  expectMatchesScan();
+
+  SearchQuery query;
+  query.dateRange = {"2024-01-01", "2024-01-31"};
+  EXPECT_EQ(BulkEditService::recategorize(query, "bg2"), 2u);
+  expectMatchesScan();
+  std::vector<Transaction> batch;
+  batch.emplace_back("B6", 3, "2024-01-31", "bg2", TransactionType::Expense);
+  batch.emplace_back("B7", 4, "2024-02-10", "bg1", TransactionType::Expense);
+  std::vector<ImportError> errors;
+  EXPECT_EQ(Transaction::addTransactions(batch, errors), 2u);
+  expectMatchesScan();
+  EXPECT_EQ(BulkEditService::deleteMatching(query), 3u);
+  expectMatchesScan();
+
+  // 绕过增删接口直接改仓库时，在下次查询时重建
+  Transaction::getRepository().emplace_back("B8", 50, "2024-02-11", "bg1",
+                                            TransactionType::Expense);
+  expectMatchesScan();
+}
+
+TEST_F(BudgetFixture, Alerts_OnlyOverLimit) {
+  ASSERT_TRUE(BudgetBook::setBudget({"bg1", TimeGroup::Monthly, 100}));
+  ASSERT_TRUE(BudgetBook::setBudget({"bg2", TimeGroup::Monthly, 100}));
+  ASSERT_TRUE(add("A1", 100, "2024-05-01", "bg1"));
+  ASSERT_TRUE(add("A2", 80, "2024-05-02", "bg2"));
+  EXPECT_TRUE(BudgetBook::alerts("2024-05-20").empty());  // 恰好用完不算超支
+
+  ASSERT_TRUE(add("A3", 0.01, "2024-05-31", "bg1"));
+  ASSERT_TRUE(add("A4", 500, "2024-06-01", "bg2"));
+  std::vector<BudgetStatus> alerts = BudgetBook::alerts("2024-05-20");
+  ASSERT_EQ(alerts.size(), 1u);
+  EXPECT_EQ(alerts[0].budget.categoryId, LedgerId("bg1"));
+  EXPECT_EQ(alerts[0].periodKey, "2024-05");
+  EXPECT_NEAR(alerts[0].remaining(), -0.01, 1e-9);
+  EXPECT_EQ(BudgetBook::alerts("2024-06-01").size(), 1u);
+  EXPECT_TRUE(BudgetBook::alerts("2024-07-01").empty());
+}
+
+TEST(RecurringService, Advance_KeepsDayOfMonth) {
+  EXPECT_EQ(RecurringService::advance("2024-02-28", TimeGroup::Daily, 28),
+            "2024-02-29");
+  EXPECT_EQ(RecurringService::advance("2024-12-31", TimeGroup::Daily, 31),
+            "2025-01-01");
+  EXPECT_EQ(RecurringService::advance("2024-01-31", TimeGroup::Monthly, 31),
+            "2024-02-29");
+  EXPECT_EQ(RecurringService::advance("2024-02-29", TimeGroup::Monthly, 31),
+            "2024-03-31");
+  EXPECT_EQ(RecurringService::advance("2024-12-15", TimeGroup::Monthly, 15),
+            "2025-01-15");
+  EXPECT_EQ(RecurringService::advance("2024-02-29", TimeGroup::Yearly, 29),
+            "2025-02-28");
+  EXPECT_EQ(RecurringService::advance("2027-02-28", TimeGroup::Yearly, 29),
+            "2028-02-29");
+}
+
+TEST_F(BudgetFixture, Recurring_PostsDueOccurrencesOnce) {
+  RecurringTemplate rent{"", 3000, "bg2", TransactionType::Expense,
+                         TimeGroup::Monthly, "2024-01-31", 0, "房租"};
+  ASSERT_TRUE(RecurringService::addTemplate(rent));
+  RecurringTemplate salary{"", 8000, "bg3", TransactionType::Income,
+                           TimeGroup::Monthly, "2024-02-10", 0, "工资"};
+  ASSERT_TRUE(RecurringService::addTemplate(salary));
+  rent.id = "R1";
+  EXPECT_FALSE(RecurringService::addTemplate(rent));  // ID 重复
+  rent.id = "";
+  rent.categoryId = "bg9";
+  EXPECT_FALSE(RecurringService::addTemplate(rent));
+  ASSERT_TRUE(BudgetBook::setBudget({"bg2", TimeGroup::Monthly, 2000}));
+  EXPECT_TRUE(BudgetBook::alerts("2024-03-15").empty());
+
+  EXPECT_EQ(RecurringService::post("2024-03-30"), 4u);
+  EXPECT_EQ(RecurringService::post("2024-03-30"), 0u);  // 已补记的不再重复
+  std::vector<RecurringTemplate> templates = RecurringService::templates();
+  ASSERT_EQ(templates.size(), 2u);
+  EXPECT_EQ(templates[0].id, LedgerId("R1"));
+  EXPECT_EQ(templates[0].next, "2024-03-31");
+  EXPECT_EQ(templates[1].id, LedgerId("R2"));
+  EXPECT_EQ(templates[1].next, "2024-04-10");
+
+  std::vector<std::string> dates;
+  for (size_t i = 0; i < Transaction::list().size(); ++i) {
+    dates.push_back(Transaction::list()[i].getTime());
+  }
+  EXPECT_EQ(dates, (std::vector<std::string>{"2024-01-31", "2024-02-29",
+                                             "2024-02-10", "2024-03-10"}));
+  // 补记的交易同样计入预算
+  ASSERT_EQ(BudgetBook::alerts("2024-02-01").size(), 1u);
+  EXPECT_NEAR(BudgetBook::alerts("2024-02-01")[0].spent, 3000, 1e-9);
+  EXPECT_TRUE(RecurringService::removeTemplate("R1"));
+  EXPECT_FALSE(RecurringService::removeTemplate("R1"));
+}
+
+TEST_F(BudgetFixture, BudgetsAndTemplates_SurviveSaveAndReload) {
+  ASSERT_TRUE(BudgetBook::setBudget({"bg1", TimeGroup::Monthly, 1234567.5}));
+  ASSERT_TRUE(BudgetBook::setBudget({"bg2", TimeGroup::Daily, 20}));
+  ASSERT_TRUE(RecurringService::addTemplate(
+      {"R7", 99.9, "bg1", TransactionType::Expense, TimeGroup::Yearly,
+       "2024-02-29", 0, "年费|会员\n续订"}));
+  ASSERT_TRUE(add("S1", 25, "2024-02-29", "bg2"));
+
+  DataPersistence::setTestFilePath(file);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  Transaction::getRepository().clear();
+  BudgetBook::clear();
+  RecurringService::clear();
+  ASSERT_TRUE(DataPersistence::loadAll());
+
+  std::vector<Budget> budgets = BudgetBook::budgets();
+  ASSERT_EQ(budgets.size(), 2u);
+  EXPECT_EQ(budgets[0].categoryId, LedgerId("bg1"));
+  EXPECT_DOUBLE_EQ(budgets[0].limit, 1234567.5);
+  EXPECT_EQ(budgets[1].period, TimeGroup::Daily);
+  std::vector<BudgetStatus> alerts = BudgetBook::alerts("2024-02-29");
+  ASSERT_EQ(alerts.size(), 1u);
+  EXPECT_DOUBLE_EQ(alerts[0].spent, 25);
+
+  std::vector<RecurringTemplate> templates = RecurringService::templates();
+  ASSERT_EQ(templates.size(), 1u);
+  EXPECT_EQ(templates[0].remarks, "年费|会员\n续订");
+  EXPECT_EQ(templates[0].day, 29);
+  EXPECT_EQ(templates[0].every, TimeGroup::Yearly);
+  EXPECT_EQ(RecurringService::post("2025-03-01"), 2u);
+  EXPECT_EQ(RecurringService::templates()[0].next, "2026-02-28");
+}
+
+TEST_F(BudgetFixture, CommandLine_BudgetAndRecurring) {
+  std::ostringstream out, err;
+  ASSERT_EQ(CommandLine::run({"budget", "set", "--category", "bg1",
+                              "--limit", "100"},
+                             out, err),
+            0);
+  ASSERT_EQ(CommandLine::run({"recurring", "add", "--amount", "60",
+                              "--start", "2024-04-20", "--category", "bg1",
+                              "--remarks", "会员"},
+                             out, err),
+            0);
+  ASSERT_EQ(CommandLine::run({"recurring", "run", "--until", "2024-05-31"},
+                             out, err),
+            0);
+  ASSERT_EQ(CommandLine::run({"budget", "--on", "2024-05-01"}, out, err), 0);
+  ASSERT_EQ(CommandLine::run({"budget", "alerts", "--on", "2024-05-01",
+                              "--format", "jsonl"},
+                             out, err),
+            0);
+  ASSERT_EQ(CommandLine::run({"recurring", "list"}, out, err), 0);
+  EXPECT_EQ(out.str(),
+            "R1\n2\n"
+            "category,period,key,limit,spent,remaining,over_limit\n"
+            "bg1,month,2024-05,100.00,60.00,40.00,0\n"
+            "id,amount,category,type,every,next,remarks\n"
+            "R1,60.00,bg1,expense,month,2024-06-20,会员\n");
+
+  out.str("");
+  ASSERT_TRUE(add("C1", 50, "2024-05-02", "bg1"));
+  ASSERT_EQ(CommandLine::run({"budget", "alerts", "--on", "2024-05-01",
+                              "--format", "jsonl"},
+                             out, err),
+            0);
+  EXPECT_EQ(out.str(),
+            "{\"category\":\"bg1\",\"period\":\"month\",\"key\":\"2024-05\","
+            "\"limit\":100.00,\"spent\":110.00,\"remaining\":-10.00,"
+            "\"over_limit\":true}\n");
+
+  EXPECT_EQ(CommandLine::run({"budget", "set", "--category", "bg9",
+                              "--limit", "1"},
+                             out, err),
+            1);
+  EXPECT_EQ(CommandLine::run({"budget", "set", "--category", "bg1",
+                              "--limit", "0"},
+                             out, err),
+            1);
+  EXPECT_EQ(CommandLine::run({"budget", "set", "--category", "bg1",
+                              "--limit", "5", "--period", "week"},
+                             out, err),
+            1);
+  EXPECT_EQ(CommandLine::run({"budget", "--on", "2024-5-1"}, out, err), 1);
+  EXPECT_EQ(CommandLine::run({"recurring", "add", "--amount", "1",
+                              "--start", "2024-02-30", "--category", "bg1"},
+                             out, err),
+            1);
+  EXPECT_EQ(CommandLine::run({"recurring", "remove", "R9"}, out, err), 1);
+  EXPECT_EQ(CommandLine::run({"recurring", "remove", "R1"}, out, err), 0);
+  EXPECT_EQ(CommandLine::run({"budget", "remove", "--category", "bg1"}, out,
+                             err),
+            0);
+  EXPECT_TRUE(BudgetBook::budgets().empty());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,111 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+struct BulkEditFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("be1", "餐饮"));
+    Category::addCategory(Category("be2", "交通"));
+    DataPersistence::setTestFilePath(file);
+    // 2023 年 6 行、2024 年 6 行，备注交替含 "外卖"
+    for (int i = 0; i < 12; ++i) {
+      ASSERT_TRUE(Transaction::emplaceTransaction(
+          "B" + std::to_string(i), 10.0 * (i + 1),
+          (i < 6 ? "2023-03-0" : "2024-03-0") + std::to_string(i % 6 + 1),
+          "be1", TransactionType::Expense, i % 2 ? "外卖" : "堂食"));
+    }
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("be1");
+    Category::deleteCategory("be2");
+    DataPersistence::setTestFilePath("");
+    std::remove(file.c_str());
+  }
+  static SearchQuery yearQuery(const std::string& year) {
+    SearchQuery query;
+    query.dateRange = {year + "-01-01", year + "-12-31"};
+    return query;
+  }
+  const std::string file = "test_bulk_edit.db";
+};
+
+TEST_F(BulkEditFixture, DeleteMatching_RemovesExactlyTheSearchHits) {
+  SearchQuery query = yearQuery("2023");
+  query.keyword = "外卖";
+  size_t expected = QueryCache::search(query)->size();
+  ASSERT_EQ(expected, 3u);
+  EXPECT_EQ(BulkEditService::deleteMatching(query), expected);
+  EXPECT_TRUE(QueryCache::search(query)->empty());
+  EXPECT_EQ(Transaction::liveCount(), 9u);
+  EXPECT_EQ(BulkEditService::deleteMatching(query), 0u);
+
+  // 删除后索引仍然一致：被删的 ID 可以重新添加，其余 ID 仍然查重
+  EXPECT_TRUE(Transaction::emplaceTransaction(
+      "B1", 1, "2023-05-01", "be1", TransactionType::Income));
+  EXPECT_FALSE(Transaction::emplaceTransaction(
+      "B0", 1, "2023-05-01", "be1", TransactionType::Income));
+
+  // 整批只保存一次，文件里已是删除后的结果
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  EXPECT_EQ(Transaction::list().size(), 9u);
+}
+
+TEST_F(BulkEditFixture, DeleteMatching_CompactsPastThreshold) {
+  EXPECT_EQ(BulkEditService::deleteMatching(yearQuery("2024")), 6u);
+  EXPECT_EQ(Transaction::deletedCount(), 0u);
+  ASSERT_EQ(Transaction::list().size(), 6u);
+  EXPECT_EQ(Transaction::list()[5].getId(), "B5");
+  EXPECT_TRUE(Transaction::deleteTransaction("B5"));
+}
+
+TEST_F(BulkEditFixture, Recategorize_AndRemarks) {
+  ASSERT_TRUE(Transaction::deleteTransaction("B7"));
+  SearchQuery query = yearQuery("2024");
+  EXPECT_EQ(BulkEditService::recategorize(query, "nope"), 0u);
+  EXPECT_EQ(BulkEditService::recategorize(query, "be2"), 5u);
+  SearchQuery moved;
+  moved.categoryId = "be2";
+  EXPECT_EQ(QueryCache::search(moved)->size(), 5u);
+
+  query.keyword = "外卖";
+  EXPECT_EQ(BulkEditService::appendRemarks(query, "(报销)"), 2u);
+  EXPECT_EQ(BulkEditService::setRemarks(yearQuery("2023"), "旧账"), 6u);
+  EXPECT_EQ(Transaction::list()[9].getRemarks(), "外卖(报销)");
+  EXPECT_EQ(Transaction::list()[0].getRemarks(), "旧账");
+
+  // 修改函数改动 ID 时被还原，索引保持可用
+  EXPECT_EQ(Transaction::updateWhere(
+                [](const Transaction& tx) { return tx.getId() == "B0"; },
+                [](Transaction& tx) { tx.setId("X"); }),
+            1u);
+  EXPECT_EQ(Transaction::list()[0].getId(), "B0");
+  EXPECT_TRUE(Transaction::deleteTransaction("B0"));
+}
+
+TEST_F(BulkEditFixture, CommandLine_BulkDeleteAndUpdate) {
+  std::ostringstream out, err;
+  EXPECT_EQ(CommandLine::run({"bulk-delete"}, out, err), 1);
+  EXPECT_EQ(Transaction::liveCount(), 12u);
+  // 漏写检索条件时不能改动全部交易
+  EXPECT_EQ(CommandLine::run({"bulk-update", "--set-remarks", "x"}, out, err),
+            1);
+  EXPECT_NE(err.str().find("批量修改至少需要一个检索条件"), std::string::npos);
+  EXPECT_EQ(Transaction::list()[0].getRemarks(), "堂食");
+
+  EXPECT_EQ(CommandLine::run({"bulk-update", "--from", "2024-01-01",
+                              "--set-category", "be2"}, out, err), 0);
+  EXPECT_EQ(CommandLine::run({"bulk-update", "--set-category", "none"},
+                             out, err), 1);
+  EXPECT_EQ(CommandLine::run({"bulk-delete", "--category", "be2",
+                              "--max", "90"}, out, err), 0);
+  EXPECT_EQ(out.str(), "已修改 6 条\n已删除 3 条\n");
+  EXPECT_EQ(Transaction::liveCount(), 9u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,85 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+struct CommandLineFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("tc1", "餐饮"));
+    Category::addCategory(Category("tc2", "工资"));
+    add("L1", 12.5, "2024-01-03", "tc1", TransactionType::Expense, "午饭");
+    add("L2", 3000, "2024-01-10", "tc2", TransactionType::Income, "一月");
+    add("L3", 40, "2024-02-01", "tc1", TransactionType::Expense, "聚餐,\"火锅\"");
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("tc1");
+    Category::deleteCategory("tc2");
+  }
+  static void add(const std::string& id, double amount, const std::string& date,
+                  const std::string& cat, TransactionType type,
+                  const std::string& remarks) {
+    Transaction t; t.setId(id); t.setAmount(amount); t.setTime(date);
+    t.setCategoryId(cat); t.setType(type); t.setRemarks(remarks);
+    Transaction::getRepository().push_back(t);
+  }
+  int run(const std::vector<std::string>& args) {
+    out.str(""); err.str("");
+    return CommandLine::run(args, out, err);
+  }
+  std::ostringstream out, err;
+};
+
+TEST_F(CommandLineFixture, Search_CsvWithFiltersAndSort) {
+  EXPECT_EQ(run({"search", "--category", "tc1", "--sort", "amount", "--desc"}), 0);
+  EXPECT_EQ(out.str(),
+            "id,amount,date,category_id,category_name,type,remarks\n"
+            "L3,40.00,2024-02-01,tc1,餐饮,expense,\"聚餐,\"\"火锅\"\"\"\n"
+            "L1,12.50,2024-01-03,tc1,餐饮,expense,午饭\n");
+}
+
+TEST_F(CommandLineFixture, Search_AmountBoundsAndDateRange) {
+  EXPECT_EQ(run({"search", "--min", "20", "--to", "2024-01-31"}), 0);
+  EXPECT_NE(out.str().find("L2,"), std::string::npos);
+  EXPECT_EQ(out.str().find("L1,"), std::string::npos);
+  EXPECT_EQ(out.str().find("L3,"), std::string::npos);
+}
+
+TEST_F(CommandLineFixture, Stats_ByMonthJson) {
+  EXPECT_EQ(run({"stats", "--by", "month", "--format", "json"}), 0);
+  EXPECT_EQ(out.str(),
+            "{\"total_income\":3000.00,\"total_expense\":52.50,"
+            "\"balance\":2947.50,\"rows\":[\n"
+            "{\"key\":\"2024-01\",\"income\":3000.00,\"expense\":12.50,"
+            "\"balance\":2987.50,\"income_count\":1,\"expense_count\":1},\n"
+            "{\"key\":\"2024-02\",\"income\":0.00,\"expense\":40.00,"
+            "\"balance\":-40.00,\"income_count\":0,\"expense_count\":1}\n"
+            "]}\n");
+}
+
+TEST_F(CommandLineFixture, Stats_ByCategoryWithinRange) {
+  EXPECT_EQ(run({"stats", "--by", "category", "--from", "2024-02-01"}), 0);
+  EXPECT_EQ(out.str(),
+            "key,income,expense,balance,income_count,expense_count\n"
+            "餐饮,0.00,40.00,-40.00,0,1\n");
+}
+
+TEST_F(CommandLineFixture, InvalidArguments_ReturnError) {
+  EXPECT_EQ(run({"stats", "--by", "week"}), 1);
+  EXPECT_EQ(run({"search", "--from", "2024-13-01"}), 1);
+  EXPECT_EQ(run({"search", "--min"}), 1);
+  EXPECT_EQ(run({"search", "--format", "xml"}), 1);
+  EXPECT_EQ(run({"unknown"}), 1);
+  EXPECT_TRUE(out.str().empty());
+}
+
+TEST_F(CommandLineFixture, Export_JsonEscapesStrings) {
+  EXPECT_EQ(run({"export", "--format", "json"}), 0);
+  EXPECT_NE(out.str().find("\"remarks\":\"聚餐,\\\"火锅\\\"\""),
+            std::string::npos);
+  EXPECT_EQ(out.str().front(), '[');
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
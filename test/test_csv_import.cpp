@@ -0,0 +1,179 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+struct CsvImportFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("ci1", "餐饮"));
+    Category::addCategory(Category("ci2", "工资"));
+    IdAllocator::reset();
+    DataPersistence::setTestFilePath(db);
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    std::vector<Category> cats = Category::getCategoryList();
+    for (size_t i = 0; i < cats.size(); ++i) {
+      Category::deleteCategory(cats[i].getId());
+    }
+    DataPersistence::setTestFilePath("");
+    std::remove(db.c_str());
+    std::remove(csv.c_str());
+  }
+  void writeCsv(const std::string& text) {
+    std::ofstream out(csv, std::ios::binary);
+    out << text;
+  }
+  const std::string db = "test_csv_import.db";
+  const std::string csv = "test_csv_import.csv";
+};
+
+TEST_F(CsvImportFixture, ExportedCsv_RoundTrips) {
+  ASSERT_TRUE(Transaction::emplaceTransaction(
+      "R1", 12.5, "2024-03-01", "ci1", TransactionType::Expense,
+      "午饭, \"加蛋\"\n两份"));
+  ASSERT_TRUE(Transaction::emplaceTransaction(
+      "R2", 8000, "2024-03-05", "ci2", TransactionType::Income));
+  {
+    std::ofstream out(csv);
+    ReportWriter::writeTransactions(out, Transaction::list(),
+                                    OutputFormat::Csv);
+  }
+  std::vector<Transaction> before = Transaction::list();
+  Transaction::getRepository().clear();
+
+  ImportResult result = ImportService::importCsv(csv);
+  ASSERT_TRUE(result.ok);
+  EXPECT_EQ(result.accepted, 2u);
+  EXPECT_TRUE(result.errors.empty());
+  EXPECT_EQ(result.categoriesCreated, 0u);
+  ASSERT_EQ(Transaction::list().size(), 2u);
+  for (size_t i = 0; i < 2; ++i) {
+    const Transaction& tx = Transaction::list()[i];
+    EXPECT_EQ(tx.getId(), before[i].getId());
+    EXPECT_EQ(tx.getAmount(), before[i].getAmount());
+    EXPECT_EQ(tx.getTime(), before[i].getTime());
+    EXPECT_EQ(tx.getCategoryId(), before[i].getCategoryId());
+    EXPECT_EQ(tx.getType(), before[i].getType());
+    EXPECT_EQ(tx.getRemarks(), before[i].getRemarks());
+  }
+}
+
+TEST_F(CsvImportFixture, BankStatement_MapsColumnsAndCreatesCategories) {
+  writeCsv("\xEF\xBB\xBF交易日期,金额,摘要,类别\r\n"
+           "2024/01/05,-35.50,\"面馆\r\n加面\",餐饮\r\n"
+           "2024/01/06,\"1,200.00\",报销, 差旅 \r\n"
+           "2024-13-01,1,日期错,餐饮\r\n"
+           "2024/01/07,-20,打车,差旅\r\n"
+           "2024/01/08,abc,金额错,餐饮\r\n");
+  CsvImportOptions options;
+  options.dateColumn = "交易日期";
+  options.amountColumn = "金额";
+  options.remarksColumn = "摘要";
+  options.categoryColumn = "类别";
+  ImportResult result = ImportService::importCsv(csv, options);
+  ASSERT_TRUE(result.ok);
+  EXPECT_EQ(result.accepted, 3u);
+  EXPECT_EQ(result.categoriesCreated, 1u);
+  ASSERT_EQ(result.errors.size(), 2u);
+  EXPECT_EQ(result.errors[0].row, 5u);  // 引号内的换行也计入行号
+  EXPECT_EQ(result.errors[1].row, 7u);
+
+  const std::vector<Transaction>& txs = Transaction::list();
+  ASSERT_EQ(txs.size(), 3u);
+  EXPECT_EQ(txs[0].getType(), TransactionType::Expense);
+  EXPECT_EQ(txs[0].getAmount(), 35.5);
+  EXPECT_EQ(txs[0].getTime(), "2024-01-05");
+  EXPECT_EQ(txs[0].getCategoryId(), "ci1");
+  EXPECT_EQ(txs[0].getRemarks(), "面馆\r\n加面");
+  EXPECT_EQ(txs[1].getType(), TransactionType::Income);
+  EXPECT_EQ(txs[1].getAmount(), 1200.0);
+  // 新分类只建一次，两行都指向它
+  EXPECT_EQ(txs[1].getCategoryId(), txs[2].getCategoryId());
+  EXPECT_EQ(txs[1].getCategoryId(), "c100");
+  EXPECT_EQ(Category::findCategory("c100")->getName(), "差旅");
+  EXPECT_EQ(txs[0].getId(), "T1000");
+  EXPECT_EQ(txs[2].getId(), "T1002");
+}
+
+TEST_F(CsvImportFixture, ChunksAndThreads_KeepFileOrder) {
+  std::string text = "amount,date,category_name,type,remarks\n";
+  for (int i = 0; i < 10000; ++i) {
+    text += std::to_string(i) + ",2024-02-01," +
+            (i % 2 ? "ci1" : "工资") + "," + (i % 2 ? "expense" : "income") +
+            ",\"第" + std::to_string(i) + "条,\"\"备注\"\"\"\n";
+  }
+  text += "1,2024-02-02,ci1,bad,类型错\n";
+  writeCsv(text);
+  CsvImportOptions options;
+  // 每块约 3000 条记录，分给 3 个线程；块边界落在记录中间
+  options.threads = 4;
+  options.chunkSize = 150000;
+  ImportResult result = ImportService::importCsv(csv, options);
+  ASSERT_TRUE(result.ok);
+  EXPECT_EQ(result.accepted, 10000u);
+  ASSERT_EQ(result.errors.size(), 1u);
+  EXPECT_EQ(result.errors[0].row, 10002u);
+
+  const std::vector<Transaction>& txs = Transaction::list();
+  ASSERT_EQ(txs.size(), 10000u);
+  for (size_t i = 0; i < txs.size(); ++i) {
+    ASSERT_EQ(txs[i].getAmount(), static_cast<double>(i));
+    ASSERT_EQ(txs[i].getId(), "T" + std::to_string(1000 + i));
+    ASSERT_EQ(txs[i].getCategoryId(), i % 2 ? "ci1" : "ci2");
+    ASSERT_EQ(txs[i].getRemarks(), "第" + std::to_string(i) + "条,\"备注\"");
+  }
+}
+
+TEST_F(CsvImportFixture, CreatedCategoryNames_SurviveReload) {
+  writeCsv("amount,date,category_name\n"
+           "1,2024-04-01,餐饮|外卖\n"
+           "2,2024-04-02,\"夜宵\r\n烧烤\\\"\n");
+  ImportResult result = ImportService::importCsv(csv);
+  ASSERT_TRUE(result.ok);
+  ASSERT_EQ(result.categoriesCreated, 2u);
+  ASSERT_TRUE(DataPersistence::saveAll());
+
+  Transaction::getRepository().clear();
+  std::vector<Category> cats = Category::getCategoryList();
+  for (size_t i = 0; i < cats.size(); ++i) {
+    Category::deleteCategory(cats[i].getId());
+  }
+  ASSERT_TRUE(DataPersistence::loadAll());
+  ASSERT_EQ(Transaction::list().size(), 2u);
+  const Category* first =
+      Category::findCategory(Transaction::list()[0].getCategoryId());
+  const Category* second =
+      Category::findCategory(Transaction::list()[1].getCategoryId());
+  ASSERT_NE(first, nullptr);
+  ASSERT_NE(second, nullptr);
+  EXPECT_EQ(first->getName(), "餐饮|外卖");
+  EXPECT_EQ(second->getName(), "夜宵\r\n烧烤\\");
+}
+
+TEST_F(CsvImportFixture, MissingColumnOrFile_Fails) {
+  writeCsv("amount,when,category_name\n1,2024-01-01,ci1\n");
+  ImportResult result = ImportService::importCsv(csv);
+  EXPECT_FALSE(result.ok);
+  ASSERT_EQ(result.errors.size(), 1u);
+  EXPECT_EQ(result.errors[0].reason, "表头缺少列: date");
+  EXPECT_TRUE(Transaction::list().empty());
+  EXPECT_FALSE(ImportService::importCsv("no_such_file.csv").ok);
+
+  std::ostringstream out, err;
+  // 线程数不是正整数时不导入
+  EXPECT_EQ(CommandLine::run({"import", csv, "--date-column", "when",
+                              "--threads", "abc"}, out, err), 1);
+  EXPECT_EQ(CommandLine::run({"import", csv, "--date-column", "when",
+                              "--threads", "-1"}, out, err), 1);
+  EXPECT_NE(err.str().find("线程数无效: -1"), std::string::npos);
+  EXPECT_TRUE(Transaction::list().empty());
+  EXPECT_EQ(CommandLine::run({"import", csv, "--date-column", "when"}, out,
+                             err), 0);
+  EXPECT_EQ(Transaction::list().size(), 1u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,87 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+struct EmplaceFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("ec1", "餐饮"));
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("ec1");
+    Category::deleteCategory("ec2");
+  }
+};
+
+TEST_F(EmplaceFixture, EmplaceTransaction_MovesStringsIntoRepository) {
+  // 超出短字符串优化的长度，移动后缓冲区地址应保持不变
+  std::string remarks(64, 'r');
+  const char* buffer = remarks.data();
+  ASSERT_TRUE(Transaction::emplaceTransaction(
+      "E1", 12.5, "2024-06-01", "ec1", TransactionType::Income,
+      std::move(remarks)));
+  const Transaction& added = Transaction::list().back();
+  EXPECT_EQ(added.getRemarks().data(), buffer);
+  EXPECT_EQ(added.getAmount(), 12.5);
+  EXPECT_EQ(added.getType(), TransactionType::Income);
+
+  Transaction tx("E2", 3, "2024-06-02", "ec1", TransactionType::Expense,
+                 std::string(64, 's'));
+  buffer = tx.getRemarks().data();
+  ASSERT_TRUE(Transaction::addTransaction(std::move(tx)));
+  EXPECT_EQ(Transaction::list().back().getRemarks().data(), buffer);
+}
+
+TEST_F(EmplaceFixture, EmplaceTransaction_RejectsInvalidAndDuplicate) {
+  ASSERT_TRUE(Transaction::emplaceTransaction(
+      "E1", 1, "2024-06-01", "ec1", TransactionType::Expense));
+  EXPECT_FALSE(Transaction::emplaceTransaction(
+      "E1", 2, "2024-06-02", "ec1", TransactionType::Expense));
+  EXPECT_FALSE(Transaction::emplaceTransaction(
+      "", 2, "2024-06-02", "ec1", TransactionType::Expense));
+  EXPECT_FALSE(Transaction::emplaceTransaction(
+      "E3", -1, "2024-06-02", "ec1", TransactionType::Expense));
+  ASSERT_EQ(Transaction::list().size(), 1u);
+  EXPECT_EQ(Transaction::list()[0].getAmount(), 1);
+}
+
+TEST_F(EmplaceFixture, EmplaceCategory_AndForEachCategory) {
+  EXPECT_TRUE(Category::emplaceCategory("ec2", "工资"));
+  EXPECT_FALSE(Category::emplaceCategory("ec2", "重复"));
+  EXPECT_FALSE(Category::emplaceCategory("", "空"));
+
+  std::vector<const Category*> seen;
+  Category::forEachCategory([&seen](const Category& c) {
+    if (c.getId() == "ec1" || c.getId() == "ec2") seen.push_back(&c);
+  });
+  ASSERT_EQ(seen.size(), 2u);
+  EXPECT_EQ(seen[0]->getName(), "餐饮");
+  EXPECT_EQ(seen[1]->getName(), "工资");
+  // 访问的是仓库中的元素本身而不是副本
+  EXPECT_EQ(seen[1], Category::findCategory("ec2"));
+}
+
+TEST_F(EmplaceFixture, LoadAll_KeepsEscapedFields) {
+  ASSERT_TRUE(Transaction::emplaceTransaction(
+      "E1", 1, "2024-06-01", "ec1", TransactionType::Expense, "a|b\\c\nd"));
+  ASSERT_TRUE(Transaction::emplaceTransaction(
+      "E2", 2, "2024-06-02", "ec1", TransactionType::Income, "plain"));
+  const std::string file = "test_emplace.db";
+  DataPersistence::setTestFilePath(file);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  Transaction::getRepository().clear();
+  Category::deleteCategory("ec1");
+  ASSERT_TRUE(DataPersistence::loadAll());
+  DataPersistence::setTestFilePath("");
+  std::remove(file.c_str());
+
+  ASSERT_EQ(Transaction::list().size(), 2u);
+  EXPECT_EQ(Transaction::list()[0].getRemarks(), "a|b\\c\nd");
+  EXPECT_EQ(Transaction::list()[1].getRemarks(), "plain");
+  EXPECT_TRUE(Category::categoryExists("ec1"));
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,74 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+
+struct ExportFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("ex1", "餐饮"));
+    Category::addCategory(Category("ex2", "交通"));
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("ex1");
+    Category::deleteCategory("ex2");
+  }
+  static void addRows(size_t rows, size_t remarkLength) {
+    for (size_t i = 0; i < rows; ++i) {
+      ASSERT_TRUE(Transaction::emplaceTransaction(
+          "X" + std::to_string(i), 0.5 * static_cast<double>(i),
+          i % 2 ? "2024-01-15" : "2023-06-30", i % 3 ? "ex1" : "ex2",
+          TransactionType::Expense,
+          std::string(remarkLength, 'a') + (i % 4 ? "\"x\"," : "\n")));
+    }
+  }
+};
+
+TEST_F(ExportFixture, JsonLines_OneObjectPerLine) {
+  addRows(3, 1);
+  ASSERT_TRUE(Transaction::deleteTransaction("X1"));
+  std::ostringstream out;
+  ReportWriter::writeTransactions(out, Transaction::list(),
+                                  OutputFormat::JsonLines);
+  EXPECT_EQ(out.str(),
+            "{\"id\":\"X0\",\"amount\":0.00,\"date\":\"2023-06-30\","
+            "\"category_id\":\"ex2\",\"category_name\":\"交通\","
+            "\"type\":\"expense\",\"remarks\":\"a\\n\"}\n"
+            "{\"id\":\"X2\",\"amount\":1.00,\"date\":\"2023-06-30\","
+            "\"category_id\":\"ex1\",\"category_name\":\"餐饮\","
+            "\"type\":\"expense\",\"remarks\":\"a\\\"x\\\",\"}\n");
+}
+
+TEST_F(ExportFixture, FilteredExport_MatchesSearchOutputAcrossBufferFlushes) {
+  // 命中约 2000 行、3 MiB，跨越多次缓冲区写出
+  addRows(6000, 1500);
+  SearchQuery query;
+  query.dateRange = {"2024-01-01", ""};
+  query.categoryId = "ex1";
+  const OutputFormat formats[] = {OutputFormat::Csv, OutputFormat::Json,
+                                  OutputFormat::JsonLines};
+  for (size_t i = 0; i < 3; ++i) {
+    std::ostringstream streamed, materialized;
+    ReportWriter::exportTransactions(streamed, query, formats[i]);
+    ReportWriter::writeTransactions(materialized, *QueryCache::search(query),
+                                    formats[i]);
+    EXPECT_GT(streamed.str().size(), 2 * ReportWriter::BUFFER_SIZE);
+    EXPECT_EQ(streamed.str(), materialized.str());
+  }
+}
+
+TEST_F(ExportFixture, CommandLine_ExportWithConditions) {
+  addRows(6, 0);
+  std::ostringstream out, err;
+  ASSERT_EQ(CommandLine::run({"export", "--format", "jsonl", "--category",
+                              "ex2"}, out, err), 0);
+  std::string text = out.str();
+  EXPECT_EQ(text.find("\"X1\""), std::string::npos);
+  EXPECT_EQ(std::count(text.begin(), text.end(), '\n'), 2);
+  EXPECT_EQ(CommandLine::run({"export", "--from", "bad"}, out, err), 1);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
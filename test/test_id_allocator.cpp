@@ -0,0 +1,115 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdio>
+
+struct IdAllocatorFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("ia1", "餐饮"));
+    IdAllocator::reset();
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("ia1");
+    DataPersistence::setTestFilePath("");
+    std::remove(file.c_str());
+  }
+  static bool add(const std::string& id) {
+    return Transaction::emplaceTransaction(id, 1, "2024-01-01", "ia1",
+                                           TransactionType::Expense);
+  }
+  const std::string file = "test_id_allocator.db";
+};
+
+TEST_F(IdAllocatorFixture, ConcurrentBlocks_DoNotOverlap) {
+  const int threads = 8, rounds = 500;
+  std::vector<std::vector<int64_t>> firsts(threads);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&firsts, t]() {
+      for (int r = 0; r < rounds; ++r) {
+        firsts[t].push_back(
+            IdAllocator::reserve(IdAllocator::TransactionIds, 3));
+      }
+    });
+  }
+  for (size_t i = 0; i < workers.size(); ++i) workers[i].join();
+
+  std::vector<int64_t> all;
+  for (int t = 0; t < threads; ++t) {
+    all.insert(all.end(), firsts[t].begin(), firsts[t].end());
+  }
+  std::sort(all.begin(), all.end());
+  for (size_t i = 0; i < all.size(); ++i) {
+    ASSERT_EQ(all[i], 1000 + 3 * static_cast<int64_t>(i));
+  }
+  EXPECT_EQ(IdAllocator::highWater(IdAllocator::TransactionIds),
+            1000 + 3 * threads * rounds);
+}
+
+TEST_F(IdAllocatorFixture, HighWaterMark_SurvivesSaveAndReload) {
+  std::string a = generateTransactionId(), b = generateTransactionId();
+  EXPECT_EQ(a, "T1000");
+  EXPECT_EQ(b, "T1001");
+  EXPECT_EQ(generateCategoryId(), "c100");
+  ASSERT_TRUE(add(a));
+  ASSERT_TRUE(add(b));
+  ASSERT_TRUE(Transaction::deleteTransaction(b));  // 已删除的编号不再使用
+
+  DataPersistence::setTestFilePath(file);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  Transaction::getRepository().clear();
+  IdAllocator::reset();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  EXPECT_EQ(Transaction::list().size(), 1u);
+  EXPECT_EQ(generateTransactionId(), "T1002");
+  EXPECT_EQ(generateCategoryId(), "c101");
+}
+
+TEST_F(IdAllocatorFixture, ExternalIds_RaiseTheMark) {
+  ASSERT_TRUE(add("T5000"));
+  ASSERT_TRUE(add("Tx12"));  // 非数字编号被忽略，也不会抛异常
+  ASSERT_TRUE(add("T99999999999999"));
+  EXPECT_EQ(generateTransactionId(), "T100000000000000");
+
+  IdAllocator::reset();
+  Category::emplaceCategory("c250", "其他");
+  EXPECT_EQ(generateCategoryId(), "c251");
+  Category::deleteCategory("c250");
+}
+
+TEST_F(IdAllocatorFixture, LegacyFileWithoutHeader_RecoversMark) {
+  {
+    std::ofstream out(file);
+    out << "[CATEGORIES]\nia1|餐饮\n[TRANSACTIONS]\n"
+        << "T1200|5|2024-01-02|ia1|1|\nT1100|6|2024-01-03|ia1|1|\n";
+  }
+  DataPersistence::setTestFilePath(file);
+  ASSERT_TRUE(DataPersistence::loadAll());
+  EXPECT_EQ(Transaction::list().size(), 2u);
+  EXPECT_EQ(generateTransactionId(), "T1201");
+}
+
+TEST_F(IdAllocatorFixture, ImportFile_AssignsOneBlock) {
+  const std::string input = "test_id_allocator_import.txt";
+  {
+    std::ofstream out(input);
+    out << "|10|2024-02-01|ia1|1|早饭\n"
+        << "T7|20|2024-02-02|ia1|1|\n"
+        << "|30|2024-02-03|ia1|1|晚饭\n";
+  }
+  ImportResult result = ImportService::importFile(input);
+  std::remove(input.c_str());
+  ASSERT_EQ(result.accepted, 3u);
+  const std::vector<Transaction>& txs = Transaction::list();
+  EXPECT_EQ(txs[0].getId(), "T1000");
+  EXPECT_EQ(txs[1].getId(), "T7");
+  EXPECT_EQ(txs[2].getId(), "T1001");
+  EXPECT_EQ(generateTransactionId(), "T1002");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,116 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+struct LazyRemarksFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("lr1", "餐饮"));
+    DataPersistence::setTestFilePath(db);
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("lr1");
+    DataPersistence::setTestFilePath("");
+    std::remove(db.c_str());
+  }
+  static bool add(const std::string& id, std::string remarks) {
+    return Transaction::emplaceTransaction(id, 1, "2024-05-01", "lr1",
+                                           TransactionType::Expense,
+                                           std::move(remarks));
+  }
+  static void reload() {
+    ASSERT_TRUE(DataPersistence::saveAll());
+    Transaction::getRepository().clear();
+    ASSERT_TRUE(DataPersistence::loadAll());
+  }
+  const std::string db = "test_lazy_remarks.db";
+};
+
+TEST_F(LazyRemarksFixture, LoadedRemarks_PointIntoArena) {
+  const std::string longText(RemarkArena::BLOCK_SIZE + 10, 'x');
+  ASSERT_TRUE(add("L1", "a|b\\c\nd\\"));
+  ASSERT_TRUE(add("L2", ""));
+  ASSERT_TRUE(add("L3", longText));  // 超过一块的备注单独占一块
+  ASSERT_TRUE(add("L4", "午饭"));
+  size_t before = RemarkArena::capacity();
+  reload();
+
+  const std::vector<Transaction>& txs = Transaction::list();
+  ASSERT_EQ(txs.size(), 4u);
+  EXPECT_EQ(txs[0].getRemarks(), "a|b\\c\nd\\");
+  EXPECT_TRUE(txs[0].getRemarkStorage().isPooled());
+  EXPECT_TRUE(txs[0].getRemarkStorage().ownedText().empty());
+  EXPECT_TRUE(txs[1].getRemarks().empty());
+  EXPECT_FALSE(txs[1].getRemarkStorage().isPooled());
+  EXPECT_EQ(txs[2].getRemarks(), longText);
+  EXPECT_EQ(txs[3].getRemarks(), "午饭");
+  EXPECT_GE(RemarkArena::capacity() - before, longText.size());
+
+  // 复制只复制视图；修改后改为持有自己的字符串
+  Transaction copy = txs[3];
+  EXPECT_EQ(copy.getRemarks().data(), txs[3].getRemarks().data());
+  copy.setRemarks("晚饭");
+  ASSERT_TRUE(copy.updateTransaction());
+  EXPECT_FALSE(txs[3].getRemarkStorage().isPooled());
+  EXPECT_EQ(txs[3].getRemarks(), "晚饭");
+  EXPECT_NE(txs[3].getTransactionDetail().find("备注=晚饭"),
+            std::string::npos);
+}
+
+TEST_F(LazyRemarksFixture, RejectedRows_LeaveNothingInArena) {
+  const std::string longText(RemarkArena::BLOCK_SIZE + 10, 'y');
+  {
+    std::ofstream file(db);
+    file << "[TRANSACTIONS]\n"
+         << "B1|-5|2024-05-01|lr1|1|" << longText << '\n'
+         << "|5|2024-05-01|lr1|1|" << longText << '\n'
+         << "G1|3|2024-05-01|lr1|1|好\n";
+  }
+  size_t before = RemarkArena::capacity();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  ASSERT_EQ(Transaction::list().size(), 1u);
+  EXPECT_EQ(Transaction::list()[0].getRemarks(), "好");
+  EXPECT_LT(RemarkArena::capacity() - before, longText.size());
+}
+
+TEST_F(LazyRemarksFixture, SearchEditAndSave_WorkOnLoadedRemarks) {
+  for (int i = 0; i < 6; ++i) {
+    ASSERT_TRUE(add("S" + std::to_string(i), i % 2 ? "外卖|到付" : "堂食"));
+  }
+  reload();
+
+  SearchQuery query;
+  query.keyword = "外卖|";
+  EXPECT_EQ(QueryCache::search(query)->size(), 3u);
+  EXPECT_EQ(BulkEditService::appendRemarks(query, "\\n"), 3u);
+  reload();
+  EXPECT_EQ(Transaction::list()[1].getRemarks(), "外卖|到付\\n");
+  EXPECT_EQ(Transaction::list()[2].getRemarks(), "堂食");
+
+  std::ostringstream out;
+  ReportWriter::writeTransactions(out, Transaction::list(),
+                                  OutputFormat::JsonLines);
+  EXPECT_NE(out.str().find("\"remarks\":\"外卖|到付\\\\n\""),
+            std::string::npos);
+}
+
+TEST(LazyRemarks, NextField_MatchesSplit) {
+  const char* lines[] = {"", "a", "a|", "|b", "a\\|b|c\\\\|d", "x|y\\",
+                         "1|2|3|4|5|", "1|2|3|4|5|r\\|s|extra"};
+  for (size_t i = 0; i < sizeof(lines) / sizeof(lines[0]); ++i) {
+    const std::string line = lines[i];
+    std::vector<std::string> expected = DataPersistence::split(line, '|');
+    std::vector<std::string> fields;
+    std::string_view rest = line;
+    while (rest.data() != nullptr) {
+      fields.emplace_back(DataPersistence::nextField(rest, '|'));
+    }
+    EXPECT_EQ(fields, expected) << line;
+  }
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
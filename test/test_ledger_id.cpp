@@ -0,0 +1,65 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+TEST(LedgerId, ComparesAndHashesByValue) {
+  LedgerId a("T1000"), b(std::string("T1000")), c("T1001");
+  EXPECT_EQ(a, b);
+  EXPECT_NE(a, c);
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_NE(a.hash(), c.hash());
+  EXPECT_EQ(a.view(), "T1000");
+  EXPECT_EQ(a.size(), 5u);
+  EXPECT_EQ(c.str(), "T1001");
+  EXPECT_TRUE(LedgerId().empty());
+  EXPECT_EQ(LedgerId(""), LedgerId());
+
+  std::ostringstream out;
+  out << a;
+  EXPECT_EQ(out.str(), "T1000");
+
+  std::unordered_set<LedgerId> ids = {a, c};
+  EXPECT_EQ(ids.count(LedgerId("T1000")), 1u);
+  EXPECT_EQ(ids.count(LedgerId("T100")), 0u);
+}
+
+TEST(LedgerId, FullWidthAndOverlongTexts) {
+  std::string full(LedgerId::MAX_LENGTH, 'x');
+  LedgerId id(full);
+  EXPECT_TRUE(id.valid());
+  EXPECT_EQ(id.size(), LedgerId::MAX_LENGTH);
+  EXPECT_EQ(id.view(), full);
+
+  LedgerId tooLong(full + "y");
+  EXPECT_FALSE(tooLong.valid());
+  EXPECT_FALSE(tooLong.empty());
+  EXPECT_TRUE(tooLong.view().empty());
+  EXPECT_NE(tooLong, LedgerId());
+  EXPECT_FALSE(LedgerId(std::string("a\0b", 3)).valid());
+
+  // 内联存放，不随文本长度增长
+  EXPECT_EQ(sizeof(LedgerId), 2 * sizeof(uint64_t));
+}
+
+TEST(LedgerId, OverlongIdsAreRejected) {
+  Transaction::getRepository().clear();
+  std::string longId(LedgerId::MAX_LENGTH + 1, '9');
+  EXPECT_FALSE(Category::emplaceCategory(longId, "超长"));
+  ASSERT_TRUE(Category::emplaceCategory("li1", "餐饮"));
+  EXPECT_FALSE(Transaction::emplaceTransaction(
+      longId, 1, "2024-01-01", "li1", TransactionType::Expense));
+
+  std::vector<Transaction> batch(1);
+  batch[0].setId(longId);
+  batch[0].setAmount(1);
+  batch[0].setCategoryId("li1");
+  std::vector<ImportError> errors;
+  EXPECT_EQ(Transaction::addTransactions(batch, errors), 0u);
+  ASSERT_EQ(errors.size(), 1u);
+  EXPECT_TRUE(Transaction::list().empty());
+  Category::deleteCategory("li1");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,72 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+struct LedgerLockFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("lc1", "餐饮"));
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("lc1");
+  }
+  static Transaction makeTx(int n) {
+    Transaction t; t.setId("L" + std::to_string(n)); t.setAmount(1.0);
+    t.setTime("2024-06-01"); t.setCategoryId("lc1");
+    return t;
+  }
+};
+
+TEST_F(LedgerLockFixture, NestedGuards_DoNotDeadlock) {
+  LedgerLock::WriteGuard outer;
+  EXPECT_TRUE(Transaction::addTransaction(makeTx(1)));
+  EXPECT_TRUE(Category::categoryExists("lc1"));
+  {
+    LedgerLock::ReadGuard inner;
+    EXPECT_EQ(Transaction::list().size(), 1u);
+  }
+  EXPECT_TRUE(Transaction::deleteTransaction("L1"));
+}
+
+TEST_F(LedgerLockFixture, ReadersNeverSeeTornState_WhileWriterRuns) {
+  const int kWrites = 2000;
+  std::atomic<bool> done(false);
+  std::atomic<int> violations(0);
+
+  // 写线程每次先加一条再删一条之前的记录，读线程校验统计结果自洽
+  std::thread writer([&]() {
+    for (int i = 0; i < kWrites; ++i) {
+      Transaction::addTransaction(makeTx(i));
+      if (i % 3 == 0) Transaction::deleteTransaction("L" + std::to_string(i / 2));
+    }
+    done = true;
+  });
+
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&]() {
+      while (!done) {
+        StatisticService stat(Transaction::list());
+        StatisticReport report = stat.reportByCategory();
+        int count = 0;
+        for (auto& row : report.rows) count += row.expenseCount;
+        if (report.totalExpense != static_cast<double>(count)) ++violations;
+
+        SearchService search(Transaction::list());
+        auto found = search.searchTransaction({}, {}, "lc1", "");
+        for (auto& tx : found) {
+          if (tx.getAmount() != 1.0) ++violations;
+        }
+      }
+    });
+  }
+  writer.join();
+  for (auto& t : readers) t.join();
+  EXPECT_EQ(violations, 0);
+  EXPECT_GT(Transaction::list().size(), 0u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
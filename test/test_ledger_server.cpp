@@ -0,0 +1,99 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+
+using namespace std::filesystem;
+
+struct LedgerServerFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("sc1", "餐饮"));
+    Transaction t; t.setId("S1"); t.setAmount(25); t.setTime("2024-04-01");
+    t.setCategoryId("sc1"); t.setRemarks("早餐");
+    Transaction::getRepository().push_back(t);
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("sc1");
+  }
+  static std::unordered_map<std::string, JsonValue> parse(const std::string& s) {
+    std::unordered_map<std::string, JsonValue> obj;
+    EXPECT_TRUE(JsonReader::parseObject(s, obj)) << s;
+    return obj;
+  }
+};
+
+TEST_F(LedgerServerFixture, JsonReader_ParsesProtocolSubset) {
+  auto obj = parse(" {\"args\":[\"a\\\"b\",\"\\u4e2d\\n\"], \"n\":12, \"ok\":true} ");
+  ASSERT_EQ(obj["args"].items.size(), 2u);
+  EXPECT_EQ(obj["args"].items[0], "a\"b");
+  EXPECT_EQ(obj["args"].items[1], "中\n");
+  EXPECT_EQ(obj["n"].text, "12");
+  std::unordered_map<std::string, JsonValue> bad;
+  EXPECT_FALSE(JsonReader::parseObject("{\"args\":[1]}", bad));
+  EXPECT_FALSE(JsonReader::parseObject("{\"a\":\"x\"} trailing", bad));
+}
+
+TEST_F(LedgerServerFixture, HandleRequest_ReadAndMutation) {
+  auto r = parse(LedgerServer::handleRequest(
+      "{\"args\":[\"search\",\"--keyword\",\"早餐\"]}"));
+  EXPECT_EQ(r["status"].text, "0");
+  EXPECT_NE(r["output"].text.find("S1,25.00"), std::string::npos);
+
+  r = parse(LedgerServer::handleRequest(
+      "{\"args\":[\"add\",\"--id\",\"S2\",\"--amount\",\"8\",\"--date\","
+      "\"2024-04-02\",\"--category\",\"sc1\"]}"));
+  EXPECT_EQ(r["status"].text, "0");
+  EXPECT_EQ(Transaction::list().size(), 2u);
+
+  r = parse(LedgerServer::handleRequest("{\"args\":[\"delete\",\"S1\"]}"));
+  EXPECT_EQ(r["status"].text, "0");
+  ASSERT_EQ(Transaction::list().size(), 1u);
+  EXPECT_EQ(Transaction::list()[0].getId(), "S2");
+}
+
+TEST_F(LedgerServerFixture, HandleRequest_RejectsMalformedAndNested) {
+  auto r = parse(LedgerServer::handleRequest("not json"));
+  EXPECT_EQ(r["status"].text, "1");
+  r = parse(LedgerServer::handleRequest("{\"args\":[\"serve\"]}"));
+  EXPECT_EQ(r["status"].text, "1");
+}
+
+TEST_F(LedgerServerFixture, SocketRoundTrip_ConcurrentClients) {
+  std::string sock = "test_ledger_server.sock";
+  LedgerServer server(sock);
+  std::ostringstream log;
+  std::thread serving([&]() { server.run(log); });
+  for (int i = 0; i < 50 && !exists(sock); ++i) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  std::vector<std::thread> clients;
+  std::atomic<int> ok(0);
+  for (int i = 0; i < 8; ++i) {
+    clients.emplace_back([&]() {
+      std::string reply;
+      if (LedgerClient::request(sock, {"stats", "--by", "category"}, reply) &&
+          reply.find("餐饮,0.00,25.00") != std::string::npos) {
+        ++ok;
+      }
+    });
+  }
+  for (auto& c : clients) c.join();
+  EXPECT_EQ(ok, 8);
+
+  std::ostringstream out, err;
+  EXPECT_EQ(LedgerClient::run({"client", "--socket", sock, "delete", "NOPE"},
+                              out, err), 1);
+  EXPECT_NE(err.str().find("NOPE"), std::string::npos);
+
+  server.stop();
+  serving.join();
+  EXPECT_FALSE(exists(sock));
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
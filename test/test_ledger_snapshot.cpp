@@ -0,0 +1,80 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+struct SnapshotFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("vc1", "餐饮"));
+    Transaction::addTransaction(makeTx("V1", 10));
+    Transaction::addTransaction(makeTx("V2", 20));
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("vc1");
+  }
+  static Transaction makeTx(const std::string& id, double amount) {
+    Transaction t; t.setId(id); t.setAmount(amount); t.setTime("2024-07-01");
+    t.setCategoryId("vc1");
+    return t;
+  }
+};
+
+TEST_F(SnapshotFixture, SameVersion_SharesData) {
+  LedgerSnapshot a = LedgerSnapshot::current();
+  LedgerSnapshot b = LedgerSnapshot::current();
+  EXPECT_EQ(a.version(), b.version());
+  EXPECT_EQ(&a.transactions(), &b.transactions());
+  EXPECT_EQ(a.transactions().size(), 2u);
+}
+
+TEST_F(SnapshotFixture, Mutations_DoNotAffectPinnedSnapshot) {
+  LedgerSnapshot before = LedgerSnapshot::current();
+  EXPECT_TRUE(Transaction::addTransaction(makeTx("V3", 30)));
+  EXPECT_TRUE(Transaction::deleteTransaction("V1"));
+  Category::deleteCategory("vc1");
+
+  LedgerSnapshot after = LedgerSnapshot::current();
+  EXPECT_GT(after.version(), before.version());
+  EXPECT_EQ(after.transactions().size(), 2u);
+
+  // 旧快照保持不变，分类名也按快照版本解析
+  StatisticReport report = StatisticService(before).reportByCategory();
+  ASSERT_EQ(report.rows.size(), 1u);
+  EXPECT_EQ(report.rows[0].key, "餐饮");
+  EXPECT_DOUBLE_EQ(report.totalExpense, 30.0);
+  auto found = SearchService(before).searchTransaction({}, {}, "", "V1");
+  EXPECT_EQ(found.size(), 1u);
+  Category::addCategory(Category("vc1", "餐饮"));
+}
+
+TEST_F(SnapshotFixture, SnapshotReports_RunWhileWriterHoldsLock) {
+  LedgerSnapshot snap = LedgerSnapshot::current();
+  std::atomic<bool> finished(false);
+  {
+    LedgerLock::WriteGuard writer;
+    Transaction::addTransaction(makeTx("V9", 99));
+    // 写锁未释放时，基于快照的统计仍能在另一个线程完成
+    std::thread reader([&]() {
+      StatisticService stat(snap);
+      double ti, te, bal;
+      stat.calculateHomePage(ti, te, bal);
+      finished = te == 30.0;
+    });
+    reader.join();
+  }
+  EXPECT_TRUE(finished);
+  EXPECT_EQ(LedgerSnapshot::current().transactions().size(), 3u);
+}
+
+TEST_F(SnapshotFixture, DirectRepositoryAccess_BumpsVersion) {
+  uint64_t v = LedgerSnapshot::current().version();
+  Transaction::getRepository().push_back(makeTx("V4", 1));
+  LedgerSnapshot s = LedgerSnapshot::current();
+  EXPECT_NE(s.version(), v);
+  EXPECT_EQ(s.transactions().size(), 3u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,106 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+#ifdef BOOKKEEPING_METRICS
+struct MetricsFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("mc1", "餐饮"));
+    for (int i = 0; i < 10; ++i) {
+      Transaction t; t.setId("M" + std::to_string(i)); t.setAmount(10.0 * i);
+      t.setTime("2024-03-0" + std::to_string(i % 9 + 1)); t.setCategoryId("mc1");
+      t.setRemarks(i % 2 ? "午饭" : "晚饭");
+      Transaction::getRepository().push_back(t);
+    }
+    Metrics::reset();
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("mc1");
+  }
+  static std::string dump() {
+    std::ostringstream out;
+    Metrics::write(out);
+    return out.str();
+  }
+  static bool has(const std::string& text, const std::string& line) {
+    return text.find(line + "\n") != std::string::npos;
+  }
+};
+
+TEST_F(MetricsFixture, Search_RecordsRowsAndLatency) {
+  SearchService search(Transaction::list());
+  EXPECT_EQ(search.searchTransaction({}, {}, "", "午饭").size(), 5u);
+  EXPECT_EQ(search.searchTransaction({}, {20, 40}, "", "").size(), 3u);
+  EXPECT_EQ(Metrics::calls(Metrics::Search), 2u);
+
+  std::string text = dump();
+  EXPECT_TRUE(has(text, "bookkeeping_rows_scanned_total{op=\"search\"} 20"));
+  EXPECT_TRUE(has(text, "bookkeeping_rows_matched_total{op=\"search\"} 8"));
+  EXPECT_TRUE(has(text, "bookkeeping_operation_duration_seconds_bucket"
+                        "{op=\"search\",le=\"+Inf\"} 2"));
+  EXPECT_TRUE(has(text, "bookkeeping_operation_duration_seconds_count"
+                        "{op=\"search\"} 2"));
+  EXPECT_TRUE(has(text, "# TYPE bookkeeping_operation_duration_seconds "
+                        "histogram"));
+  // 结果向量的分配被计入
+  EXPECT_EQ(text.find("bookkeeping_allocations_total{op=\"search\"} 0\n"),
+            std::string::npos);
+}
+
+TEST_F(MetricsFixture, ReportsSaveAndMutations_AreCounted) {
+  StatisticService stat(Transaction::list());
+  StatisticReport report = stat.reportByTime(TimeGroup::Monthly,
+                                             {"2024-03-02", "2024-03-05"});
+  EXPECT_EQ(report.rows.size(), 1u);
+  EXPECT_TRUE(Transaction::deleteTransaction("M0"));
+  EXPECT_FALSE(Transaction::deleteTransaction("nope"));
+
+  const std::string file = "test_metrics.db";
+  DataPersistence::setTestFilePath(file);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  std::ifstream in(file, std::ios::binary | std::ios::ate);
+  std::string bytes = std::to_string(static_cast<long long>(in.tellg()));
+  in.close();
+  DataPersistence::setTestFilePath("");
+  std::remove(file.c_str());
+
+  std::string text = dump();
+  EXPECT_TRUE(has(text,
+      "bookkeeping_rows_scanned_total{op=\"report_by_time\"} 10"));
+  EXPECT_TRUE(has(text,
+      "bookkeeping_rows_matched_total{op=\"report_by_time\"} 4"));
+  EXPECT_TRUE(has(text, "bookkeeping_operation_duration_seconds_count"
+                        "{op=\"delete_transaction\"} 2"));
+  EXPECT_TRUE(has(text,
+      "bookkeeping_rows_matched_total{op=\"delete_transaction\"} 1"));
+  EXPECT_TRUE(has(text,
+      "bookkeeping_bytes_written_total{op=\"save_all\"} " + bytes));
+}
+
+TEST_F(MetricsFixture, CommandLine_MetricsSubcommandAndFlag) {
+  std::ostringstream out, err;
+  EXPECT_EQ(CommandLine::run({"search", "--keyword", "晚饭", "--metrics"},
+                             out, err), 0);
+  EXPECT_TRUE(has(err.str(),
+      "bookkeeping_rows_matched_total{op=\"search\"} 5"));
+  EXPECT_TRUE(CommandLine::isReadOnly("metrics"));
+
+  std::ostringstream out2, err2;
+  EXPECT_EQ(CommandLine::run({"metrics"}, out2, err2), 0);
+  EXPECT_TRUE(has(out2.str(),
+      "bookkeeping_operation_duration_seconds_count{op=\"search\"} 1"));
+  EXPECT_TRUE(err2.str().empty());
+}
+#else
+TEST(Metrics, Disabled_WritesNotice) {
+  std::ostringstream out;
+  Metrics::write(out);
+  EXPECT_EQ(out.str()[0], '#');
+}
+#endif
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,130 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+struct PartitionFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("pt1", "餐饮"));
+    DataPersistence::setTestFilePath(db);
+    const char* dates[] = {"2022-03-01", "2022-11-20", "2023-06-15",
+                           "2024-01-02", "2024-01-30", "2024-02-01"};
+    for (size_t i = 0; i < 6; ++i) {
+      ASSERT_TRUE(add("P" + std::to_string(i), dates[i]));
+    }
+  }
+  void TearDown() override {
+    // 切回单文件布局，保存时顺带删除分区文件
+    DataPersistence::setLayout(StorageLayout::Single);
+    DataPersistence::saveAll();
+    Transaction::getRepository().clear();
+    Category::deleteCategory("pt1");
+    DataPersistence::setTestFilePath("");
+    std::remove(db.c_str());
+  }
+  static bool add(const std::string& id, const std::string& date) {
+    return Transaction::emplaceTransaction(id, 1, date, "pt1",
+                                           TransactionType::Expense);
+  }
+  static bool exists(const std::string& path) {
+    return std::ifstream(path).good();
+  }
+  // 用一行标记覆盖分区文件，据此判断之后的保存是否重写了它
+  void stamp(const std::string& key) {
+    std::ofstream out(db + "." + key, std::ios::trunc);
+    out << "[TRANSACTIONS]\nSTAMP|1|" << key << "-05-05|pt1|1|\n";
+  }
+  const std::string db = "test_partitioned_storage.db";
+};
+
+TEST_F(PartitionFixture, Save_RewritesOnlyDirtyPartitions) {
+  DataPersistence::setLayout(StorageLayout::Yearly);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  EXPECT_EQ(DataPersistence::partitionCount(), 3u);
+  EXPECT_TRUE(exists(db + ".2022"));
+  EXPECT_TRUE(exists(db + ".2023"));
+  EXPECT_TRUE(exists(db + ".2024"));
+
+  stamp("2022");
+  stamp("2023");
+  Transaction changed = Transaction::list()[4];
+  changed.setRemarks("改过");
+  ASSERT_TRUE(changed.updateTransaction());
+  ASSERT_TRUE(Transaction::deleteTransaction("P2"));  // 删空 2023 分区
+
+  Transaction::getRepository().clear();
+  IdAllocator::reset();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  EXPECT_EQ(DataPersistence::layout(), StorageLayout::Yearly);
+  EXPECT_FALSE(exists(db + ".2023"));
+  EXPECT_EQ(DataPersistence::partitionCount(), 2u);
+  // 2022 未改动，保存时没有重写，读回的是标记行
+  ASSERT_EQ(Transaction::list().size(), 4u);
+  EXPECT_EQ(Transaction::list()[0].getId(), "STAMP");
+  EXPECT_EQ(Transaction::list()[2].getRemarks(), "改过");
+}
+
+TEST_F(PartitionFixture, LoadRange_LoadsOnlyOverlappingPartitions) {
+  DataPersistence::setLayout(StorageLayout::Monthly);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  EXPECT_EQ(DataPersistence::partitionCount(), 5u);
+
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadManifest());
+  EXPECT_TRUE(Transaction::list().empty());
+  EXPECT_EQ(DataPersistence::loadedPartitionCount(), 0u);
+  ASSERT_TRUE(DataPersistence::loadRange("2024-01-15", "2024-01-31"));
+  EXPECT_EQ(DataPersistence::loadedPartitionCount(), 1u);
+  EXPECT_EQ(Transaction::list().size(), 2u);
+
+  // 写入冷分区：保存时先载入该分区再重写，原有的行不丢
+  stamp("2023-06");
+  ASSERT_TRUE(add("P9", "2023-06-30"));
+  ASSERT_TRUE(DataPersistence::saveAll());
+  EXPECT_EQ(DataPersistence::loadedPartitionCount(), 2u);
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadManifest());
+  ASSERT_TRUE(DataPersistence::loadRange("2023-01-01", "2023-12-31"));
+  // 冷分区的行在保存时追加在新行之后
+  ASSERT_EQ(Transaction::list().size(), 2u);
+  EXPECT_EQ(Transaction::list()[0].getId(), "P9");
+  EXPECT_EQ(Transaction::list()[1].getId(), "STAMP");
+
+  // 标记行顶替了 P2
+  ASSERT_TRUE(DataPersistence::loadRange("", ""));
+  EXPECT_EQ(Transaction::list().size(), 7u);
+}
+
+TEST_F(PartitionFixture, SwitchingLayouts_RemovesOldFiles) {
+  DataPersistence::setLayout(StorageLayout::Monthly);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  EXPECT_TRUE(exists(db + ".2024-01"));
+  DataPersistence::setLayout(StorageLayout::Yearly);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  EXPECT_FALSE(exists(db + ".2024-01"));
+  EXPECT_TRUE(exists(db + ".2024"));
+
+  // 只读命令只载入清单和检索范围内的分区
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadManifest());
+  std::ostringstream out, err;
+  ASSERT_EQ(CommandLine::run({"search", "--from", "2024-01-01"}, out, err),
+            0);
+  EXPECT_EQ(DataPersistence::loadedPartitionCount(), 1u);
+  EXPECT_NE(out.str().find("P5"), std::string::npos);
+  EXPECT_EQ(out.str().find("P0"), std::string::npos);
+
+  ASSERT_TRUE(DataPersistence::loadRange("", ""));
+  DataPersistence::setLayout(StorageLayout::Single);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  EXPECT_FALSE(exists(db + ".2024"));
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  EXPECT_EQ(DataPersistence::layout(), StorageLayout::Single);
+  EXPECT_EQ(Transaction::list().size(), 6u);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,121 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+struct QueryCacheFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("qc1", "餐饮"));
+    Category::addCategory(Category("qc2", "工资"));
+    add("Q1", 30, "2024-05-01", "qc1", TransactionType::Expense, "午饭");
+    add("Q2", 12, "2024-05-02", "qc1", TransactionType::Expense, "早饭");
+    add("Q3", 5000, "2024-05-10", "qc2", TransactionType::Income, "五月");
+    QueryCache::clear();
+    QueryCache::setBudget(QueryCache::DEFAULT_BUDGET);
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("qc1");
+    Category::deleteCategory("qc2");
+    QueryCache::setBudget(QueryCache::DEFAULT_BUDGET);
+  }
+  static void add(const std::string& id, double amount, const std::string& date,
+                  const std::string& cat, TransactionType type,
+                  const std::string& remarks) {
+    Transaction t; t.setId(id); t.setAmount(amount); t.setTime(date);
+    t.setCategoryId(cat); t.setType(type); t.setRemarks(remarks);
+    Transaction::getRepository().push_back(t);
+  }
+  static SearchQuery byCategory(const std::string& cat) {
+    SearchQuery q;
+    q.categoryId = cat;
+    return q;
+  }
+};
+
+TEST_F(QueryCacheFixture, RepeatedSearch_SharesCachedResult) {
+  QueryCache::TransactionList first = QueryCache::search(byCategory("qc1"));
+  QueryCache::TransactionList second = QueryCache::search(byCategory("qc1"));
+  ASSERT_EQ(first->size(), 2u);
+  EXPECT_EQ(first.get(), second.get());
+  EXPECT_EQ(QueryCache::misses(), 1u);
+  EXPECT_EQ(QueryCache::hits(), 1u);
+
+  // 等价条件规范化后命中同一条目：空日期范围与两端为空相同，未排序时忽略方向
+  SearchQuery same = byCategory("qc1");
+  same.dateRange = {"", ""};
+  same.direction = SortDirection::Desc;
+  EXPECT_EQ(QueryCache::search(same).get(), first.get());
+
+  SearchQuery sorted = byCategory("qc1");
+  sorted.sorted = true;
+  sorted.sortField = SortField::Amount;
+  QueryCache::TransactionList bySize = QueryCache::search(sorted);
+  ASSERT_EQ(bySize->size(), 2u);
+  EXPECT_EQ((*bySize)[0].getId(), "Q2");
+  EXPECT_EQ(QueryCache::size(), 2u);
+  EXPECT_GT(QueryCache::memoryUsage(), 0u);
+}
+
+TEST_F(QueryCacheFixture, Mutation_InvalidatesResults) {
+  QueryCache::TransactionList before = QueryCache::search(byCategory("qc1"));
+  QueryCache::Report report =
+      QueryCache::statistic(StatisticDimension::Category, {});
+  ASSERT_EQ(report->rows.size(), 2u);
+
+  Transaction t; t.setId("Q4"); t.setAmount(8); t.setTime("2024-05-03");
+  t.setCategoryId("qc1");
+  ASSERT_TRUE(Transaction::addTransaction(t));
+
+  QueryCache::TransactionList after = QueryCache::search(byCategory("qc1"));
+  EXPECT_EQ(before->size(), 2u);  // 旧结果仍可安全使用
+  EXPECT_EQ(after->size(), 3u);
+  EXPECT_EQ(QueryCache::hits(), 0u);
+
+  // 分类改动同样使统计结果失效
+  Category::deleteCategory("qc2");
+  QueryCache::Report renamed =
+      QueryCache::statistic(StatisticDimension::Category, {});
+  EXPECT_NE(renamed.get(), report.get());
+  EXPECT_EQ(renamed->rows[1].key, "qc2");
+  Category::addCategory(Category("qc2", "工资"));
+}
+
+TEST_F(QueryCacheFixture, Budget_EvictsLeastRecentlyUsed) {
+  QueryCache::search(byCategory("qc1"));
+  size_t one = QueryCache::memoryUsage();
+  QueryCache::setBudget(one * 2 + one / 4);
+  QueryCache::search(byCategory("qc2"));
+  QueryCache::search(byCategory("qc1"));  // qc1 变为最近使用
+  SearchQuery keyword;
+  keyword.keyword = "饭";
+  QueryCache::search(keyword);
+  EXPECT_LE(QueryCache::memoryUsage(), QueryCache::budget());
+  EXPECT_EQ(QueryCache::size(), 2u);
+
+  uint64_t hits = QueryCache::hits();
+  QueryCache::search(byCategory("qc1"));
+  EXPECT_EQ(QueryCache::hits(), hits + 1);
+  QueryCache::search(byCategory("qc2"));  // 已被淘汰
+  EXPECT_EQ(QueryCache::hits(), hits + 1);
+
+  QueryCache::setBudget(0);
+  EXPECT_EQ(QueryCache::size(), 0u);
+  QueryCache::search(byCategory("qc1"));
+  EXPECT_EQ(QueryCache::size(), 0u);
+}
+
+TEST_F(QueryCacheFixture, Counters_AreExported) {
+  QueryCache::search(byCategory("qc1"));
+  QueryCache::search(byCategory("qc1"));
+  std::ostringstream out, err;
+  EXPECT_EQ(CommandLine::run({"metrics"}, out, err), 0);
+  EXPECT_NE(out.str().find("bookkeeping_query_cache_hits_total 1\n"),
+            std::string::npos);
+  EXPECT_NE(out.str().find("bookkeeping_query_cache_misses_total 1\n"),
+            std::string::npos);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,194 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+
+struct RankingFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    const char* names[] = {"餐饮", "交通", "购物", "工资"};
+    for (size_t i = 0; i < 4; ++i) {
+      Category::addCategory(Category("rk" + std::to_string(i), names[i]));
+    }
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    for (size_t i = 0; i < 4; ++i) {
+      Category::deleteCategory("rk" + std::to_string(i));
+    }
+  }
+  static bool add(const std::string& id, double amount, const std::string& date,
+                  const std::string& category, const std::string& remarks,
+                  TransactionType type = TransactionType::Expense) {
+    return Transaction::emplaceTransaction(id, amount, date, category, type,
+                                           remarks);
+  }
+  // 伪随机账本，含大量相同金额，检验并列时的顺序
+  static void addRandomRows(size_t rows) {
+    const char* words[] = {"外卖", "地铁", "超市", "咖啡", "午饭", "打车"};
+    uint32_t state = 5;
+    for (size_t i = 0; i < rows; ++i) {
+      state = state * 1103515245u + 12345u;
+      double amount = static_cast<double>((state >> 16) % 200);
+      std::string remarks = std::string(words[(state >> 8) % 6]) + " " +
+                            words[(state >> 4) % 6] + "，" +
+                            words[(state >> 12) % 6];
+      ASSERT_TRUE(add("R" + std::to_string(i), amount,
+                      "2024-0" + std::to_string(i % 9 + 1) + "-15",
+                      "rk" + std::to_string(state % 4), remarks,
+                      state % 7 ? TransactionType::Expense
+                                : TransactionType::Income));
+    }
+  }
+};
+
+TEST(TopN, KeepsLargestInOrder) {
+  auto greater = [](int a, int b) { return a > b; };
+  TopN<int, decltype(greater)> top(3, greater);
+  const int values[] = {5, 1, 9, 7, 3, 9, 2, 8};
+  for (size_t i = 0; i < 8; ++i) top.push(values[i]);
+  EXPECT_EQ(top.take(), (std::vector<int>{9, 9, 8}));
+  EXPECT_TRUE(top.take().empty());
+
+  TopN<int, decltype(greater)> none(0, greater);
+  none.push(1);
+  EXPECT_TRUE(none.take().empty());
+
+  // 名次远多于候选元素时只按候选数预留空间
+  TopN<int, decltype(greater)> huge(std::numeric_limits<size_t>::max(),
+                                    greater, 2);
+  huge.push(1);
+  huge.push(4);
+  EXPECT_EQ(huge.take(), (std::vector<int>{4, 1}));
+}
+
+TEST_F(RankingFixture, TopTransactions_MatchFullSort) {
+  addRandomRows(2000);
+  ASSERT_TRUE(Transaction::deleteTransaction("R3"));
+  std::vector<std::string> range = {"2024-02-01", "2024-06-30"};
+
+  // 参照：按金额稳定降序排序后取前 n 个
+  std::vector<Transaction> expected;
+  const std::vector<Transaction>& txs = Transaction::list();
+  for (size_t i = 0; i < txs.size(); ++i) {
+    if (Transaction::isDeleted(i)) continue;
+    if (txs[i].getType() != TransactionType::Expense) continue;
+    if (txs[i].getTime() < range[0] || txs[i].getTime() > range[1]) continue;
+    expected.push_back(txs[i]);
+  }
+  std::stable_sort(expected.begin(), expected.end(),
+                   [](const Transaction& a, const Transaction& b) {
+                     return a.getAmount() > b.getAmount();
+                   });
+
+  StatisticService stat(Transaction::list());
+  const size_t limits[] = {1, 25, 5000};
+  for (size_t l = 0; l < 3; ++l) {
+    std::vector<Transaction> top =
+        stat.topTransactions(limits[l], TransactionType::Expense, range);
+    ASSERT_EQ(top.size(), std::min(limits[l], expected.size()));
+    for (size_t i = 0; i < top.size(); ++i) {
+      EXPECT_EQ(top[i].getId(), expected[i].getId()) << limits[l] << ' ' << i;
+    }
+  }
+}
+
+TEST_F(RankingFixture, TopCategoriesAndTerms_MatchTotals) {
+  ASSERT_TRUE(add("A", 30, "2024-01-01", "rk0", "外卖 午饭 外卖"));
+  ASSERT_TRUE(add("B", 80, "2024-01-02", "rk1", "打车，机场"));
+  ASSERT_TRUE(add("C", 20, "2024-01-03", "rk0", "午饭"));
+  ASSERT_TRUE(add("D", 45, "2024-01-04", "rk2", "超市 外卖"));
+  ASSERT_TRUE(add("E", 9000, "2024-01-05", "rk3", "工资 外卖",
+                  TransactionType::Income));
+  ASSERT_TRUE(add("F", 500, "2024-02-01", "rk2", "家电"));
+
+  StatisticService stat(Transaction::list());
+  StatisticReport categories =
+      stat.topCategories(2, {"2024-01-01", "2024-01-31"});
+  ASSERT_EQ(categories.rows.size(), 2u);
+  EXPECT_EQ(categories.rows[0].key, "交通");
+  EXPECT_EQ(categories.rows[1].key, "餐饮");
+  EXPECT_DOUBLE_EQ(categories.rows[1].expense, 50);
+  EXPECT_EQ(categories.rows[1].expenseCount, 2);
+  EXPECT_DOUBLE_EQ(categories.totalExpense, 175);
+  // 只有收入的分类不参与支出排行
+  EXPECT_EQ(stat.topCategories(10).rows.size(), 3u);
+
+  StatisticReport terms = stat.topTerms(4, {"", "2024-01-31"});
+  ASSERT_EQ(terms.rows.size(), 4u);
+  EXPECT_EQ(terms.rows[0].key, "打车");  // 与"机场"并列时按字符串顺序
+  EXPECT_EQ(terms.rows[1].key, "机场");
+  EXPECT_EQ(terms.rows[2].key, "外卖");
+  EXPECT_DOUBLE_EQ(terms.rows[2].expense, 75);  // A 中重复的词只计一次
+  EXPECT_EQ(terms.rows[2].expenseCount, 2);
+  EXPECT_EQ(terms.rows[3].key, "午饭");
+  EXPECT_DOUBLE_EQ(terms.rows[3].expense, 50);
+  EXPECT_DOUBLE_EQ(terms.totalIncome, 9000);
+}
+
+TEST_F(RankingFixture, TopTerms_MatchBruteForce) {
+  addRandomRows(1500);
+  std::map<std::string, double> totals;
+  const std::vector<Transaction>& txs = Transaction::list();
+  for (size_t i = 0; i < txs.size(); ++i) {
+    if (txs[i].getType() != TransactionType::Expense) continue;
+    std::set<std::string> seen;
+    std::string text(txs[i].getRemarks());
+    for (size_t pos = 0; pos < text.size();) {
+      size_t end = std::min(text.find(' ', pos), text.find("，", pos));
+      if (end == std::string::npos) end = text.size();
+      seen.insert(text.substr(pos, end - pos));
+      pos = end + (end < text.size() && text[end] == ' ' ? 1 : 3);
+    }
+    for (const std::string& word : seen) totals[word] += txs[i].getAmount();
+  }
+  StatisticReport terms = StatisticService(Transaction::list()).topTerms(6);
+  ASSERT_EQ(terms.rows.size(), totals.size());
+  for (size_t i = 0; i < terms.rows.size(); ++i) {
+    EXPECT_NEAR(terms.rows[i].expense, totals[terms.rows[i].key], 1e-6);
+    if (i > 0) {
+      EXPECT_GE(terms.rows[i - 1].expense, terms.rows[i].expense);
+    }
+  }
+}
+
+TEST_F(RankingFixture, CommandLine_Top) {
+  ASSERT_TRUE(add("T1", 12, "2024-03-01", "rk0", "面包"));
+  ASSERT_TRUE(add("T2", 99, "2024-03-02", "rk1", "火车"));
+  ASSERT_TRUE(add("T3", 50, "2024-03-03", "rk3", "奖金",
+                  TransactionType::Income));
+  std::ostringstream out, err;
+  ASSERT_EQ(CommandLine::run({"top", "categories", "--limit", "1"}, out, err),
+            0);
+  ASSERT_EQ(CommandLine::run({"top", "terms", "--format", "jsonl"}, out, err),
+            0);
+  EXPECT_EQ(out.str(),
+            "key,income,expense,balance,income_count,expense_count\n"
+            "交通,0.00,99.00,-99.00,0,1\n"
+            "{\"key\":\"火车\",\"income\":0.00,\"expense\":99.00,"
+            "\"balance\":-99.00,\"income_count\":0,\"expense_count\":1}\n"
+            "{\"key\":\"面包\",\"income\":0.00,\"expense\":12.00,"
+            "\"balance\":-12.00,\"income_count\":0,\"expense_count\":1}\n");
+  out.str("");
+  ASSERT_EQ(CommandLine::run({"top", "transactions", "--type", "income"}, out,
+                             err),
+            0);
+  EXPECT_NE(out.str().find("T3"), std::string::npos);
+  EXPECT_EQ(out.str().find("T2"), std::string::npos);
+  EXPECT_EQ(CommandLine::run({"top", "merchants"}, out, err), 1);
+  EXPECT_EQ(CommandLine::run({"top", "terms", "--limit", "0"}, out, err), 1);
+  EXPECT_EQ(CommandLine::run({"top", "transactions", "--limit",
+                              "400000000000"},
+                             out, err),
+            1);
+  EXPECT_EQ(CommandLine::run({"top", "terms", "--limit", "100001"}, out, err),
+            1);
+  EXPECT_EQ(StatisticService(Transaction::list())
+                .topTransactions(400000000000, TransactionType::Expense)
+                .size(),
+            2u);
+  EXPECT_EQ(CommandLine::run({"top"}, out, err), 1);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
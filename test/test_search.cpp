@@ -1,4 +1,4 @@
-#include "../code/code.cpp"
+#include "../code/bookkeeping.h"
 #include <gtest/gtest.h>
 
 struct SearchFixture : public ::testing::Test {
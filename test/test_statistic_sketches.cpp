@@ -0,0 +1,174 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cmath>
+
+namespace {
+
+// 确定性的偏态数据：大多数金额较小，少量很大
+std::vector<double> skewedAmounts(size_t n, uint32_t seed) {
+  std::vector<double> values;
+  for (size_t i = 0; i < n; ++i) {
+    seed = seed * 1103515245u + 12345u;
+    double u = (static_cast<double>(seed >> 8) + 0.5) / (1u << 24);
+    values.push_back(std::round(std::exp(8 * u) * 100) / 100);
+  }
+  return values;
+}
+
+double exactQuantile(std::vector<double> values, double q) {
+  std::sort(values.begin(), values.end());
+  return values[static_cast<size_t>(q * (values.size() - 1))];
+}
+
+}  // namespace
+
+TEST(QuantileSketch, Percentiles_CloseToExact) {
+  std::vector<double> values = skewedAmounts(200000, 3);
+  QuantileSketch whole;
+  QuantileSketch parts[4];
+  for (size_t i = 0; i < values.size(); ++i) {
+    whole.add(values[i]);
+    parts[i % 4].add(values[i]);
+  }
+  for (size_t i = 1; i < 4; ++i) parts[0].merge(parts[i]);
+  whole.flush();
+  EXPECT_LE(whole.centroidCount(), 200u);
+  EXPECT_EQ(parts[0].count(), 200000.0);
+
+  const double qs[] = {0.01, 0.25, 0.5, 0.9, 0.99, 0.999};
+  for (size_t i = 0; i < 6; ++i) {
+    double exact = exactQuantile(values, qs[i]);
+    EXPECT_NEAR(whole.quantile(qs[i]), exact, exact * 0.02) << qs[i];
+    EXPECT_NEAR(parts[0].quantile(qs[i]), exact, exact * 0.02) << qs[i];
+  }
+  EXPECT_EQ(whole.quantile(0),
+            *std::min_element(values.begin(), values.end()));
+  EXPECT_EQ(whole.quantile(1),
+            *std::max_element(values.begin(), values.end()));
+
+  QuantileSketch empty, single;
+  single.add(42);
+  EXPECT_EQ(empty.quantile(0.5), 0.0);
+  EXPECT_EQ(single.quantile(0.9), 42.0);
+  empty.merge(single);
+  EXPECT_EQ(empty.quantile(0.1), 42.0);
+}
+
+TEST(DistinctSketch, Estimate_WithinErrorAndMergeable) {
+  DistinctSketch small, a, b, both;
+  EXPECT_EQ(small.estimate(), 0.0);
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < 10; ++i) small.add("商户" + std::to_string(i));
+  }
+  EXPECT_NEAR(small.estimate(), 10, 1);  // 重复的值不重复计数
+
+  // a、b 各 60000 个，其中 20000 个重叠
+  for (int i = 0; i < 60000; ++i) {
+    a.add("k" + std::to_string(i));
+    b.add("k" + std::to_string(i + 40000));
+  }
+  for (int i = 0; i < 100000; ++i) both.add("k" + std::to_string(i));
+  EXPECT_NEAR(a.estimate(), 60000, 60000 * 0.05);
+  a.merge(b);
+  EXPECT_NEAR(a.estimate(), 100000, 100000 * 0.05);
+  EXPECT_EQ(a.estimate(), both.estimate());  // 合并与一次累加的寄存器相同
+}
+
+struct SketchReportFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("sk1", "餐饮"));
+    Category::addCategory(Category("sk2", "交通"));
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("sk1");
+    Category::deleteCategory("sk2");
+  }
+};
+
+TEST_F(SketchReportFixture, ParallelSlices_MatchSingleThread) {
+  // 足够多的行，使按 4 线程统计时确实分段
+  std::vector<double> amounts = skewedAmounts(300000, 11);
+  std::vector<Transaction>& repo = Transaction::getRepository();
+  for (size_t i = 0; i < amounts.size(); ++i) {
+    repo.emplace_back("S" + std::to_string(i), amounts[i],
+                      "2024-0" + std::to_string(i % 9 + 1) + "-01",
+                      i % 3 ? "sk1" : "sk2",
+                      i % 10 ? TransactionType::Expense
+                             : TransactionType::Income,
+                      "店" + std::to_string(i % 500) + " 外卖，午饭");
+  }
+  StatisticService plain(Transaction::list());
+  StatisticReport expected = plain.reportByTime(TimeGroup::Monthly, {});
+  EXPECT_TRUE(expected.sketches.empty());
+
+  StatisticService serial(Transaction::list());
+  serial.setSketches(true, 1);
+  StatisticReport one = serial.reportByTime(TimeGroup::Monthly, {});
+  StatisticService parallel(Transaction::list());
+  parallel.setSketches(true, 4);
+  StatisticReport four = parallel.reportByTime(TimeGroup::Monthly, {});
+
+  ASSERT_EQ(one.rows.size(), 9u);
+  ASSERT_EQ(four.rows.size(), 9u);
+  ASSERT_EQ(four.sketches.size(), 9u);
+  for (size_t i = 0; i < 9; ++i) {
+    EXPECT_EQ(four.rows[i].key, expected.rows[i].key);
+    EXPECT_EQ(four.rows[i].expenseCount, expected.rows[i].expenseCount);
+    EXPECT_NEAR(four.rows[i].expense, expected.rows[i].expense, 1e-3);
+    EXPECT_EQ(four.sketches[i].expenses.count(),
+              expected.rows[i].expenseCount);
+    double median = one.sketches[i].expenses.quantile(0.5);
+    EXPECT_NEAR(four.sketches[i].expenses.quantile(0.5), median,
+                median * 0.02);
+    EXPECT_NEAR(four.sketches[i].remarks.estimate(), 500, 500 * 0.05);
+    // 关键词：店0..店499、外卖、午饭
+    EXPECT_NEAR(four.sketches[i].keywords.estimate(), 502, 502 * 0.05);
+  }
+  EXPECT_NEAR(four.totalExpense, expected.totalExpense, 1e-3);
+
+  // 分区或分段各自统计后合并，与整体统计一致
+  StatisticReport merged = one;
+  StatisticService::mergeReport(merged, one);
+  EXPECT_EQ(merged.rows.size(), 9u);
+  EXPECT_EQ(merged.rows[0].expenseCount, 2 * one.rows[0].expenseCount);
+  EXPECT_EQ(merged.sketches[0].expenses.count(),
+            2 * one.sketches[0].expenses.count());
+  EXPECT_EQ(merged.sketches[0].remarks.estimate(),
+            one.sketches[0].remarks.estimate());
+}
+
+TEST_F(SketchReportFixture, CommandLine_SketchColumns) {
+  const double amounts[] = {10, 20, 30, 500};
+  for (size_t i = 0; i < 4; ++i) {
+    ASSERT_TRUE(Transaction::emplaceTransaction(
+        "C" + std::to_string(i), amounts[i], "2024-05-01",
+        i < 3 ? "sk1" : "sk2", TransactionType::Expense,
+        i ? "地铁 早高峰" : "午饭"));
+  }
+  std::ostringstream out, err;
+  ASSERT_EQ(CommandLine::run({"stats", "--by", "category", "--sketch"}, out,
+                             err),
+            0);
+  EXPECT_EQ(out.str(),
+            "key,income,expense,balance,income_count,expense_count,"
+            "expense_p50,expense_p90,expense_p99,distinct_remarks,"
+            "distinct_keywords\n"
+            "餐饮,0.00,60.00,-60.00,0,3,20.00,30.00,30.00,2,3\n"
+            "交通,0.00,500.00,-500.00,0,1,500.00,500.00,500.00,1,2\n");
+  out.str("");
+  ASSERT_EQ(CommandLine::run({"stats", "--by", "amount", "--sketch",
+                              "--format", "jsonl"},
+                             out, err),
+            0);
+  EXPECT_NE(out.str().find("\"key\":\"小于100\""), std::string::npos);
+  EXPECT_NE(out.str().find("\"expense_p50\":20.00,"), std::string::npos);
+  EXPECT_EQ(
+      CommandLine::run({"stats", "--sketch", "--threads", "0"}, out, err), 1);
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,76 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+#include "../tools/synthetic_ledger.h"
+
+static bool sameTransaction(const Transaction& a, const Transaction& b) {
+  return a.getId() == b.getId() && a.getAmount() == b.getAmount() &&
+         a.getTime() == b.getTime() && a.getCategoryId() == b.getCategoryId() &&
+         a.getType() == b.getType() && a.getRemarks() == b.getRemarks();
+}
+
+TEST(SyntheticLedger, SameSeed_GeneratesSameLedger) {
+  SyntheticLedgerOptions opts;
+  opts.rows = 2000;
+  std::vector<Category> c1, c2, c3;
+  std::vector<Transaction> t1, t2, t3;
+  generateSyntheticLedger(opts, c1, t1);
+  generateSyntheticLedger(opts, c2, t2);
+  ASSERT_EQ(t1.size(), 2000u);
+  ASSERT_EQ(t1.size(), t2.size());
+  for (size_t i = 0; i < t1.size(); ++i) {
+    ASSERT_TRUE(sameTransaction(t1[i], t2[i])) << "row " << i;
+  }
+  // 日期有序，分类都存在
+  for (size_t i = 1; i < t1.size(); ++i) {
+    EXPECT_LE(t1[i - 1].getTime(), t1[i].getTime());
+  }
+  EXPECT_EQ(c1.size(), opts.categories);
+
+  opts.seed = 7;
+  generateSyntheticLedger(opts, c3, t3);
+  size_t differ = 0;
+  for (size_t i = 0; i < t1.size(); ++i) {
+    if (!sameTransaction(t1[i], t3[i])) ++differ;
+  }
+  EXPECT_GT(differ, 0u);
+}
+
+TEST(SyntheticLedger, SaveAndLoad_RoundTripsEscapedRemarks) {
+  SyntheticLedgerOptions opts;
+  opts.rows = 20000;
+  opts.escapeRate = 0.2;
+  std::vector<Category> categories;
+  std::vector<Transaction> expected;
+  generateSyntheticLedger(opts, categories, expected);
+  size_t special = 0;
+  for (size_t i = 0; i < expected.size(); ++i) {
+    if (expected[i].getRemarks().find_first_of("|\\\n") != std::string::npos) {
+      ++special;
+    }
+  }
+  EXPECT_GT(special, 0u);
+
+  const std::string file = "test_synthetic_ledger.db";
+  installSyntheticLedger(opts);
+  DataPersistence::setTestFilePath(file);
+  ASSERT_TRUE(DataPersistence::saveAll());
+  Transaction::getRepository().clear();
+  for (size_t i = 0; i < categories.size(); ++i) {
+    Category::deleteCategory(categories[i].getId());
+  }
+  ASSERT_TRUE(DataPersistence::loadAll());
+
+  const std::vector<Transaction>& loaded = Transaction::list();
+  ASSERT_EQ(loaded.size(), expected.size());
+  for (size_t i = 0; i < loaded.size(); ++i) {
+    ASSERT_TRUE(sameTransaction(loaded[i], expected[i])) << "row " << i;
+  }
+  EXPECT_EQ(Category::getCategoryList().size(), categories.size());
+  std::remove(file.c_str());
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,95 @@
+#include "../code/bookkeeping.h"
+#include <gtest/gtest.h>
+#include <cstdio>
+
+struct TombstoneFixture : public ::testing::Test {
+  void SetUp() override {
+    Transaction::getRepository().clear();
+    Category::addCategory(Category("tc1", "餐饮"));
+    for (int i = 0; i < 10; ++i) {
+      ASSERT_TRUE(Transaction::emplaceTransaction(
+          "D" + std::to_string(i), 10.0 * (i + 1), "2024-07-0" +
+          std::to_string(i % 9 + 1), "tc1", TransactionType::Expense,
+          "备注" + std::to_string(i)));
+    }
+  }
+  void TearDown() override {
+    Transaction::getRepository().clear();
+    Category::deleteCategory("tc1");
+  }
+};
+
+TEST_F(TombstoneFixture, Delete_KeepsRowPositionsUntilCompaction) {
+  ASSERT_TRUE(Transaction::deleteTransaction("D2"));
+  EXPECT_FALSE(Transaction::deleteTransaction("D2"));
+
+  // 低于阈值：行留在原位，其余行的位置不变
+  const std::vector<Transaction>& rows = Transaction::list();
+  ASSERT_EQ(rows.size(), 10u);
+  EXPECT_EQ(Transaction::deletedCount(), 1u);
+  EXPECT_EQ(Transaction::liveCount(), 9u);
+  EXPECT_TRUE(Transaction::isDeleted(2));
+  EXPECT_TRUE(rows[2].getId().empty());
+  EXPECT_EQ(rows[3].getId(), "D3");
+
+  SearchService search(Transaction::list());
+  EXPECT_EQ(search.searchTransaction({}, {}, "", "").size(), 9u);
+  StatisticService stat(Transaction::list());
+  EXPECT_EQ(stat.reportByType().totalExpense, 550.0 - 30.0);
+  double ti, te, bal;
+  stat.calculateHomePage(ti, te, bal);
+  EXPECT_EQ(te, 520.0);
+  EXPECT_EQ(LedgerSnapshot::current().transactions().size(), 9u);
+
+  std::ostringstream json;
+  ReportWriter::writeTransactions(json, Transaction::list(), OutputFormat::Json);
+  EXPECT_EQ(json.str().find("\"D2\""), std::string::npos);
+  EXPECT_EQ(json.str().substr(0, 3), "[\n{");
+
+  // 删除后可以重新使用同一个 ID；修改仍能找到其他行
+  EXPECT_TRUE(Transaction::emplaceTransaction(
+      "D2", 1, "2024-07-09", "tc1", TransactionType::Income));
+  Transaction changed = rows[5];
+  changed.setRemarks("改过");
+  EXPECT_TRUE(changed.updateTransaction());
+  EXPECT_EQ(Transaction::list()[5].getRemarks(), "改过");
+}
+
+TEST_F(TombstoneFixture, CrossingThreshold_Compacts) {
+  EXPECT_EQ(Transaction::deleteTransactions({"D1", "D4", "nope", "D4"}), 2u);
+  EXPECT_EQ(Transaction::list().size(), 10u);
+  ASSERT_TRUE(Transaction::deleteTransaction("D7"));  // 3/10 超过 25%
+  EXPECT_EQ(Transaction::deletedCount(), 0u);
+  ASSERT_EQ(Transaction::list().size(), 7u);
+  const char* expected[] = {"D0", "D2", "D3", "D5", "D6", "D8", "D9"};
+  for (size_t i = 0; i < 7; ++i) {
+    EXPECT_EQ(Transaction::list()[i].getId(), expected[i]);
+  }
+  // 压缩后索引重建，删除和查重照常工作
+  EXPECT_TRUE(Transaction::deleteTransaction("D9"));
+  EXPECT_FALSE(Transaction::emplaceTransaction(
+      "D8", 1, "2024-07-09", "tc1", TransactionType::Income));
+}
+
+TEST_F(TombstoneFixture, SaveAndRawAccess_SkipDeletedRows) {
+  ASSERT_TRUE(Transaction::deleteTransaction("D0"));
+  const std::string file = "test_tombstone.db";
+  DataPersistence::setTestFilePath(file);
+  ASSERT_TRUE(DataPersistence::saveAll());
+
+  // getRepository 先压缩，直接修改看不到删除标记
+  EXPECT_EQ(Transaction::getRepository().size(), 9u);
+  EXPECT_EQ(Transaction::deletedCount(), 0u);
+
+  Transaction::getRepository().clear();
+  ASSERT_TRUE(DataPersistence::loadAll());
+  DataPersistence::setTestFilePath("");
+  std::remove(file.c_str());
+  ASSERT_EQ(Transaction::list().size(), 9u);
+  EXPECT_EQ(Transaction::list()[0].getId(), "D1");
+}
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -0,0 +1,268 @@
+// Copyright 2025 user
+// 合成账本生成器：为基准测试、压力测试和 gen_ledger 工具构造大规模数据。
+// 使用前需先包含 code/bookkeeping.h。
+//
+// 生成结果只由参数和种子决定：随机数使用标准规定了输出序列的
+// std::mt19937_64，各分布也在这里自行实现（<random> 中的分布算法由
+// 标准库实现决定），因此不同平台、不同编译器生成的数据完全一致。
+//
+// 数据特征：
+//  * 分类按 Zipf 分布被使用，常见分类远多于冷门分类；
+//  * 金额按分类取对数正态分布，大量小额消费加少量大额长尾，精确到分；
+//  * 日期带季节性：周末、12 月和春节前后（1、2 月）消费更密集，
+//    工资类收入集中在每月 10 日前后；记录按日期排序，ID 随时间递增；
+//  * 备注由中文商户、摘要短语拼接成 UTF-8 文本，按 escapeRate 的比例
+//    混入 '|'、'\' 和换行，用来覆盖 escapeString/unescapeString 的转义路径。
+#ifndef TOOLS_SYNTHETIC_LEDGER_H_
+#define TOOLS_SYNTHETIC_LEDGER_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+struct SyntheticLedgerOptions {
+  size_t rows = 10000;        // 交易条数
+  size_t categories = 20;     // 分类个数
+  int dateSpanDays = 3650;    // 日期跨度（自 2015-01-01 起的天数）
+  size_t remarkLength = 24;   // 备注的目标长度（字节，按短语拼接，可略长）
+  double escapeRate = 0.05;   // 备注中含 '|'、'\' 或换行的比例
+  uint64_t seed = 42;         // 随机种子，相同参数生成相同数据
+};
+
+// 可复现的随机源
+class SyntheticRandom {
+ public:
+  explicit SyntheticRandom(uint64_t seed) : engine(seed) {}
+
+  // [0, 1) 上的均匀分布，取 53 位
+  double uniform() {
+    return static_cast<double>(engine() >> 11) * (1.0 / 9007199254740992.0);
+  }
+  // [0, n) 上的整数
+  size_t below(size_t n) { return static_cast<size_t>(uniform() * n); }
+  bool chance(double p) { return uniform() < p; }
+  // Box-Muller 标准正态分布
+  double normal() {
+    double u1 = uniform(), u2 = uniform();
+    if (u1 < 1e-300) u1 = 1e-300;
+    return std::sqrt(-2.0 * std::log(u1)) * std::cos(6.283185307179586 * u2);
+  }
+  double logNormal(double mu, double sigma) {
+    return std::exp(mu + sigma * normal());
+  }
+  // 按累积权重（递增）抽取下标
+  size_t pick(const std::vector<double>& cumulative) {
+    double r = uniform() * cumulative.back();
+    return static_cast<size_t>(
+        std::upper_bound(cumulative.begin(), cumulative.end(), r) -
+        cumulative.begin());
+  }
+
+ private:
+  std::mt19937_64 engine;
+};
+
+// 自 2015-01-01 起第 offset 天对应的 YYYY-MM-DD
+inline std::string syntheticDate(int offset) {
+  static const int kDaysInMonth[] = {31, 28, 31, 30, 31, 30,
+                                     31, 31, 30, 31, 30, 31};
+  int year = 2015, month = 0, day = offset;
+  while (true) {
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    int daysInYear = leap ? 366 : 365;
+    if (day < daysInYear) break;
+    day -= daysInYear;
+    ++year;
+  }
+  while (true) {
+    bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    int dim = kDaysInMonth[month] + (month == 1 && leap ? 1 : 0);
+    if (day < dim) break;
+    day -= dim;
+    ++month;
+  }
+  char buf[48];
+  std::snprintf(buf, sizeof(buf), "%04d-%02d-%02d", year, month + 1, day + 1);
+  return buf;
+}
+
+namespace synthetic {
+
+struct CategoryProfile {
+  const char* name;
+  bool income;
+  double mu;     // 金额对数的均值（元）
+  double sigma;  // 金额对数的标准差
+  bool monthly;  // 是否集中在每月固定日期（工资）
+};
+
+// 常见分类在前；超出部分以"名称-序号"扩展
+const CategoryProfile kProfiles[] = {
+    {"餐饮", false, 3.3, 0.8, false},   {"交通", false, 2.5, 0.9, false},
+    {"购物", false, 4.5, 1.2, false},   {"日用", false, 3.5, 0.9, false},
+    {"娱乐", false, 4.2, 1.0, false},   {"通讯", false, 4.0, 0.4, false},
+    {"水电", false, 5.0, 0.5, false},   {"房租", false, 8.0, 0.3, false},
+    {"医疗", false, 5.0, 1.3, false},   {"教育", false, 6.0, 1.1, false},
+    {"服饰", false, 5.2, 0.9, false},   {"数码", false, 7.0, 1.0, false},
+    {"旅行", false, 7.2, 1.0, false},   {"宠物", false, 4.5, 0.8, false},
+    {"运动", false, 4.8, 0.9, false},   {"保险", false, 7.0, 0.6, false},
+    {"工资", true, 9.3, 0.25, true},   {"奖金", true, 8.5, 0.8, false},
+    {"理财收益", true, 5.0, 1.5, false}, {"红包", true, 4.0, 1.2, false},
+};
+
+const char* const kMerchants[] = {
+    "星巴克", "美团外卖", "滴滴出行", "京东", "淘宝", "盒马鲜生", "全家便利店",
+    "地铁", "中国移动", "国家电网", "万达影城", "迪卡侬", "优衣库", "携程",
+    "拼多多", "麦当劳", "肯德基", "沃尔玛", "瑞幸咖啡", "高铁",
+};
+
+const char* const kPhrases[] = {
+    "午饭", "晚餐", "早餐", "加班打车", "周末聚餐", "生日礼物", "月卡充值",
+    "年度会员", "双十一", "退款补差", "AA 制", "报销待提交", "给家里", "备用",
+    "换季衣服", "一家人", "出差", "朋友请客",
+};
+
+template <size_t N>
+const char* choose(SyntheticRandom& rng, const char* const (&pool)[N]) {
+  return pool[rng.below(N)];
+}
+
+inline std::string makeRemarks(SyntheticRandom& rng,
+                               const SyntheticLedgerOptions& opts) {
+  std::string remarks;
+  while (remarks.size() < opts.remarkLength) {
+    if (!remarks.empty()) remarks += ' ';
+    remarks += remarks.empty() ? choose(rng, kMerchants) :
+                                 choose(rng, kPhrases);
+  }
+  if (rng.chance(opts.escapeRate)) {
+    // 在随机的短语边界插入需要转义的字符
+    static const char* const kSpecial[] = {"|", "\n", "\\", "\\|", "||", "\\n"};
+    size_t cut = remarks.rfind(' ');
+    std::string special = choose(rng, kSpecial);
+    if (cut == std::string::npos) {
+      remarks += special;
+    } else {
+      remarks.replace(cut, 1, special);
+    }
+  }
+  return remarks;
+}
+
+// 每一天被选中的相对权重，体现周末与节假日消费高峰
+inline std::vector<double> dayWeights(int days) {
+  std::vector<double> cumulative(static_cast<size_t>(days));
+  double total = 0.0;
+  for (int d = 0; d < days; ++d) {
+    std::string date = syntheticDate(d);
+    int month = std::atoi(date.substr(5, 2).c_str());
+    double w = 1.0;
+    if ((d + 3) % 7 >= 5) w += 0.6;  // 2015-01-01 为周四
+    if (month == 12) w += 0.5;
+    if (month == 1 || month == 2) w += 0.4;
+    if (month == 11 && date.substr(8, 2) == "11") w += 3.0;
+    total += w;
+    cumulative[static_cast<size_t>(d)] = total;
+  }
+  return cumulative;
+}
+
+}  // namespace synthetic
+
+inline void generateSyntheticLedger(const SyntheticLedgerOptions& opts,
+                                    std::vector<Category>& categories,
+                                    std::vector<Transaction>& transactions) {
+  using synthetic::CategoryProfile;
+  SyntheticRandom rng(opts.seed);
+  const size_t kProfileCount =
+      sizeof(synthetic::kProfiles) / sizeof(synthetic::kProfiles[0]);
+
+  categories.clear();
+  std::vector<const CategoryProfile*> profiles;
+  std::vector<double> catWeights;
+  double total = 0.0;
+  for (size_t i = 0; i < opts.categories; ++i) {
+    const CategoryProfile& p = synthetic::kProfiles[i % kProfileCount];
+    std::string name = p.name;
+    if (i >= kProfileCount) name += "-" + std::to_string(i / kProfileCount);
+    categories.emplace_back("c" + std::to_string(100 + i), name);
+    profiles.push_back(&p);
+    // Zipf(1)：第 i 个分类的使用频率约为 1/(i+1)，收入类再降低三成
+    total += p.income ? 0.3 / (i + 1) : 1.0 / (i + 1);
+    catWeights.push_back(total);
+  }
+
+  std::vector<double> days = synthetic::dayWeights(opts.dateSpanDays);
+  struct Row {
+    int day;
+    size_t category;
+    double amount;
+    bool income;
+    std::string remarks;
+  };
+  std::vector<Row> rows;
+  rows.reserve(opts.rows);
+  for (size_t i = 0; i < opts.rows; ++i) {
+    Row row;
+    row.category = rng.pick(catWeights);
+    const CategoryProfile& p = *profiles[row.category];
+    row.income = p.income;
+    row.day = static_cast<int>(rng.pick(days));
+    if (p.monthly) {
+      // 工资集中在每月 10 日前后
+      std::string date = syntheticDate(row.day);
+      int dom = std::atoi(date.substr(8, 2).c_str());
+      row.day = std::max(0, std::min(opts.dateSpanDays - 1,
+                                     row.day + 10 - dom +
+                                     static_cast<int>(rng.below(3)) - 1));
+    }
+    double amount = rng.logNormal(p.mu, p.sigma);
+    row.amount = std::round(amount * 100.0) / 100.0;
+    row.remarks = synthetic::makeRemarks(rng, opts);
+    rows.push_back(std::move(row));
+  }
+  std::stable_sort(rows.begin(), rows.end(),
+                   [](const Row& a, const Row& b) { return a.day < b.day; });
+
+  transactions.clear();
+  transactions.reserve(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    Transaction tx;
+    tx.setId("T" + std::to_string(1000 + i));
+    tx.setAmount(rows[i].amount);
+    tx.setTime(syntheticDate(rows[i].day));
+    tx.setCategoryId(categories[rows[i].category].getId());
+    tx.setType(rows[i].income ? TransactionType::Income :
+               TransactionType::Expense);
+    tx.setRemarks(std::move(rows[i].remarks));
+    transactions.push_back(std::move(tx));
+  }
+}
+
+// 直接生成到全局仓库，替换其中原有的分类与交易
+inline void installSyntheticLedger(const SyntheticLedgerOptions& opts) {
+  std::vector<Category> categories;
+  std::vector<Transaction> transactions;
+  generateSyntheticLedger(opts, categories, transactions);
+
+  LedgerLock::WriteGuard guard;
+  std::vector<Category> old = Category::getCategoryList();
+  for (size_t i = 0; i < old.size(); ++i) {
+    Category::deleteCategory(old[i].getId());
+  }
+  for (size_t i = 0; i < categories.size(); ++i) {
+    Category::addCategory(categories[i]);
+  }
+  // 直接替换仓库不经过 addTransaction，需自行抬高 ID 分配器的水位
+  for (size_t i = 0; i < transactions.size(); ++i) {
+    IdAllocator::observe(IdAllocator::TransactionIds, transactions[i].getId());
+  }
+  Transaction::getRepository() = std::move(transactions);
+}
+
+#endif  // TOOLS_SYNTHETIC_LEDGER_H_